@@ -0,0 +1,169 @@
+#include "alloc_track.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <time.h>
+
+static const char *TAG_NAMES[NUM_ALLOC_TAGS] = {
+    "scene", "body", "shape", "force", "list", "texture"};
+
+const char *alloc_track_name(alloc_tag_t tag) {
+  assert(tag < NUM_ALLOC_TAGS);
+  return TAG_NAMES[tag];
+}
+
+#ifdef ALLOC_TRACKING
+static const double NS_PER_SECOND = 1e9;
+static const double BYTES_PER_KB = 1024;
+
+typedef struct counters {
+  atomic_long live_bytes;
+  atomic_long live_count;
+  atomic_long peak_bytes;
+  atomic_size_t allocations;
+  atomic_size_t allocated_bytes;
+} counters_t;
+
+// every tracked block starts with its tag and size, padded so that the
+// memory handed out keeps the alignment malloc gives
+typedef struct header {
+  alignas(max_align_t) alloc_tag_t tag;
+  size_t size;
+} header_t;
+
+static counters_t totals[NUM_ALLOC_TAGS];
+static _Thread_local alloc_mark_t thread_live;
+static pthread_once_t start_once = PTHREAD_ONCE_INIT;
+static struct timespec start;
+
+static void record_start(void) { clock_gettime(CLOCK_MONOTONIC, &start); }
+
+static void count(alloc_tag_t tag, long bytes, long objects) {
+  assert(tag < NUM_ALLOC_TAGS);
+  counters_t *counters = &totals[tag];
+  thread_live.bytes[tag] += bytes;
+  thread_live.count[tag] += objects;
+  atomic_fetch_add(&counters->live_count, objects);
+  long live = atomic_fetch_add(&counters->live_bytes, bytes) + bytes;
+  long peak = atomic_load(&counters->peak_bytes);
+  while (live > peak &&
+         !atomic_compare_exchange_weak(&counters->peak_bytes, &peak, live)) {
+  }
+}
+
+static void count_allocation(alloc_tag_t tag, size_t size) {
+  pthread_once(&start_once, record_start);
+  atomic_fetch_add(&totals[tag].allocations, 1);
+  atomic_fetch_add(&totals[tag].allocated_bytes, size);
+}
+
+void alloc_track_add(alloc_tag_t tag, size_t size) {
+  count(tag, size, 1);
+  count_allocation(tag, size);
+}
+
+void alloc_track_remove(alloc_tag_t tag, size_t size) {
+  count(tag, -(long)size, -1);
+}
+
+void *alloc_track_malloc(alloc_tag_t tag, size_t size) {
+  header_t *header = malloc(sizeof(header_t) + size);
+  assert(header != NULL);
+  *header = (header_t){.tag = tag, .size = size};
+  count(tag, size, 1);
+  count_allocation(tag, size);
+  return header + 1;
+}
+
+void *alloc_track_realloc(alloc_tag_t tag, void *ptr, size_t size) {
+  if (ptr == NULL) {
+    return alloc_track_malloc(tag, size);
+  }
+  header_t *header = (header_t *)ptr - 1;
+  long old_size = header->size;
+  header = realloc(header, sizeof(header_t) + size);
+  assert(header != NULL);
+  header->size = size;
+  // a resize counts as an allocation for the rate, but the block is still
+  // one live object
+  count(header->tag, (long)size - old_size, 0);
+  count_allocation(header->tag, size);
+  return header + 1;
+}
+
+void alloc_track_free(void *ptr) {
+  if (ptr == NULL) {
+    return;
+  }
+  header_t *header = (header_t *)ptr - 1;
+  count(header->tag, -(long)header->size, -1);
+  free(header);
+}
+
+alloc_stats_t alloc_track_stats(alloc_tag_t tag) {
+  assert(tag < NUM_ALLOC_TAGS);
+  counters_t *counters = &totals[tag];
+  return (alloc_stats_t){
+      .live_bytes = atomic_load(&counters->live_bytes),
+      .live_count = atomic_load(&counters->live_count),
+      .peak_bytes = atomic_load(&counters->peak_bytes),
+      .allocations = atomic_load(&counters->allocations),
+      .allocated_bytes = atomic_load(&counters->allocated_bytes)};
+}
+
+alloc_mark_t alloc_track_mark(void) { return thread_live; }
+
+alloc_mark_t alloc_track_since(alloc_mark_t *mark) {
+  alloc_mark_t difference;
+  for (size_t i = 0; i < NUM_ALLOC_TAGS; i++) {
+    difference.bytes[i] = thread_live.bytes[i] - mark->bytes[i];
+    difference.count[i] = thread_live.count[i] - mark->count[i];
+  }
+  return difference;
+}
+
+alloc_mark_t alloc_track_adopt(alloc_mark_t *held) {
+  alloc_mark_t mark;
+  for (size_t i = 0; i < NUM_ALLOC_TAGS; i++) {
+    mark.bytes[i] = thread_live.bytes[i] - held->bytes[i];
+    mark.count[i] = thread_live.count[i] - held->count[i];
+  }
+  return mark;
+}
+
+void alloc_track_report(FILE *file) {
+  pthread_once(&start_once, record_start);
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  double seconds = (now.tv_sec - start.tv_sec) +
+                   (now.tv_nsec - start.tv_nsec) / NS_PER_SECOND;
+  fprintf(file, "%-8s %8s %10s %10s %12s %10s\n", "tag", "live", "live kb",
+          "peak kb", "allocations", "per second");
+  for (size_t i = 0; i < NUM_ALLOC_TAGS; i++) {
+    alloc_stats_t stats = alloc_track_stats(i);
+    fprintf(file, "%-8s %8ld %10.1f %10.1f %12zu %10.1f\n", TAG_NAMES[i],
+            stats.live_count, stats.live_bytes / BYTES_PER_KB,
+            stats.peak_bytes / BYTES_PER_KB, stats.allocations,
+            seconds > 0 ? stats.allocations / seconds : 0);
+  }
+}
+#else
+alloc_stats_t alloc_track_stats(alloc_tag_t tag) {
+  return (alloc_stats_t){0};
+}
+
+alloc_mark_t alloc_track_mark(void) { return (alloc_mark_t){0}; }
+
+alloc_mark_t alloc_track_since(alloc_mark_t *mark) {
+  return (alloc_mark_t){0};
+}
+
+alloc_mark_t alloc_track_adopt(alloc_mark_t *held) {
+  return (alloc_mark_t){0};
+}
+
+void alloc_track_report(FILE *file) {
+  fprintf(file, "allocation tracking is compiled out of this build\n");
+}
+#endif
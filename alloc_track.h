@@ -0,0 +1,152 @@
+#ifndef __ALLOC_TRACK_H__
+#define __ALLOC_TRACK_H__
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// headless tools and debug builds count their allocations, release builds
+// for the browser call malloc and free directly
+#if !defined(NDEBUG) || !defined(__EMSCRIPTEN__)
+#define ALLOC_TRACKING
+#endif
+
+/**
+ * The subsystems allocations are counted under.
+ * Memory owned by the library or by SDL, such as scenes and textures, is
+ * recorded with alloc_track_add() at the calls that create it.
+ */
+typedef enum {
+  ALLOC_SCENE,
+  ALLOC_BODY,
+  ALLOC_SHAPE,
+  ALLOC_FORCE,
+  ALLOC_LIST,
+  ALLOC_TEXTURE,
+  NUM_ALLOC_TAGS
+} alloc_tag_t;
+
+/**
+ * The counts of one tag across every thread.
+ */
+typedef struct alloc_stats {
+  long live_bytes;
+  long live_count;
+  long peak_bytes;
+  size_t allocations;
+  size_t allocated_bytes;
+} alloc_stats_t;
+
+/**
+ * What the calling thread had live of every tag at some point.
+ * Marks only count the thread that takes them, so sessions running side by
+ * side on other threads never show up in each other's differences.
+ */
+typedef struct alloc_mark {
+  long bytes[NUM_ALLOC_TAGS];
+  long count[NUM_ALLOC_TAGS];
+} alloc_mark_t;
+
+#ifdef ALLOC_TRACKING
+/**
+ * Allocates memory counted under a tag.
+ * Memory from alloc_track_malloc() or alloc_track_realloc() must be released
+ * with alloc_track_free(), which can also be passed wherever a freer is
+ * expected.
+ *
+ * @param tag the subsystem the memory belongs to
+ * @param size the number of bytes
+ * @return the new memory
+ */
+void *alloc_track_malloc(alloc_tag_t tag, size_t size);
+
+/**
+ * Resizes tracked memory, keeping its tag.
+ *
+ * @param tag the tag to use when ptr is NULL
+ * @param ptr memory from alloc_track_malloc() or alloc_track_realloc(), or
+ *   NULL to allocate
+ * @param size the new number of bytes
+ * @return the resized memory
+ */
+void *alloc_track_realloc(alloc_tag_t tag, void *ptr, size_t size);
+
+/**
+ * Releases tracked memory.
+ *
+ * @param ptr memory from alloc_track_malloc() or alloc_track_realloc(), or
+ *   NULL
+ */
+void alloc_track_free(void *ptr);
+
+/**
+ * Counts memory allocated or released somewhere the tracker cannot see.
+ *
+ * @param tag the subsystem the memory belongs to
+ * @param size the number of bytes, 0 when only the object is counted
+ */
+void alloc_track_add(alloc_tag_t tag, size_t size);
+void alloc_track_remove(alloc_tag_t tag, size_t size);
+#else
+// sizes passed to alloc_track_add() and alloc_track_remove() are not
+// evaluated, so measuring them costs nothing here
+#define alloc_track_malloc(tag, size) malloc(size)
+#define alloc_track_realloc(tag, ptr, size) realloc(ptr, size)
+#define alloc_track_free free
+#define alloc_track_add(tag, size) ((void)sizeof(size))
+#define alloc_track_remove(tag, size) ((void)sizeof(size))
+#endif
+
+/**
+ * Gets the counts of a tag, all zero when tracking is compiled out.
+ *
+ * @param tag the tag to query
+ * @return the live and peak bytes and the allocations so far
+ */
+alloc_stats_t alloc_track_stats(alloc_tag_t tag);
+
+/**
+ * Takes a mark of what the calling thread has live.
+ *
+ * @return the mark
+ */
+alloc_mark_t alloc_track_mark(void);
+
+/**
+ * Gets what the calling thread allocated after a mark and still has live.
+ * Negative entries are memory from before the mark that was released.
+ *
+ * @param mark a mark taken on the calling thread
+ * @return the difference between now and the mark
+ */
+alloc_mark_t alloc_track_since(alloc_mark_t *mark);
+
+/**
+ * Takes a mark on the calling thread that counts memory another thread
+ * allocated as if this thread had allocated it after the mark, for work
+ * handed from one thread to another. Freeing that memory here then balances
+ * out in alloc_track_since().
+ *
+ * @param held alloc_track_since() of a mark, taken on the thread handing
+ *   the work over
+ * @return the mark
+ */
+alloc_mark_t alloc_track_adopt(alloc_mark_t *held);
+
+/**
+ * Gets the name of a tag, for reports.
+ *
+ * @param tag the tag
+ * @return a string literal such as "body"
+ */
+const char *alloc_track_name(alloc_tag_t tag);
+
+/**
+ * Writes a table of live bytes, peak bytes and allocation rate per tag.
+ * The rate is averaged since the first tracked allocation.
+ *
+ * @param file an open file to write to
+ */
+void alloc_track_report(FILE *file);
+
+#endif // #ifndef __ALLOC_TRACK_H__
@@ -0,0 +1,192 @@
+#include "asset_pack.h"
+#include <assert.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef __EMSCRIPTEN__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct asset_pack {
+  uint8_t *data;
+  size_t size;
+  pack_header_t *header;
+  pack_entry_t *entries;
+  // decoded RLE images are expanded here before they are uploaded
+  uint32_t *scratch;
+  size_t scratch_pixels;
+};
+
+// reads the whole pack with one mapping, or one read in the browser
+static uint8_t *read_pack(const char *path, size_t *size) {
+#ifdef __EMSCRIPTEN__
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return NULL;
+  }
+  fseek(file, 0, SEEK_END);
+  *size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  uint8_t *data = malloc(*size);
+  assert(data != NULL);
+  size_t read = fread(data, 1, *size, file);
+  fclose(file);
+  if (read != *size) {
+    free(data);
+    return NULL;
+  }
+  return data;
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat info;
+  if (fstat(fd, &info) < 0) {
+    close(fd);
+    return NULL;
+  }
+  *size = info.st_size;
+  void *data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  return data == MAP_FAILED ? NULL : data;
+#endif
+}
+
+static void release_pack(uint8_t *data, size_t size) {
+#ifdef __EMSCRIPTEN__
+  free(data);
+#else
+  munmap(data, size);
+#endif
+}
+
+asset_pack_t *asset_pack_open(const char *path) {
+  size_t size = 0;
+  uint8_t *data = read_pack(path, &size);
+  if (data == NULL) {
+    return NULL;
+  }
+  pack_header_t *header = (pack_header_t *)data;
+  // in 64 bits, since size_t is 32 bits in the browser build
+  if (size < sizeof(pack_header_t) ||
+      memcmp(header->magic, PACK_MAGIC, sizeof(header->magic)) ||
+      header->version != PACK_VERSION ||
+      (uint64_t)header->num_entries * sizeof(pack_entry_t) >
+          size - sizeof(pack_header_t)) {
+    release_pack(data, size);
+    return NULL;
+  }
+  pack_entry_t *entries = (pack_entry_t *)(data + sizeof(pack_header_t));
+  for (size_t i = 0; i < header->num_entries; i++) {
+    if (memchr(entries[i].path, '\0', PACK_PATH_LENGTH) == NULL) {
+      release_pack(data, size);
+      return NULL;
+    }
+  }
+  asset_pack_t *pack = malloc(sizeof(asset_pack_t));
+  assert(pack != NULL);
+  *pack = (asset_pack_t){
+      .data = data, .size = size, .header = header, .entries = entries};
+  return pack;
+}
+
+void asset_pack_close(asset_pack_t *pack) {
+  release_pack(pack->data, pack->size);
+  free(pack->scratch);
+  free(pack);
+}
+
+size_t asset_pack_size(asset_pack_t *pack) {
+  return pack->header->num_entries;
+}
+
+char *asset_pack_path(asset_pack_t *pack, size_t index) {
+  assert(index < pack->header->num_entries);
+  return pack->entries[index].path;
+}
+
+static pack_entry_t *find_entry(asset_pack_t *pack, const char *path) {
+  for (size_t i = 0; i < pack->header->num_entries; i++) {
+    if (!strncmp(pack->entries[i].path, path, PACK_PATH_LENGTH)) {
+      return &pack->entries[i];
+    }
+  }
+  return NULL;
+}
+
+// an image's bytes have to lie inside the pack and hold exactly its pixels,
+// worked out in 64 bits so that nothing wraps in the browser build
+static bool valid_entry(asset_pack_t *pack, pack_entry_t *entry) {
+  uint64_t num_pixels = (uint64_t)entry->width * entry->height;
+  if (entry->width == 0 || entry->height == 0 ||
+      entry->width > INT_MAX / PACK_BYTES_PER_PIXEL ||
+      entry->height > INT_MAX ||
+      num_pixels > SIZE_MAX / PACK_BYTES_PER_PIXEL ||
+      entry->offset > pack->size || entry->size > pack->size - entry->offset) {
+    return false;
+  }
+  switch (entry->encoding) {
+  case PACK_RAW:
+    return entry->size == num_pixels * PACK_BYTES_PER_PIXEL;
+  case PACK_RLE:
+    return entry->offset % sizeof(uint32_t) == 0 &&
+           entry->size % (2 * sizeof(uint32_t)) == 0;
+  }
+  return false;
+}
+
+// the runs have to cover the image exactly, or pixels of the image decoded
+// before would show through
+static uint32_t *decode_rle(asset_pack_t *pack, pack_entry_t *entry) {
+  size_t num_pixels = (size_t)entry->width * entry->height;
+  if (num_pixels > pack->scratch_pixels) {
+    pack->scratch = realloc(pack->scratch, num_pixels * sizeof(uint32_t));
+    assert(pack->scratch != NULL);
+    pack->scratch_pixels = num_pixels;
+  }
+  uint32_t *runs = (uint32_t *)(pack->data + entry->offset);
+  size_t num_runs = entry->size / (2 * sizeof(uint32_t));
+  size_t pixel = 0;
+  for (size_t i = 0; i < num_runs; i++) {
+    uint32_t length = runs[2 * i];
+    uint32_t value = runs[2 * i + 1];
+    if (length > num_pixels - pixel) {
+      return NULL;
+    }
+    for (uint32_t j = 0; j < length; j++) {
+      pack->scratch[pixel++] = value;
+    }
+  }
+  return pixel == num_pixels ? pack->scratch : NULL;
+}
+
+SDL_Texture *asset_pack_texture(asset_pack_t *pack, SDL_Renderer *renderer,
+                                const char *path) {
+  pack_entry_t *entry = find_entry(pack, path);
+  if (entry == NULL || !valid_entry(pack, entry)) {
+    return NULL;
+  }
+  const void *pixels = pack->data + entry->offset;
+  if (entry->encoding == PACK_RLE) {
+    pixels = decode_rle(pack, entry);
+    if (pixels == NULL) {
+      return NULL;
+    }
+  }
+  SDL_Texture *texture =
+      SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32,
+                        SDL_TEXTUREACCESS_STATIC, entry->width, entry->height);
+  if (texture == NULL) {
+    return NULL;
+  }
+  SDL_UpdateTexture(texture, NULL, pixels,
+                    entry->width * PACK_BYTES_PER_PIXEL);
+  SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+  return texture;
+}
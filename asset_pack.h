@@ -0,0 +1,94 @@
+#ifndef __ASSET_PACK_H__
+#define __ASSET_PACK_H__
+
+#include <SDL2/SDL.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * An asset pack holds every image of the game already decoded to RGBA32.
+ * It is written by the pack_assets tool and laid out as
+ *   pack_header_t
+ *   pack_entry_t[num_entries]
+ *   pixel data, each image starting on a PACK_ALIGNMENT boundary
+ * All integers are little endian.
+ */
+#define PACK_MAGIC "HPAK"
+#define PACK_VERSION 1
+#define PACK_PATH_LENGTH 64
+#define PACK_ALIGNMENT 16
+#define PACK_BYTES_PER_PIXEL 4
+
+/**
+ * How an image's pixels are stored.
+ * PACK_RLE stores pairs of uint32_t (run length, RGBA pixel), which shrinks
+ * the large transparent areas of the sprites.
+ */
+typedef enum { PACK_RAW = 0, PACK_RLE = 1 } pack_encoding_t;
+
+typedef struct pack_header {
+  char magic[4];
+  uint32_t version;
+  uint32_t num_entries;
+  uint32_t reserved;
+} pack_header_t;
+
+typedef struct pack_entry {
+  char path[PACK_PATH_LENGTH];
+  uint32_t width;
+  uint32_t height;
+  uint64_t offset;
+  uint64_t size;
+  uint32_t encoding;
+  uint32_t reserved;
+} pack_entry_t;
+
+typedef struct asset_pack asset_pack_t;
+
+/**
+ * Opens an asset pack with a single read.
+ * Native builds map the file; the browser build reads it from the emscripten
+ * preload filesystem.
+ *
+ * @param path the path of the pack file
+ * @return the pack, or NULL if the file is missing or not a valid pack
+ */
+asset_pack_t *asset_pack_open(const char *path);
+
+/**
+ * Unmaps or frees the pack. Textures created from it stay valid.
+ *
+ * @param pack a pointer to a pack returned from asset_pack_open()
+ */
+void asset_pack_close(asset_pack_t *pack);
+
+/**
+ * Gets the number of images in the pack.
+ *
+ * @param pack a pointer to a pack returned from asset_pack_open()
+ * @return the number of images
+ */
+size_t asset_pack_size(asset_pack_t *pack);
+
+/**
+ * Gets the path an image was packed under, e.g. "for_images/bone.png".
+ *
+ * @param pack a pointer to a pack returned from asset_pack_open()
+ * @param index an index less than asset_pack_size(pack)
+ * @return the path of that image
+ */
+char *asset_pack_path(asset_pack_t *pack, size_t index);
+
+/**
+ * Creates a texture straight from the packed pixels of an image.
+ *
+ * @param pack a pointer to a pack returned from asset_pack_open()
+ * @param renderer the renderer that will draw the texture
+ * @param path the path the image was packed under
+ * @return the texture, or NULL if the image is not in the pack or its packed
+ *   pixels do not match its size
+ */
+SDL_Texture *asset_pack_texture(asset_pack_t *pack, SDL_Renderer *renderer,
+                                const char *path);
+
+#endif // #ifndef __ASSET_PACK_H__
@@ -0,0 +1,412 @@
+// Microbenchmarks of the list, shape, polygon, body and collision calls the
+// game makes every tick.
+//
+//   bench -n 1000 -b 100 -w 50 -f collision > bench.json
+//
+// Every benchmark is warmed up for a number of untimed batches, then timed
+// one batch at a time, and each sample is the batch time divided by the
+// batch size. The samples are summarised per benchmark and written as JSON
+// with a fixed key order and the benchmarks in table order, so two runs can
+// be diffed or compared by a script. Benchmarks run on one thread in the
+// order below, and their inputs are built outside the timed batches.
+//
+// -c adds the cycles, instructions, cache misses and branch misses of one
+// call, averaged over the timed batches, to every benchmark. A counter the
+// kernel does not allow is written as null.
+#include "body.h"
+#include "collision.h"
+#include "list.h"
+#include "perf_counters.h"
+#include "polygon.h"
+#include "shape.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_FORMAT_VERSION 1
+// the most items any list benchmark uses
+#define BENCH_ITEMS 1024
+
+static const size_t DEFAULT_SAMPLES = 1000;
+static const size_t DEFAULT_BATCH = 100;
+static const size_t DEFAULT_WARMUP = 50;
+
+// sizes of the inputs, close to what the levels use
+static const size_t LIST_ADD_ITEMS = 64;
+static const size_t LIST_GET_ITEMS = BENCH_ITEMS;
+static const size_t MERGED_LISTS = 4;
+static const size_t MERGED_ITEMS = 16;
+static const double RECT_WIDTH = 100;
+static const double RECT_HEIGHT = 20;
+static const double STAR_LENGTH = 15;
+static const double STAR_POINTS = 10;
+static const double PACMAN_RADIUS = 50;
+static const double ROTATE_ANGLE = 0.01;
+static const vector_t TRANSLATE_STEP = {1, 1};
+static const double BODY_MASS = 10;
+static const double BODY_ROTATION = 0.5;
+
+typedef struct bench_data {
+  list_t *list;
+  list_t *shape1;
+  list_t *shape2;
+  body_t *body;
+  void *items[BENCH_ITEMS];
+} bench_data_t;
+
+typedef struct benchmark {
+  const char *name;
+  void (*setup)(bench_data_t *data);
+  // one operation; iteration counts up from 0 across warmup and samples
+  void (*run)(bench_data_t *data, size_t iteration);
+  void (*teardown)(bench_data_t *data);
+} benchmark_t;
+
+typedef struct bench_stats {
+  double min_ns;
+  double median_ns;
+  double mean_ns;
+  double p90_ns;
+  double p99_ns;
+  double max_ns;
+  double stddev_ns;
+  double counters[NUM_COUNTERS];
+} bench_stats_t;
+
+// results are folded into this so the calls being timed are never dropped
+static volatile uintptr_t sink;
+
+static double now_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+static void sink_shape(list_t *shape) {
+  sink += list_size(shape);
+  list_free(shape);
+}
+
+static void setup_items(bench_data_t *data) {
+  for (size_t i = 0; i < BENCH_ITEMS; i++) {
+    data->items[i] = &data->items[i];
+  }
+}
+
+static void setup_list(bench_data_t *data) {
+  setup_items(data);
+  data->list = list_init(LIST_GET_ITEMS, NULL);
+  for (size_t i = 0; i < LIST_GET_ITEMS; i++) {
+    list_add(data->list, data->items[i]);
+  }
+}
+
+static void free_list(bench_data_t *data) { list_free(data->list); }
+
+// grows from one slot, like the lists the levels build
+static void run_list_add(bench_data_t *data, size_t iteration) {
+  list_t *list = list_init(1, NULL);
+  for (size_t i = 0; i < LIST_ADD_ITEMS; i++) {
+    list_add(list, data->items[i]);
+  }
+  sink += list_size(list);
+  list_free(list);
+}
+
+static void run_list_get(bench_data_t *data, size_t iteration) {
+  uintptr_t sum = 0;
+  for (size_t i = 0; i < LIST_GET_ITEMS; i++) {
+    sum += (uintptr_t)list_get(data->list, i);
+  }
+  sink += sum;
+}
+
+// the merged list only points at the items of the lists it was given, and
+// the outer list frees those lists, so nothing is freed twice
+static void run_list_merge(bench_data_t *data, size_t iteration) {
+  list_t *lists = list_init(MERGED_LISTS, (free_func_t)list_free);
+  for (size_t i = 0; i < MERGED_LISTS; i++) {
+    list_t *list = list_init(MERGED_ITEMS, NULL);
+    for (size_t j = 0; j < MERGED_ITEMS; j++) {
+      list_add(list, data->items[i * MERGED_ITEMS + j]);
+    }
+    list_add(lists, list);
+  }
+  list_t *merged = list_merge(lists);
+  sink += list_size(merged);
+  list_free(merged);
+  list_free(lists);
+}
+
+static void run_make_rectangle(bench_data_t *data, size_t iteration) {
+  sink_shape(make_rectangle(RECT_HEIGHT, RECT_WIDTH, 0, 0));
+}
+
+static void run_make_star(bench_data_t *data, size_t iteration) {
+  sink_shape(make_star(STAR_LENGTH, STAR_POINTS, 0, 0));
+}
+
+static void run_make_pacman(bench_data_t *data, size_t iteration) {
+  sink_shape(make_pacman(PACMAN_RADIUS, 0, 0));
+}
+
+static void setup_star(bench_data_t *data) {
+  data->shape1 = make_star(STAR_LENGTH, STAR_POINTS, 0, 0);
+}
+
+static void free_shapes(bench_data_t *data) {
+  list_free(data->shape1);
+  if (data->shape2 != NULL) {
+    list_free(data->shape2);
+  }
+}
+
+static void run_polygon_centroid(bench_data_t *data, size_t iteration) {
+  vector_t centroid = polygon_centroid(data->shape1);
+  sink += (uintptr_t)(centroid.x + centroid.y);
+}
+
+static void run_polygon_rotate(bench_data_t *data, size_t iteration) {
+  polygon_rotate(data->shape1, ROTATE_ANGLE, VEC_ZERO);
+}
+
+// steps back and forth so the star never drifts far from the origin
+static void run_polygon_translate(bench_data_t *data, size_t iteration) {
+  vector_t step = iteration % 2 == 0 ? TRANSLATE_STEP
+                                     : vec_negate(TRANSLATE_STEP);
+  polygon_translate(data->shape1, step);
+}
+
+static void setup_body(bench_data_t *data) {
+  list_t *shape = make_star(STAR_LENGTH, STAR_POINTS, 0, 0);
+  data->body = body_init_with_info(shape, BODY_MASS, (rgb_color_t){0, 0, 0},
+                                   NULL, NULL);
+  body_set_rotation(data->body, BODY_ROTATION);
+}
+
+static void free_body(bench_data_t *data) { body_free(data->body); }
+
+static void run_body_get_actual_shape(bench_data_t *data, size_t iteration) {
+  sink_shape(body_get_actual_shape(data->body));
+}
+
+// every pair overlaps, so each check runs through all of its axes
+static void setup_rect_rect(bench_data_t *data) {
+  data->shape1 = make_rectangle(RECT_HEIGHT, RECT_WIDTH, 0, 0);
+  data->shape2 =
+      make_rectangle(RECT_HEIGHT, RECT_WIDTH, RECT_WIDTH / 2, RECT_HEIGHT / 2);
+}
+
+static void setup_star_rect(bench_data_t *data) {
+  data->shape1 = make_star(STAR_LENGTH, STAR_POINTS, 0, 0);
+  data->shape2 = make_rectangle(RECT_HEIGHT, RECT_WIDTH, STAR_LENGTH, 0);
+}
+
+static void setup_pacman_rect(bench_data_t *data) {
+  data->shape1 = make_pacman(PACMAN_RADIUS, 0, 0);
+  data->shape2 = make_rectangle(RECT_HEIGHT, RECT_WIDTH, PACMAN_RADIUS, 0);
+}
+
+static void run_find_collision(bench_data_t *data, size_t iteration) {
+  collision_info_t hit = find_collision(data->shape1, data->shape2);
+  sink += get_collision_bool(hit);
+}
+
+static const benchmark_t BENCHMARKS[] = {
+    {"list_add", setup_items, run_list_add, NULL},
+    {"list_get", setup_list, run_list_get, free_list},
+    {"list_merge", setup_items, run_list_merge, NULL},
+    {"make_rectangle", NULL, run_make_rectangle, NULL},
+    {"make_star", NULL, run_make_star, NULL},
+    {"make_pacman", NULL, run_make_pacman, NULL},
+    {"polygon_centroid", setup_star, run_polygon_centroid, free_shapes},
+    {"polygon_rotate", setup_star, run_polygon_rotate, free_shapes},
+    {"polygon_translate", setup_star, run_polygon_translate, free_shapes},
+    {"body_get_actual_shape", setup_body, run_body_get_actual_shape,
+     free_body},
+    {"find_collision_rect_rect", setup_rect_rect, run_find_collision,
+     free_shapes},
+    {"find_collision_star_rect", setup_star_rect, run_find_collision,
+     free_shapes},
+    {"find_collision_pacman_rect", setup_pacman_rect, run_find_collision,
+     free_shapes},
+};
+static const size_t NUM_BENCHMARKS =
+    sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]);
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static double percentile(double *sorted, size_t count, double fraction) {
+  return sorted[(size_t)(fraction * (count - 1))];
+}
+
+static bench_stats_t summarise(double *samples, size_t count) {
+  qsort(samples, count, sizeof(double), compare_doubles);
+  double sum = 0;
+  for (size_t i = 0; i < count; i++) {
+    sum += samples[i];
+  }
+  double mean = sum / count;
+  double variance = 0;
+  for (size_t i = 0; i < count; i++) {
+    variance += (samples[i] - mean) * (samples[i] - mean);
+  }
+  return (bench_stats_t){.min_ns = samples[0],
+                         .median_ns = percentile(samples, count, 0.5),
+                         .mean_ns = mean,
+                         .p90_ns = percentile(samples, count, 0.9),
+                         .p99_ns = percentile(samples, count, 0.99),
+                         .max_ns = samples[count - 1],
+                         .stddev_ns = sqrt(variance / count)};
+}
+
+static bench_stats_t run_benchmark(const benchmark_t *bench,
+                                   double *samples, size_t num_samples,
+                                   size_t batch, size_t warmup,
+                                   perf_counters_t *counters) {
+  bench_data_t data = {0};
+  if (bench->setup != NULL) {
+    bench->setup(&data);
+  }
+  size_t iteration = 0;
+  for (size_t i = 0; i < warmup * batch; i++) {
+    bench->run(&data, iteration++);
+  }
+  uint64_t counters_start[NUM_COUNTERS] = {0};
+  if (counters != NULL) {
+    perf_counters_read(counters, counters_start);
+  }
+  for (size_t i = 0; i < num_samples; i++) {
+    double start = now_ns();
+    for (size_t j = 0; j < batch; j++) {
+      bench->run(&data, iteration++);
+    }
+    samples[i] = (now_ns() - start) / batch;
+  }
+  uint64_t counters_end[NUM_COUNTERS] = {0};
+  if (counters != NULL) {
+    perf_counters_read(counters, counters_end);
+  }
+  if (bench->teardown != NULL) {
+    bench->teardown(&data);
+  }
+  bench_stats_t stats = summarise(samples, num_samples);
+  for (size_t i = 0; i < NUM_COUNTERS; i++) {
+    stats.counters[i] =
+        (double)(counters_end[i] - counters_start[i]) / (num_samples * batch);
+  }
+  return stats;
+}
+
+// counted is whether -c was given; counters is NULL if it was but no
+// counter could be opened
+static void write_result(FILE *file, const benchmark_t *bench,
+                         bench_stats_t *stats, bool counted,
+                         perf_counters_t *counters, bool last) {
+  fprintf(file,
+          "    {\"name\": \"%s\", \"min_ns\": %.1f, \"median_ns\": %.1f, "
+          "\"mean_ns\": %.1f, \"p90_ns\": %.1f, \"p99_ns\": %.1f, "
+          "\"max_ns\": %.1f, \"stddev_ns\": %.1f",
+          bench->name, stats->min_ns, stats->median_ns, stats->mean_ns,
+          stats->p90_ns, stats->p99_ns, stats->max_ns, stats->stddev_ns);
+  for (size_t i = 0; counted && i < NUM_COUNTERS; i++) {
+    if (counters != NULL && perf_counters_available(counters, i)) {
+      fprintf(file, ", \"%s\": %.1f", perf_counter_name(i),
+              stats->counters[i]);
+    } else {
+      fprintf(file, ", \"%s\": null", perf_counter_name(i));
+    }
+  }
+  fprintf(file, "}%s\n", last ? "" : ",");
+}
+
+int main(int argc, char *argv[]) {
+  size_t num_samples = DEFAULT_SAMPLES;
+  size_t batch = DEFAULT_BATCH;
+  size_t warmup = DEFAULT_WARMUP;
+  const char *filter = NULL;
+  bool counted = false;
+  int option;
+  while ((option = getopt(argc, argv, "n:b:w:f:lc")) != -1) {
+    switch (option) {
+    case 'n':
+      num_samples = strtoul(optarg, NULL, 10);
+      break;
+    case 'b':
+      batch = strtoul(optarg, NULL, 10);
+      break;
+    case 'w':
+      warmup = strtoul(optarg, NULL, 10);
+      break;
+    case 'f':
+      filter = optarg;
+      break;
+    case 'c':
+      counted = true;
+      break;
+    case 'l':
+      for (size_t i = 0; i < NUM_BENCHMARKS; i++) {
+        printf("%s\n", BENCHMARKS[i].name);
+      }
+      return 0;
+    default:
+      fprintf(stderr,
+              "usage: %s [-n samples] [-b batch] [-w warmup batches] "
+              "[-f name filter] [-l] [-c]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+  if (num_samples == 0 || batch == 0) {
+    fprintf(stderr, "bench: samples and batch must be at least 1\n");
+    return 1;
+  }
+
+  // the benchmarks that match are counted first so the last one can be
+  // written without a trailing comma
+  size_t num_selected = 0;
+  for (size_t i = 0; i < NUM_BENCHMARKS; i++) {
+    num_selected += filter == NULL || strstr(BENCHMARKS[i].name, filter);
+  }
+  perf_counters_t *counters = NULL;
+  if (counted) {
+    counters = perf_counters_open();
+    if (counters == NULL) {
+      fprintf(stderr, "bench: hardware counters unavailable\n");
+    }
+  }
+  double *samples = malloc(num_samples * sizeof(double));
+  printf("{\n");
+  printf("  \"version\": %d,\n", BENCH_FORMAT_VERSION);
+  printf("  \"samples\": %zu,\n", num_samples);
+  printf("  \"batch\": %zu,\n", batch);
+  printf("  \"warmup\": %zu,\n", warmup);
+  printf("  \"benchmarks\": [\n");
+  size_t written = 0;
+  for (size_t i = 0; i < NUM_BENCHMARKS; i++) {
+    if (filter != NULL && !strstr(BENCHMARKS[i].name, filter)) {
+      continue;
+    }
+    bench_stats_t stats = run_benchmark(&BENCHMARKS[i], samples, num_samples,
+                                        batch, warmup, counters);
+    written++;
+    write_result(stdout, &BENCHMARKS[i], &stats, counted, counters,
+                 written == num_selected);
+  }
+  printf("  ]\n");
+  printf("}\n");
+  free(samples);
+  if (counters != NULL) {
+    perf_counters_close(counters);
+  }
+  return 0;
+}
@@ -0,0 +1,60 @@
+#include "frame_budget.h"
+#include <assert.h>
+#include <stdlib.h>
+
+// a quarter second over budget drops a tier
+static const size_t DEGRADE_FRAMES = 15;
+// two seconds with headroom to spare raises one
+static const size_t RECOVER_FRAMES = 120;
+static const double RECOVER_FRACTION = 0.75;
+
+struct frame_budget {
+  double budget_ms;
+  quality_tier_t tier;
+  size_t over;
+  size_t over_run;
+  size_t under_run;
+};
+
+frame_budget_t *frame_budget_init(double budget_ms) {
+  frame_budget_t *budget = malloc(sizeof(frame_budget_t));
+  assert(budget != NULL);
+  *budget = (frame_budget_t){.budget_ms = budget_ms, .tier = QUALITY_FULL};
+  return budget;
+}
+
+void frame_budget_free(frame_budget_t *budget) { free(budget); }
+
+bool frame_budget_record(frame_budget_t *budget, double frame_ms) {
+  if (frame_ms > budget->budget_ms) {
+    budget->over++;
+    budget->over_run++;
+    budget->under_run = 0;
+  } else {
+    budget->over_run = 0;
+    if (frame_ms < budget->budget_ms * RECOVER_FRACTION) {
+      budget->under_run++;
+    } else {
+      budget->under_run = 0;
+    }
+  }
+
+  if (budget->over_run >= DEGRADE_FRAMES &&
+      budget->tier < NUM_QUALITY_TIERS - 1) {
+    budget->tier++;
+    budget->over_run = 0;
+    return true;
+  }
+  if (budget->under_run >= RECOVER_FRAMES && budget->tier > QUALITY_FULL) {
+    budget->tier--;
+    budget->under_run = 0;
+    return true;
+  }
+  return false;
+}
+
+quality_tier_t frame_budget_tier(frame_budget_t *budget) {
+  return budget->tier;
+}
+
+size_t frame_budget_over(frame_budget_t *budget) { return budget->over; }
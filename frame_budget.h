@@ -0,0 +1,70 @@
+#ifndef __FRAME_BUDGET_H__
+#define __FRAME_BUDGET_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * How much work a frame does, from everything to the least that keeps the
+ * game playable. Each tier also does what the tiers above it skip.
+ */
+typedef enum {
+  // every tick is simulated and every overlay drawn
+  QUALITY_FULL,
+  // the aim guide and best path markers are neither computed nor drawn
+  QUALITY_NO_COSMETICS,
+  // new turtles spawn half as often
+  QUALITY_CAPPED_SPAWNS,
+  // the simulation steps every other tick with twice the time step
+  QUALITY_HALF_RATE,
+  NUM_QUALITY_TIERS
+} quality_tier_t;
+
+/**
+ * Compares frame times with a budget and picks the quality tier.
+ * A run of frames over budget drops one tier; a longer run of frames well
+ * under budget raises one, so the tier does not flicker around the limit.
+ */
+typedef struct frame_budget frame_budget_t;
+
+/**
+ * Allocates a frame budget at full quality.
+ *
+ * @param budget_ms the time a frame may take, in milliseconds
+ * @return the new frame budget
+ */
+frame_budget_t *frame_budget_init(double budget_ms);
+
+/**
+ * Releases the memory of a frame budget.
+ *
+ * @param budget a pointer to a frame budget returned from frame_budget_init()
+ */
+void frame_budget_free(frame_budget_t *budget);
+
+/**
+ * Records the time of one frame and moves the tier if needed.
+ *
+ * @param budget a pointer to a frame budget returned from frame_budget_init()
+ * @param frame_ms the time the frame took, in milliseconds
+ * @return true if the tier changed
+ */
+bool frame_budget_record(frame_budget_t *budget, double frame_ms);
+
+/**
+ * Gets the current tier.
+ *
+ * @param budget a pointer to a frame budget returned from frame_budget_init()
+ * @return the tier the next frame should run at
+ */
+quality_tier_t frame_budget_tier(frame_budget_t *budget);
+
+/**
+ * Gets how many recorded frames went over budget.
+ *
+ * @param budget a pointer to a frame budget returned from frame_budget_init()
+ * @return the number of frames longer than the budget
+ */
+size_t frame_budget_over(frame_budget_t *budget);
+
+#endif // #ifndef __FRAME_BUDGET_H__
@@ -1,78 +1,54 @@
+#include "alloc_track.h"
+#include "asset_pack.h"
 #include "body.h"
 #include "collision.h"
 #include "forces.h"
-#include "polygon.h"
+#include "frame_budget.h"
+#include "hoppergame.h"
+#include "input_queue.h"
+#include "level_compiler.h"
+#include "level_pack.h"
+#include "logger.h"
+#include "point_list.h"
+#include "pool.h"
+#include "profiler.h"
+#include "query.h"
+#include "render.h"
+#include "rules.h"
 #include "scene.h"
 #include "sdl_wrapper.h"
-#include "shape.h"
+#include "shape_cache.h"
+#include "snapshot.h"
 #include "state.h"
 #include "test_util.h"
-#include <emscripten.h>
+#include "world.h"
+#include <assert.h>
+#include <limits.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+#endif
 
-const double GRAVITY1 = 500;
 const double GRAVITY2 = 90;
 const double TURTLE_GRAVITY = 150;
-const size_t NUM_BONES = 36;
-const size_t NUM_DIFF_BONES = 3;
-const size_t NUM_PINEAPPLES = 1;
+const double TURTLE_SOFTENING = 10;
 const size_t INIT_NUM_HOPPERS = 3;
-const size_t NUM_SHELVES = 12;
-const size_t NUM_SUB_WINDOWS = 4;
-const size_t INIT_NUM_TURTLES = 10;
-const size_t SPAWN_TIME = 100;
 
 const double MARKER_LENGTH = 5;
-const double MARKER_VERTICES = 10;
-const double LILY_PAD_LENGTH = 50;
-const double NO_TURTLE_RADIUS = 100;
-const double NO_GOLDEN_BONE_RADIUS = 25;
-const double NO_BONE_RADIUS = 75;
+const double AIM_MARKER_LENGTH = 10;
 
 const rgb_color_t BLACK = {0.0, 0.0, 0.0};
 const rgb_color_t BLUE = {0.0, 0.0, 1.0};
 
-const rgb_color_t OPENING = {255.0 / 255.0, 251.0 / 255.0, 227.0 / 255.0};
-const rgb_color_t LEVEL_1_INSTRUCTIONS = {163.0 / 255.0, 200.0 / 255.0,
-                                          255.0 / 255.0};
-const rgb_color_t LEVEL_2_INSTRUCTIONS = {217.0 / 255.0, 148.0 / 255.0,
-                                          148.0 / 255.0};
-const rgb_color_t LEVEL_3_INSTRUCTIONS = {175.0 / 255.0, 218.0 / 255.0,
-                                          175.0 / 255.0};
-
-const rgb_color_t LOSING = {176.0 / 255.0, 193.0 / 255.0, 219.0 / 255.0};
-const rgb_color_t WINNING = {229.0 / 255.0, 196.0 / 255.0, 214.0 / 255.0};
-
-const rgb_color_t LEVEL_1 = {232.0 / 255.0, 232.0 / 255.0, 232.0 / 255.0};
-const rgb_color_t LEVEL_2 = {219.0 / 255.0, 138.0 / 255.0, 138.0 / 255.0};
-const rgb_color_t LEVEL_3_LILY_PAD = {102.0 / 255.0, 125.0 / 255.0,
-                                      102.0 / 255.0};
-const rgb_color_t LEVEL_3_GRASS = {155.0 / 255.0, 215.0 / 255.0, 156.0 / 255.0};
-const rgb_color_t LEVEL_3_POND = {200.0 / 250.0, 215.0 / 255.0, 245.0 / 255.0};
-
-const size_t HOPPER_MASS_2 = 10;
-const size_t HOPPER_MASS = 1000000;
-const size_t BONE_MASS = 5;
-const size_t PINEAPPLE_MASS = 10;
-const size_t SHELF_MASS = INFINITY;
-const size_t PAD_MASS = 100;
-const size_t TURTLE_MASS = 10;
-
-const double BONE_SCORE = 10.0;
-const double GOLDEN_BONE_SCORE = 20.0;
-const double PINEAPPLE_SCORE = 100.0;
-const double PORTAL_SCORE = 200.0;
-const double DECOY_BONE_SCORE = -50.0;
-const double TURTLE_SCORE = 100;
-
-const double GROUND_CR = 1.0;
 const double MIN_ELASTICITY = 0;
 const double MAX_ELASTICITY = 10;
-const double WALL_WIDTH = 10.0;
 const double WALL_ELASTICITY = 1.0;
 const double ELASTICITY_STEP = 0.05;
 const double POSITION_STEP = 10;
@@ -88,401 +64,901 @@ const double LEVEL3_RULES = 2.5;
 const double LEVEL3 = 3;
 const double FAIL = 3.5;
 const double WIN = 4;
+const double WIDE_LEVEL = 5;
 
 const vector_t WINDOW = (vector_t){.x = 1000, .y = 500};
 const double HALF_MULTIPLY = 0.5;
-const double QUARTER_MULTIPLY = 0.25;
-const double THIRD_MULTIPLY = 1.0 / 3.0;
-const double TWO_THIRD_MULTIPLY = 2.0 / 3.0;
 const size_t DOUBLE = 2;
-const size_t REMAINDER_2 = 2;
-const size_t REMAINDER_3 = 3;
-const size_t REMAINDER_4 = 4;
 
-const vector_t PORTAL_DIMENSIONS = (vector_t){.x = 20, .y = 100};
 const vector_t HOPPER_SIZE = (vector_t){50, 50};
-const vector_t BONE_SIZE = (vector_t){.x = 40, .y = 40};
-const vector_t PINEAPPLE_SIZE = (vector_t){.x = 50, .y = 50};
-const vector_t SHELF_SIZE = (vector_t){.x = 100, .y = 20};
-const vector_t TURTLE_SIZE = (vector_t){.x = 50, .y = 50};
-const double LILY_PIC_DIM = 3;
 
-const vector_t PORTAL_VELOCITY = (vector_t){.x = 0, .y = 100};
 const vector_t HOPPER_VELOCITY = (vector_t){.x = 300, .y = 100};
-const vector_t HOPPER_VELOCITY_2 = (vector_t){.x = 0, .y = 100};
 const vector_t PROJECTILE_VELOCITY = (vector_t){.x = 100, .y = 100};
 const vector_t MAX_VEL = (vector_t){.x = 200, .y = 200};
 
-const size_t HOPPER_IDX = 1;
-const size_t HOPPER_IDX_3 = 2;
-const size_t GROUND_IDX = 2;
-const size_t PORTAL_IDX_1 = 3;
-const size_t LILY_PAD_IDX = 1;
-const size_t GOLDEN_BONE_IDX = 3;
-const size_t PINEAPPLE_BOMB_IDX = 4;
+const size_t INIT_ATTRACTOR_CAPACITY = 16;
+const size_t INIT_CONTACT_CAPACITY = 64;
+
+// the best path shows one marker per bone on the best path of level 1; the
+// guide buffer holds the longer of the two guides
+const size_t BEST_PATH_POINTS = 9;
+const size_t AIM_GUIDE_POINTS = 20;
+const double AIM_RANGE = 1200;
+const double AIM_INDEX_CELL = 50;
+const size_t CONTACT_GRAIN = 16;
+// a pair that moved less than this relative to itself keeps its last contact
+const double CONTACT_SLOP = 1e-3;
+// FNV-1a, for comparing runs of one seed
+const uint64_t FINGERPRINT_SEED = 14695981039346656037ULL;
+const uint64_t FINGERPRINT_PRIME = 1099511628211ULL;
+
+const double ELASTICITY_LOG_INTERVAL_MS = 500;
+
+const int IDLE_FRAME_INTERVAL = 6;
+
+const double SIM_TICK = 1.0 / 60.0;
+const double NS_PER_SECOND = 1e9;
+const double MS_PER_SECOND = 1000.0;
+
+const char *ASSET_PACK_PATH = "for_images/assets.pack";
+const char *LEVEL_PACK_PATH = "for_levels/levels.pack";
+// what pack_levels is given when the pack is built
+const char *const LEVEL_SOURCES[] = {
+    "for_levels/level1.level", "for_levels/level2.level",
+    "for_levels/level3.level", "for_levels/screens.level",
+    "for_levels/wide.level"};
+const size_t NUM_LEVEL_SOURCES = 5;
+const char *HUD_FONT_PATH = "for_fonts/hud.ttf";
+const int HUD_POINT_SIZE = 20;
+
+const char PROFILER_KEY = 'p';
+const char *PROFILE_JSON_PATH = "profile.json";
+const char *PROFILE_CSV_PATH = "profile.csv";
 
-const size_t PROJECTILE_POINTS_MASS = 10;
 const size_t PROJECTILE_LENGTH = 15;
 
+typedef struct contact_set contact_set_t;
+
+// counts the live force creators the game registers itself; each one is
+// tied to the bodies it references, so the scene drops it in the same pass
+// that removes one of those bodies and its freer keeps the count in step.
+// Creators the library makes, such as create_rotating_collision()'s, have
+// no freer of the game's and are not counted
+// the tracked collisions of the current scene are checked together in
+// contacts, with the narrowphase split over pool when there is one; every
+// contact and removal they cause is reported to the level's rules
+typedef struct force_index {
+  size_t live;
+  contact_set_t *contacts;
+  pool_t *pool;
+  rules_t *rules;
+} force_index_t;
+
+typedef void (*level_key_handler_t)(char key, key_event_type_t type,
+                                   double held_time, state_t *state);
+
+// what a level does every tick besides its triggers and timers, NULL on the
+// screens between levels
+typedef void (*level_tick_handler_t)(state_t *state, double dt);
+
 typedef struct state {
   scene_t *scene;
+  force_index_t forces;
+  profiler_t *profiler;
+  logger_t *logger;
+  renderer_t *renderer;
+  level_key_handler_t on_key;
+  level_tick_handler_t on_tick;
   bool level_passed;
   size_t hoppers_left;
   bool projectile;
   double score;
   double active_level;
-  double time_passed;
-  double time_since_death;
+  // the tick of the rules' wheel at which level 1 began
+  size_t level1_start;
   bool cooldown_active;
   bool pineapple_state;
+  bool needs_render;
+  bool idle;
+  size_t idle_frames_skipped;
+  uint32_t seed;
+  double dt;
+  // key events wait here until the start of the next tick
+  input_queue_t *input;
+  // the simulation thread holds lock while it steps, the profiler overlay
+  // takes it from the render thread
+  pthread_mutex_t lock;
+  pthread_t simulation;
+  atomic_bool running;
+  snapshot_buffer_t *snapshots;
+  size_t ticks;
+  double render_ms;
+  // the frames the main loop drew and their draw calls, which only the main
+  // loop touches
+  size_t frames_drawn;
+  size_t draw_calls;
+  size_t max_draw_calls;
+  // the best path of level 1 or the aim of level 3, drawn over the scene
+  spatial_index_t *aim_index;
+  vector_t *guide;
+  size_t guide_length;
+  bool show_best_path;
+  bool aim_hit;
+  vector_t aim_point;
+  // set by the simulation thread from how long its frames take, the
+  // browser build sheds work under load and headless sessions have no budget
+  frame_budget_t *budget;
+  quality_tier_t quality;
+  // the compiled levels, the level being played and the positions its point
+  // sets are drawn into, sized once for the largest level
+  level_pack_t *levels;
+  level_entry_t *level;
+  point_list_t level_points;
+  // levels wider than the window scroll with the hopper, and the streamed
+  // bodies far from the camera wait in the world instead of the scene
+  world_t *world;
+  vector_t camera;
+  // the bodies the level handlers move, found by kind when a level loads
+  body_t *hopper;
+  body_t *portal;
+  body_t *lily_pad;
+  // the motion rules test the corners of the hopper and portals every tick
+  shape_cache_t *hopper_shape;
+  shape_cache_t *portal_shape;
+  // what the simulation thread had allocated when the current level began,
+  // and the objects earlier levels left behind. Marks are per thread, so
+  // level_held keeps what the first level allocated on the thread that made
+  // the session, for the thread that runs it to adopt
+  alloc_mark_t level_mark;
+  alloc_mark_t level_held;
+  size_t leaks;
 } state_t;
 
-typedef struct status {
-  bool hopper_status;
-  bool golden_bone_status;
-  bool pineapple_status;
-  bool portal_status;
-} status_t;
-
-// checks if any special bodies are in the scene still
-status_t check_status(scene_t *curr_scene) {
-  bool hopper_tracker = 0;
-  bool golden_bone_tracker = 0;
-  bool pineapple_tracker = 0;
-  bool portal_tracker = 0;
-  for (size_t i = 0; i < scene_bodies(curr_scene); i++) {
-    char *info = body_get_info(scene_get_body(curr_scene, i));
-    if (!strcmp(info, "Hopper")) {
-      hopper_tracker = 1;
-    } else if (!strcmp(info, "Golden Bone")) {
-      golden_bone_tracker = 1;
-    } else if (!strcmp(info, "Pineapple")) {
-      pineapple_tracker = 1;
-    } else if (!strcmp(info, "Portal")) {
-      portal_tracker = 1;
+void force_index_add(force_index_t *index) {
+  index->live++;
+}
+
+void force_index_drop(force_index_t *index) { index->live--; }
+
+size_t tracked_force_creators(state_t *state) { return state->forces.live; }
+
+// xorshift32 on the session's own seed, so that sessions running side by side
+// never share a generator and a seed always replays the same level
+int random_int(state_t *state) {
+  uint32_t x = state->seed;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  state->seed = x;
+  return x & INT_MAX;
+}
+
+typedef struct contact_token contact_token_t;
+
+// a pair of bodies whose handler runs when they start touching
+// body1 reads both shapes, the handler writes (removes) one or both bodies
+// or bounces them apart
+typedef struct contact_pair {
+  body_t *body1;
+  body_t *body2;
+  // the token that holds the pair's slot, while the pair is alive
+  contact_token_t *token;
+  collision_handler_t handler;
+  double elasticity;
+  bool alive;
+  bool touching;
+  collision_info_t hit;
+  // the relative pose hit was found at; while the bodies keep it, such as a
+  // hopper resting on the ground or a bone waiting on a shelf, the pair
+  // reuses hit instead of running the narrowphase again
+  bool cached;
+  vector_t offset;
+  double rotation1;
+  double rotation2;
+} contact_pair_t;
+
+// what a contact handler gets as aux
+typedef struct contact_context {
+  rules_t *rules;
+  double elasticity;
+} contact_context_t;
+
+// all tracked collisions of one scene, checked by a single force creator:
+// the narrowphase of every pair only reads shapes, so it runs in parallel,
+// then the handlers run on the ticking thread in the order the pairs were
+// added, which gives the same result as one force creator per pair. Only
+// this narrowphase is parallel; each pair still has a no-op library creator
+// for its lifetime, and the attractor and physics run serially in
+// scene_tick. rollout -v checks that serial and parallel runs match
+struct contact_set {
+  scene_t *scene;
+  force_index_t *index;
+  size_t refs;
+  contact_pair_t *pairs;
+  size_t num_pairs;
+  size_t num_dead;
+  size_t capacity;
+  size_t *live;
+};
+
+// ties a pair to its two bodies, so the pair dies with either of them
+struct contact_token {
+  contact_set_t *set;
+  size_t pair;
+};
+
+void contact_set_release(contact_set_t *set) {
+  set->refs--;
+  if (set->refs > 0) {
+    return;
+  }
+  if (set->index->contacts == set) {
+    set->index->contacts = NULL;
+  }
+  alloc_track_free(set->pairs);
+  alloc_track_free(set->live);
+  alloc_track_free(set);
+}
+
+void contact_set_free(void *aux) {
+  contact_set_t *set = aux;
+  force_index_drop(set->index);
+  contact_set_release(set);
+}
+
+// true when the bodies of a pair are where they were when its hit was found
+bool contact_cached(contact_pair_t *pair, vector_t offset, double rotation1,
+                    double rotation2) {
+  return pair->cached && rotation1 == pair->rotation1 &&
+         rotation2 == pair->rotation2 &&
+         fabs(offset.x - pair->offset.x) < CONTACT_SLOP &&
+         fabs(offset.y - pair->offset.y) < CONTACT_SLOP;
+}
+
+void find_contacts(size_t start, size_t end, void *aux) {
+  contact_set_t *set = aux;
+  for (size_t i = start; i < end; i++) {
+    contact_pair_t *pair = &set->pairs[set->live[i]];
+    vector_t offset = vec_subtract(body_get_centroid(pair->body2),
+                                   body_get_centroid(pair->body1));
+    double rotation1 = body_get_rotation(pair->body1);
+    double rotation2 = body_get_rotation(pair->body2);
+    if (contact_cached(pair, offset, rotation1, rotation2)) {
+      continue;
     }
+    // the library hands out a new copy of each shape
+    list_t *shape1 = body_get_actual_shape(pair->body1);
+    list_t *shape2 = body_get_actual_shape(pair->body2);
+    pair->hit = find_collision(shape1, shape2);
+    list_free(shape1);
+    list_free(shape2);
+    pair->cached = true;
+    pair->offset = offset;
+    pair->rotation1 = rotation1;
+    pair->rotation2 = rotation2;
   }
-  return (status_t){.hopper_status = hopper_tracker,
-                    .golden_bone_status = golden_bone_tracker,
-                    .pineapple_status = pineapple_tracker,
-                    .portal_status = portal_tracker};
 }
 
-list_t *make_hopper_shape() {
-  return make_rectangle(HOPPER_SIZE.y, HOPPER_SIZE.x,
-                        HOPPER_SIZE.x * HALF_MULTIPLY,
-                        HOPPER_SIZE.y * HALF_MULTIPLY);
+// drops the dead pairs once they are half of the array, keeping the live
+// ones in the order they were added, so checking the pairs costs what the
+// live ones cost however many pairs bodies streaming in and out have left
+void compact_contacts(contact_set_t *set) {
+  if (set->num_dead * DOUBLE < set->num_pairs) {
+    return;
+  }
+  size_t kept = 0;
+  for (size_t i = 0; i < set->num_pairs; i++) {
+    if (set->pairs[i].alive) {
+      set->pairs[kept] = set->pairs[i];
+      set->pairs[kept].token->pair = kept;
+      kept++;
+    }
+  }
+  set->num_pairs = kept;
+  set->num_dead = 0;
 }
 
-void populate_background(scene_t *scene, char *img_path) {
-  list_t *bg_shape = make_rectangle(
-      WINDOW.y, WINDOW.x, WINDOW.x * HALF_MULTIPLY, WINDOW.y * HALF_MULTIPLY);
-  body_t *bg = body_init_with_info(bg_shape, 1, BLACK, "Background", NULL);
-  body_set_img_texture(bg, img_path);
-  body_set_dimensions(bg, (vector_t){WINDOW.x, WINDOW.y});
-  scene_add_body(scene, bg);
+void apply_contacts(void *aux) {
+  contact_set_t *set = aux;
+  compact_contacts(set);
+  size_t num_live = 0;
+  for (size_t i = 0; i < set->num_pairs; i++) {
+    if (set->pairs[i].alive) {
+      set->live[num_live++] = i;
+    }
+  }
+  pool_parallel_for(set->index->pool, num_live, CONTACT_GRAIN, find_contacts,
+                    set);
+  for (size_t i = 0; i < num_live; i++) {
+    contact_pair_t *pair = &set->pairs[set->live[i]];
+    bool collided = get_collision_bool(pair->hit);
+    if (collided && !pair->touching) {
+      contact_context_t context = {.rules = set->index->rules,
+                                   .elasticity = pair->elasticity};
+      rules_contact(context.rules, pair->body1, pair->body2);
+      pair->handler(pair->body1, pair->body2, pair->hit.axis, &context);
+    }
+    pair->touching = collided;
+  }
 }
 
-void populate_hopper(scene_t *scene, rgb_color_t color) {
-  // add hopper to scene bodies
-  list_t *hopper_shape = make_hopper_shape();
-  body_t *hopper =
-      body_init_with_info(hopper_shape, HOPPER_MASS, color, "Hopper", NULL);
-  body_set_score(hopper, 0.0);
-  body_set_dimensions(hopper, HOPPER_SIZE);
-  body_set_elasticity(hopper, GROUND_CR);
-  body_set_img_texture(hopper, "for_images/hopper.png");
-  scene_add_body(scene, hopper);
+// the contact set of a scene is made with its first tracked collision and
+// freed with the scene
+contact_set_t *get_contact_set(scene_t *scene, force_index_t *index) {
+  if (index->contacts != NULL && index->contacts->scene == scene) {
+    return index->contacts;
+  }
+  contact_set_t *set = alloc_track_malloc(ALLOC_FORCE, sizeof(contact_set_t));
+  *set = (contact_set_t){.scene = scene,
+                         .index = index,
+                         .refs = 1,
+                         .capacity = INIT_CONTACT_CAPACITY};
+  set->pairs = alloc_track_malloc(ALLOC_FORCE,
+                                  set->capacity * sizeof(contact_pair_t));
+  set->live = alloc_track_malloc(ALLOC_FORCE, set->capacity * sizeof(size_t));
+  index->contacts = set;
+  force_index_add(index);
+  scene_add_force_creator(scene, apply_contacts, set, contact_set_free);
+  return set;
 }
 
-void populate_transition_scene(state_t *state, bool success) {
-  srand(time(NULL));
-  scene_t *curr_scene = state->scene;
+// pairs are checked by apply_contacts, this creator only holds the bodies
+void keep_contact(void *aux) {}
+
+void contact_token_free(void *aux) {
+  contact_token_t *token = aux;
+  contact_set_t *set = token->set;
+  set->pairs[token->pair].alive = false;
+  set->num_dead++;
+  force_index_drop(set->index);
+  contact_set_release(set);
+  alloc_track_free(token);
+}
 
-  // background at index 0
-  if (success) {
-    populate_background(curr_scene, "for_images/Winning_Screen_FINAL.png");
-  } else {
-    populate_background(curr_scene, "for_images/Losing_Screen_FINAL.png");
+// removes a body once, telling the level's rules first
+void destroy_body(rules_t *rules, body_t *body) {
+  if (!body_is_removed(body)) {
+    rules_destroyed(rules, body);
+    body_remove(body);
   }
+}
+
+void destroy_both(body_t *body1, body_t *body2, vector_t axis, void *aux) {
+  contact_context_t *context = aux;
+  destroy_body(context->rules, body1);
+  destroy_body(context->rules, body2);
+}
 
-  // hopper at index 1
-  populate_hopper(curr_scene, LOSING);
-  body_t *hopper = scene_get_body(curr_scene, HOPPER_IDX);
-  if (state->active_level == LEVEL3) {
-    hopper = scene_get_body(curr_scene, HOPPER_IDX_3 + 1);
+void destroy_second(body_t *body1, body_t *body2, vector_t axis, void *aux) {
+  contact_context_t *context = aux;
+  destroy_body(context->rules, body2);
+}
+
+// the impulse create_physics_collision applies, along the separating axis
+void bounce(body_t *body1, body_t *body2, vector_t axis, void *aux) {
+  contact_context_t *context = aux;
+  double mass1 = body_get_mass(body1);
+  double mass2 = body_get_mass(body2);
+  double reduced_mass = mass1 * mass2 / (mass1 + mass2);
+  if (mass1 == INFINITY) {
+    reduced_mass = mass2;
+  } else if (mass2 == INFINITY) {
+    reduced_mass = mass1;
   }
-  vector_t lower_centre = {WINDOW.x * HALF_MULTIPLY,
-                           HOPPER_SIZE.y * HALF_MULTIPLY};
-  body_set_centroid(hopper, lower_centre);
-  if (success) {
-    body_set_color(hopper, WINNING);
+  double u1 = vec_dot(body_get_velocity(body1), axis);
+  double u2 = vec_dot(body_get_velocity(body2), axis);
+  double impulse = reduced_mass * (1 + context->elasticity) * (u2 - u1);
+  body_add_impulse(body1, vec_multiply(impulse, axis));
+  body_add_impulse(body2, vec_multiply(-impulse, axis));
+}
+
+void create_tracked_collision(scene_t *scene, force_index_t *index,
+                              body_t *body1, body_t *body2,
+                              collision_handler_t handler, double elasticity) {
+  contact_set_t *set = get_contact_set(scene, index);
+  if (set->num_pairs == set->capacity) {
+    set->capacity *= DOUBLE;
+    set->pairs = alloc_track_realloc(ALLOC_FORCE, set->pairs,
+                                     set->capacity * sizeof(contact_pair_t));
+    set->live = alloc_track_realloc(ALLOC_FORCE, set->live,
+                                    set->capacity * sizeof(size_t));
   }
+  contact_token_t *token =
+      alloc_track_malloc(ALLOC_FORCE, sizeof(contact_token_t));
+  *token = (contact_token_t){.set = set, .pair = set->num_pairs};
+  set->pairs[set->num_pairs] = (contact_pair_t){.body1 = body1,
+                                                .body2 = body2,
+                                                .token = token,
+                                                .handler = handler,
+                                                .elasticity = elasticity,
+                                                .alive = true};
+  set->num_pairs++;
+  set->refs++;
+
+  list_t *bodies = list_init(DOUBLE, NULL);
+  list_add(bodies, body1);
+  list_add(bodies, body2);
+  force_index_add(index);
+  scene_add_bodies_force_creator(scene, keep_contact, token, bodies,
+                                 contact_token_free);
 }
 
-void end_init(state_t *curr_state) {
-  scene_free(curr_state->scene);
-  scene_t *end_scene = scene_init();
-  curr_state->scene = end_scene;
-  curr_state->level_passed = true;
-  curr_state->active_level = WIN;
-  populate_transition_scene(curr_state, 1);
+// removes both bodies when they collide
+void create_tracked_destructive_collision(scene_t *scene, force_index_t *index,
+                                          body_t *body1, body_t *body2) {
+  create_tracked_collision(scene, index, body1, body2, destroy_both, 0);
 }
 
-void fail_init(state_t *curr_state) {
-  scene_free(curr_state->scene);
-  scene_t *end_scene = scene_init();
-  curr_state->scene = end_scene;
-  curr_state->level_passed = false;
-  curr_state->active_level = FAIL;
-  populate_transition_scene(curr_state, 0);
+// removes only body2 when the bodies collide
+void create_tracked_one_destructive_collision(scene_t *scene,
+                                              force_index_t *index,
+                                              body_t *body1, body_t *body2) {
+  create_tracked_collision(scene, index, body1, body2, destroy_second, 0);
 }
 
-// makes hopper travel in projectile motion
-void projectile_motion(state_t *state, double dt) {
-  body_t *body = scene_get_body(state->scene, HOPPER_IDX);
-  list_t *vertices = body_get_shape(body);
-  vector_t distance = vec_multiply(dt, body_get_velocity(body));
-  vector_t curr_vel = body_get_velocity(body);
-  for (size_t i = 0; i < list_size(vertices); i++) {
-    vector_t *vector = list_get(vertices, i);
-    double y = vector->y + distance.y;
-    if ((y < 0) && (check_status(state->scene).portal_status)) {
-      state->hoppers_left = state->hoppers_left - 1;
-      state->time_since_death = 0;
-      state->cooldown_active = true;
-      // if there are no more tries, then the player has failed
-      if (state->hoppers_left == 0) {
-        fail_init(state);
-        break;
-      } else {
-        body_set_velocity(body, VEC_ZERO);
-        body_set_centroid(body, (vector_t){HOPPER_SIZE.x * HALF_MULTIPLY,
-                                           HOPPER_SIZE.y * HALF_MULTIPLY});
-        state->projectile = false;
-        break;
-      }
-    } else {
-      body_set_velocity(body,
-                        (vector_t){curr_vel.x, (curr_vel.y - GRAVITY2 * dt)});
-    }
+// bounces the bodies apart when they collide, like create_physics_collision,
+// but as a cached pair of the contact set
+void create_tracked_physics_collision(scene_t *scene, force_index_t *index,
+                                      double elasticity, body_t *body1,
+                                      body_t *body2) {
+  create_tracked_collision(scene, index, body1, body2, bounce, elasticity);
+}
+
+// the info of every body is a record that the body owns and frees, naming
+// its kind and holding the vertices of its shape, so a body is made from its
+// kind with one copy and bodies and their shapes are counted until the
+// library frees them
+typedef struct body_record {
+  char kind[LEVEL_NAME_LENGTH];
+  level_kind_t *def;
+  size_t shape_bytes;
+  vector_t vertices[];
+} body_record_t;
+
+void body_record_free(void *info) {
+  body_record_t *record = info;
+  alloc_track_remove(ALLOC_SHAPE, record->shape_bytes);
+  alloc_track_free(record);
+}
+
+// the shape list only points into the record, so the library frees the list
+// and the record frees the vertices
+body_t *make_body(level_pack_t *pack, level_kind_t *kind, vector_t centroid) {
+  size_t vertex_bytes = kind->num_vertices * sizeof(vector_t);
+  body_record_t *record =
+      alloc_track_malloc(ALLOC_BODY, sizeof(body_record_t) + vertex_bytes);
+  *record = (body_record_t){
+      .def = kind, .shape_bytes = kind->num_vertices * sizeof(vector_t *)};
+  memcpy(record->kind, kind->name, LEVEL_NAME_LENGTH);
+  vector_t *vertices = level_pack_vertices(pack, kind);
+  list_t *shape = list_init(kind->num_vertices, NULL);
+  for (size_t i = 0; i < kind->num_vertices; i++) {
+    record->vertices[i] = vec_add(vertices[i], centroid);
+    list_add(shape, &record->vertices[i]);
+  }
+  alloc_track_add(ALLOC_SHAPE, record->shape_bytes);
+  rgb_color_t color = {kind->color[0], kind->color[1], kind->color[2]};
+  body_t *body =
+      body_init_with_info(shape, kind->mass, color, record, body_record_free);
+  body_set_score(body, kind->score);
+  body_set_elasticity(body, kind->elasticity);
+  body_set_velocity(body, kind->velocity);
+  if (kind->rotation != 0) {
+    body_set_rotation(body, kind->rotation);
   }
+  if (kind->sprite[0] != '\0') {
+    body_set_dimensions(body, kind->sprite_size);
+  }
+  return body;
+}
+
+level_kind_t *body_kind(body_t *body) {
+  body_record_t *record = body_get_info(body);
+  return record->def;
+}
+
+// drops the triggers, timers and tick handler of the level being left
+void end_level_rules(state_t *state) {
+  rules_clear(state->forces.rules);
+  state->on_tick = NULL;
+}
+
+// scenes are made by the library, so only their number is counted
+scene_t *new_scene(void) {
+  alloc_track_add(ALLOC_SCENE, 0);
+  return scene_init();
+}
+
+void free_scene(scene_t *scene) {
+  scene_free(scene);
+  alloc_track_remove(ALLOC_SCENE, 0);
 }
 
-void add_score(state_t *state, body_t *player, body_t *collided_body) {
-  list_t *player_shape = body_get_actual_shape(player);
-  list_t *collided_shape = body_get_actual_shape(collided_body);
-  if ((collided_shape != NULL) && (player_shape != NULL)) {
-    if (get_collision_bool(find_collision(player_shape, collided_shape))) {
-      state->score = state->score + body_get_score(collided_body);
+// textures belong to the renderer and outlive levels, so they are not
+// checked
+const char *const LEAK_FORMATS[] = {
+    "Level left %.0f scenes behind", "Level left %.0f bodies behind",
+    "Level left %.0f shapes behind", "Level left %.0f force creators behind",
+    "Level left %.0f lists behind"};
+
+// everything a level allocates hangs off its scene, so once the scene is
+// freed nothing allocated since the level began may still be live
+void check_level_leaks(state_t *state) {
+  alloc_mark_t residual = alloc_track_since(&state->level_mark);
+  for (size_t tag = 0; tag < ALLOC_TEXTURE; tag++) {
+    if (residual.count[tag] > 0) {
+      LOG_VALUE(state->logger, LOG_CHANNEL_LEVEL, LOG_WARN,
+                LEAK_FORMATS[tag], residual.count[tag]);
+      state->leaks += residual.count[tag];
     }
   }
+  state->level_mark = alloc_track_mark();
 }
 
-void add_score_level3(state_t *state) {
-  status_t status = check_status(state->scene);
-  if (!status.golden_bone_status) {
-    state->score += GOLDEN_BONE_SCORE;
+void free_world(state_t *state) {
+  if (state->world != NULL) {
+    world_free(state->world);
+    state->world = NULL;
   }
-  if ((!status.pineapple_status) && (state->pineapple_state == 1)) {
-    state->score += PINEAPPLE_SCORE;
-    state->pineapple_state = 0;
+  state->camera = VEC_ZERO;
+}
+
+// leaves the current level for an empty scene
+scene_t *replace_scene(state_t *state) {
+  end_level_rules(state);
+  free_scene(state->scene);
+  free_world(state);
+  check_level_leaks(state);
+  state->scene = new_scene();
+  return state->scene;
+}
+
+int level_random(void *aux) { return random_int(aux); }
+
+level_kind_t *find_kind(state_t *state, const char *name) {
+  level_kind_t *kind = level_pack_find_kind(state->levels, state->level, name);
+  assert(kind != NULL);
+  return kind;
+}
+
+void create_level_collision(state_t *state, level_collision_t *collision,
+                            body_t *body1, body_t *body2) {
+  scene_t *scene = state->scene;
+  force_index_t *forces = &state->forces;
+  switch (collision->type) {
+  case COLLIDE_DESTROY_SECOND:
+    create_tracked_one_destructive_collision(scene, forces, body1, body2);
+    break;
+  case COLLIDE_DESTROY_BOTH:
+    create_tracked_destructive_collision(scene, forces, body1, body2);
+    break;
+  case COLLIDE_BOUNCE:
+    create_tracked_physics_collision(scene, forces, collision->elasticity,
+                                     body1, body2);
+    break;
+  case COLLIDE_ROTATE:
+    create_rotating_collision(scene, body1, body2);
+    break;
   }
-  if (!status.hopper_status) {
-    fail_init(state);
-  } else {
-    for (size_t i = PINEAPPLE_BOMB_IDX + 1; i < scene_bodies(state->scene);
-         i++) {
-      body_t *body = scene_get_body(state->scene, i);
-      list_t *projectile;
-      if (!strcmp(body_get_info(body), "Brick Projectile")) {
-        projectile = body_get_actual_shape(body);
-
-        for (size_t j = PINEAPPLE_BOMB_IDX + 1; j < scene_bodies(state->scene);
-             j++) {
-          body_t *body2 = scene_get_body(state->scene, j);
-          if (!strcmp(body_get_info(body2), "Turtle")) {
-            list_t *turtle_shape = body_get_actual_shape(body2);
-            if (get_collision_bool(find_collision(projectile, turtle_shape))) {
-              state->score = state->score + TURTLE_SCORE;
-            }
-          }
-        }
+}
+
+// gives body the collisions its level describes with each of the first
+// num_bodies bodies of the scene, so every pair is made once whether the
+// bodies arrive together or one is spawned later
+void add_level_collisions(state_t *state, body_t *body, size_t num_bodies) {
+  level_entry_t *level = state->level;
+  level_kind_t *kinds = level_pack_kinds(state->levels, level);
+  level_collision_t *collisions = level_pack_collisions(state->levels, level);
+  level_kind_t *kind = body_kind(body);
+  for (size_t i = 0; i < level->num_collisions; i++) {
+    level_kind_t *kind1 = &kinds[collisions[i].kind1];
+    level_kind_t *kind2 = &kinds[collisions[i].kind2];
+    if (kind != kind1 && kind != kind2) {
+      continue;
+    }
+    for (size_t j = 0; j < num_bodies; j++) {
+      body_t *other = scene_get_body(state->scene, j);
+      if (body_is_removed(other)) {
+        continue;
+      }
+      if (kind == kind1 && body_kind(other) == kind2) {
+        create_level_collision(state, &collisions[i], body, other);
+      } else if (kind == kind2 && body_kind(other) == kind1) {
+        create_level_collision(state, &collisions[i], other, body);
       }
     }
   }
 }
 
-void show_best_path(list_t *pos_list, scene_t *scene) {
-  for (size_t i = 0; i < list_size(pos_list); i++) {
-    list_t *shape = make_star(MARKER_LENGTH, MARKER_VERTICES,
-                              ((vector_t *)list_get(pos_list, i))->x,
-                              ((vector_t *)list_get(pos_list, i))->y);
-    body_t *marker = body_init_with_info(shape, 1, BLACK, "Marker", NULL);
-    scene_add_body(scene, marker);
+// makes a body of a kind of the current level at a point, colliding with the
+// bodies already there
+body_t *spawn_body(state_t *state, level_kind_t *kind, vector_t centroid) {
+  body_t *body = make_body(state->levels, kind, centroid);
+  scene_add_body(state->scene, body);
+  add_level_collisions(state, body, scene_bodies(state->scene) - 1);
+  return body;
+}
+
+// draws a spawn's points again and makes a body at each, returning the last
+body_t *spawn_level_bodies(state_t *state, level_spawn_t *spawn) {
+  level_entry_t *level = state->level;
+  level_kind_t *kind = &level_pack_kinds(state->levels, level)[spawn->kind];
+  level_point_set_t *set =
+      &level_pack_point_sets(state->levels, level)[spawn->point_set];
+  vector_t *points = point_list_data(&state->level_points);
+  level_pack_generate(state->levels, level, spawn->point_set, points,
+                      level_random, state);
+  body_t *body = NULL;
+  for (size_t i = 0; i < set->count; i++) {
+    body = spawn_body(state, kind, points[set->first_point + i]);
   }
+  return body;
 }
 
-list_t *calculate_bone_positions_1(scene_t *scene, size_t num_bones) {
-  list_t *pos_list = list_init(1, free);
-  double dt = 1.0;
-  for (size_t i = 0; i < num_bones; i++) {
-    vector_t *s = malloc(sizeof(vector_t));
-    s->y = (HOPPER_VELOCITY.y * dt) - (HALF_MULTIPLY * GRAVITY1 * dt);
-    s->x = (HOPPER_VELOCITY.x * dt);
-    dt++;
-    list_add(pos_list, s);
+level_spawn_t *find_spawn(state_t *state, const char *name) {
+  level_spawn_t *spawns = level_pack_spawns(state->levels, state->level);
+  level_kind_t *kind = find_kind(state, name);
+  for (size_t i = 0; i < state->level->num_spawns; i++) {
+    if (&level_pack_kinds(state->levels, state->level)[spawns[i].kind] ==
+        kind) {
+      return &spawns[i];
+    }
   }
-  return pos_list;
+  assert(false);
+  return NULL;
 }
 
-list_t *calculate_bone_positions_2(scene_t *scene, size_t num_bones) {
-  list_t *pos_list = list_init(1, free);
-  double dt = 0.0;
-  for (size_t i = 0; i < num_bones; i++) {
-    vector_t *s = malloc(sizeof(vector_t));
-    s->y = WINDOW.y * HALF_MULTIPLY + (HOPPER_VELOCITY.y * dt) -
-           (HALF_MULTIPLY * GRAVITY2 * dt * dt);
-    s->x = (HOPPER_VELOCITY.x * dt);
-    dt += HALF_MULTIPLY;
-    list_add(pos_list, s);
+// the timed spawns of a level come on the ticks where
+// ticks % interval == 1, and ticks are of simulated time since the start of
+// level 1; the interval doubles while spawns are capped
+size_t spawn_interval(state_t *state, level_spawn_t *spawn) {
+  size_t interval = spawn->interval;
+  if (state->quality >= QUALITY_CAPPED_SPAWNS) {
+    interval *= DOUBLE;
   }
-  return pos_list;
+  return interval;
 }
 
-list_t *calculate_bone_positions_rand(scene_t *scene, size_t num_bones) {
-  list_t *pos_list = list_init(1, free);
-  for (size_t i = 0; i < num_bones; i++) {
-    vector_t *pos = malloc(sizeof(vector_t));
-    *pos = (vector_t){(rand() % (int)WINDOW.x), (rand() % (int)WINDOW.y)};
-    while (((pos->x < NO_BONE_RADIUS) && (pos->y < NO_BONE_RADIUS))) {
-      *pos = (vector_t){(rand() % (int)WINDOW.x), (rand() % (int)WINDOW.y)};
+void spawn_timed(void *aux);
+
+// waits for the next timed spawn of the level, if it has any
+void schedule_spawns(state_t *state) {
+  level_spawn_t *spawns = level_pack_spawns(state->levels, state->level);
+  size_t ticks = rules_now(state->forces.rules) - state->level1_start;
+  size_t next = SIZE_MAX;
+  for (size_t i = 0; i < state->level->num_spawns; i++) {
+    if (spawns[i].interval == 0) {
+      continue;
     }
-    list_add(pos_list, pos);
+    size_t interval = spawn_interval(state, &spawns[i]);
+    size_t wait = (interval - ticks % interval) % interval + 1;
+    if (wait < next) {
+      next = wait;
+    }
+  }
+  if (next != SIZE_MAX) {
+    rules_after(state->forces.rules, next, spawn_timed);
   }
-  return pos_list;
 }
 
-vector_t calculate_pineapple_position(scene_t *scene) {
-  time_t t;
-  srand((unsigned)time(&t));
-  return (vector_t){(rand() % (int)(WINDOW.x * HALF_MULTIPLY)) +
-                        DOUBLE * NO_GOLDEN_BONE_RADIUS,
-                    (rand() % (int)(WINDOW.y * HALF_MULTIPLY)) +
-                        DOUBLE * NO_GOLDEN_BONE_RADIUS};
+void spawn_timed(void *aux) {
+  state_t *state = aux;
+  level_spawn_t *spawns = level_pack_spawns(state->levels, state->level);
+  size_t ticks = rules_now(state->forces.rules) - state->level1_start;
+  for (size_t i = 0; i < state->level->num_spawns; i++) {
+    if (spawns[i].interval == 0) {
+      continue;
+    }
+    size_t interval = spawn_interval(state, &spawns[i]);
+    if (ticks % interval == 1 % interval) {
+      spawn_level_bodies(state, &spawns[i]);
+    }
+  }
+  schedule_spawns(state);
+}
+
+// puts a body of a chunk that became active back in the scene as it was
+// when its chunk went dormant
+void activate_body(dormant_body_t *dormant, void *aux) {
+  state_t *state = aux;
+  level_kind_t *kind =
+      &level_pack_kinds(state->levels, state->level)[dormant->kind];
+  body_t *body = spawn_body(state, kind, dormant->centroid);
+  body_set_velocity(body, dormant->velocity);
+  body_set_rotation(body, dormant->rotation);
+  body_set_score(body, dormant->score);
+}
+
+// takes a body out of the scene into its chunk; it is not destroyed, so no
+// trigger of the level sees it go, and its collisions go with it
+void store_body(state_t *state, body_t *body) {
+  level_kind_t *kinds = level_pack_kinds(state->levels, state->level);
+  dormant_body_t dormant = {.kind = body_kind(body) - kinds,
+                            .centroid = body_get_centroid(body),
+                            .velocity = body_get_velocity(body),
+                            .rotation = body_get_rotation(body),
+                            .score = body_get_score(body)};
+  world_store(state->world, &dormant);
+  body_remove(body);
+}
+
+// keeps the hopper in the middle of the window until the camera reaches an
+// end of the level, activating the chunks the camera nears and storing the
+// streamed bodies of the chunks it leaves behind
+void scroll_world(state_t *state) {
+  world_t *world = state->world;
+  if (world == NULL || state->hopper == NULL) {
+    return;
+  }
+  double left = body_get_centroid(state->hopper).x - WINDOW.x * HALF_MULTIPLY;
+  state->camera.x = fmax(0, fmin(left, world_width(world) - WINDOW.x));
+  if (!world_set_view(world, state->camera.x, state->camera.x + WINDOW.x,
+                      activate_body, state)) {
+    return;
+  }
+  scene_t *scene = state->scene;
+  for (size_t i = 0; i < scene_bodies(scene); i++) {
+    body_t *body = scene_get_body(scene, i);
+    if (!body_is_removed(body) && body_kind(body)->streamed &&
+        !world_is_active(world, body_get_centroid(body).x)) {
+      store_body(state, body);
+    }
+  }
+  LOG_VALUE(state->logger, LOG_CHANNEL_LEVEL, LOG_DEBUG, "Dormant bodies: %.0f",
+            world_dormant(world));
 }
 
-list_t *make_bone_shape() {
-  return make_rectangle(BONE_SIZE.x * QUARTER_MULTIPLY,
-                        BONE_SIZE.y * HALF_MULTIPLY, 0, 0);
+body_t *find_body(state_t *state, const char *kind) {
+  level_kind_t *def =
+      level_pack_find_kind(state->levels, state->level, kind);
+  for (size_t i = 0; def != NULL && i < scene_bodies(state->scene); i++) {
+    body_t *body = scene_get_body(state->scene, i);
+    if (body_kind(body) == def) {
+      return body;
+    }
+  }
+  return NULL;
 }
 
-list_t *make_pineapple_shape() {
-  return make_rectangle(PINEAPPLE_SIZE.y, PINEAPPLE_SIZE.x, 0, 0);
+// fills the empty scene with a level of the pack: every point set is drawn
+// into the positions allocated for the largest level, each placement copies
+// its kind's shape to its points, and then the level's collisions pair the
+// bodies by kind. In a level wider than the window the streamed bodies start
+// dormant, and only the chunks by the camera are brought into the scene
+void load_level(state_t *state, const char *name) {
+  level_pack_t *pack = state->levels;
+  level_entry_t *level = level_pack_find(pack, name);
+  assert(level != NULL);
+  state->level = level;
+  if (level->world_width > WINDOW.x) {
+    state->world = world_init(level->world_width, level->chunk_width);
+    LOG_VALUE(state->logger, LOG_CHANNEL_LEVEL, LOG_INFO, "Level chunks: %.0f",
+              world_chunks(state->world));
+  }
+  vector_t *positions = point_list_data(&state->level_points);
+  for (size_t i = 0; i < level->num_point_sets; i++) {
+    level_pack_generate(pack, level, i, positions, level_random, state);
+  }
+  level_kind_t *kinds = level_pack_kinds(pack, level);
+  level_point_set_t *sets = level_pack_point_sets(pack, level);
+  level_placement_t *placements = level_pack_placements(pack, level);
+  for (size_t i = 0; i < level->num_placements; i++) {
+    level_placement_t *placement = &placements[i];
+    level_point_set_t *set = &sets[placement->point_set];
+    vector_t *points = &positions[set->first_point];
+    uint32_t *indices = level_pack_indices(pack, placement);
+    size_t count =
+        placement->num_indices > 0 ? placement->num_indices : set->count;
+    for (size_t j = 0; j < count; j++) {
+      size_t index = placement->num_indices > 0 ? indices[j] : j;
+      level_kind_t *kind = &kinds[placement->kind];
+      if (state->world != NULL && kind->streamed) {
+        dormant_body_t dormant = {
+            .kind = placement->kind,
+            .centroid = points[index],
+            .velocity = kind->velocity,
+            .rotation = kind->rotation,
+            .score = placement->has_score ? placement->score : kind->score};
+        world_store(state->world, &dormant);
+        continue;
+      }
+      body_t *body = make_body(pack, kind, points[index]);
+      if (placement->has_score) {
+        body_set_score(body, placement->score);
+      }
+      scene_add_body(state->scene, body);
+    }
+  }
+  for (size_t i = 0; i < scene_bodies(state->scene); i++) {
+    add_level_collisions(state, scene_get_body(state->scene, i), i);
+  }
+  state->hopper = find_body(state, "Hopper");
+  state->portal = find_body(state, "Portal");
+  state->lily_pad = find_body(state, "Lily Pad");
+  scroll_world(state);
+  schedule_spawns(state);
 }
 
-list_t *make_portal_shape() {
-  return make_rectangle(PORTAL_DIMENSIONS.y, PORTAL_DIMENSIONS.x,
-                        WINDOW.x - PORTAL_DIMENSIONS.y * HALF_MULTIPLY,
-                        WINDOW.y * HALF_MULTIPLY);
+void end_init(state_t *curr_state) {
+  replace_scene(curr_state);
+  curr_state->level_passed = true;
+  curr_state->active_level = WIN;
+  load_level(curr_state, "win");
 }
 
-void populate_bones_list(scene_t *scene, size_t num_bones, rgb_color_t color) {
-  list_t *positions = list_init(NUM_DIFF_BONES, NULL);
-  list_add(positions,
-           calculate_bone_positions_1(scene, NUM_BONES * QUARTER_MULTIPLY));
-  list_add(positions,
-           calculate_bone_positions_2(scene, NUM_BONES * QUARTER_MULTIPLY));
-  list_add(positions,
-           calculate_bone_positions_rand(scene, NUM_BONES * HALF_MULTIPLY));
+void fail_init(state_t *curr_state) {
+  replace_scene(curr_state);
+  curr_state->level_passed = false;
+  curr_state->active_level = FAIL;
+  load_level(curr_state, "lose");
+}
 
-  positions = list_merge(positions);
+// the corners of a body in the scene, posed from the cached shape of its kind
+vector_t *posed_vertices(shape_cache_t *shape, body_t *body) {
+  return shape_cache_pose(shape, body_get_centroid(body),
+                          body_get_rotation(body));
+}
 
-  body_t *hopper = scene_get_body(scene, HOPPER_IDX);
-  for (size_t i = 0; i < list_size(positions); i++) {
-    list_t *bone_shape = make_bone_shape();
-    body_t *bone =
-        body_init_with_info(bone_shape, BONE_MASS, color, "Bone", NULL);
+void end_cooldown(void *aux) {
+  state_t *state = aux;
+  state->cooldown_active = false;
+}
 
-    // the first half of the bones are golden bones
-    if (i > list_size(positions) * HALF_MULTIPLY) {
-      body_set_score(bone, GOLDEN_BONE_SCORE);
+// holds a new hopper at the start for COOLDOWN_TIME, restarting the wait if
+// one is already running
+void start_cooldown(state_t *state) {
+  state->cooldown_active = true;
+  rules_cancel(state->forces.rules, end_cooldown);
+  rules_after(state->forces.rules, round(COOLDOWN_TIME / SIM_TICK),
+              end_cooldown);
+}
 
-      // the second half of the bones are normal bones
+// makes hopper travel in projectile motion
+void projectile_motion(state_t *state, double dt) {
+  body_t *body = state->hopper;
+  vector_t *vertices = posed_vertices(state->hopper_shape, body);
+  size_t num_vertices = shape_cache_size(state->hopper_shape);
+  vector_t distance = vec_multiply(dt, body_get_velocity(body));
+  vector_t curr_vel = body_get_velocity(body);
+  for (size_t i = 0; i < num_vertices; i++) {
+    vector_t *vector = &vertices[i];
+    double y = vector->y + distance.y;
+    if (y < 0) {
+      state->hoppers_left = state->hoppers_left - 1;
+      start_cooldown(state);
+      // if there are no more tries, then the player has failed
+      if (state->hoppers_left == 0) {
+        fail_init(state);
+        break;
+      } else {
+        body_set_velocity(body, VEC_ZERO);
+        body_set_centroid(body, (vector_t){HOPPER_SIZE.x * HALF_MULTIPLY,
+                                           HOPPER_SIZE.y * HALF_MULTIPLY});
+        state->projectile = false;
+        break;
+      }
     } else {
-      body_set_score(bone, BONE_SCORE);
+      body_set_velocity(body,
+                        (vector_t){curr_vel.x, (curr_vel.y - GRAVITY2 * dt)});
     }
-    body_set_centroid(bone, *(vector_t *)list_get(positions, i));
-    body_set_dimensions(bone, BONE_SIZE);
-    body_set_img_texture(bone, "for_images/bone.png");
-    scene_add_body(scene, bone);
-    create_one_destructive_collision(scene, hopper, bone);
-  }
-  free(positions);
-}
-
-void populate_pineapple_list(scene_t *scene, size_t num_pineapples,
-                             rgb_color_t color, size_t hopper_index) {
-  body_t *hopper = scene_get_body(scene, hopper_index);
-  for (size_t i = 0; i < num_pineapples; i++) {
-    vector_t pineapple_position = calculate_pineapple_position(scene);
-    list_t *pineapple_shape = make_pineapple_shape();
-    body_t *pineapple = body_init_with_info(pineapple_shape, PINEAPPLE_MASS,
-                                            color, "Pineapple", NULL);
-    body_set_centroid(pineapple, pineapple_position);
-    body_set_score(pineapple, PINEAPPLE_SCORE);
-    body_set_dimensions(pineapple, PINEAPPLE_SIZE);
-    body_set_img_texture(pineapple, "for_images/Pineapple.png");
-    scene_add_body(scene, pineapple);
-    create_one_destructive_collision(scene, hopper, pineapple);
-  }
-}
-
-vector_t calculate_pineapple_position3(scene_t *scene) {
-  vector_t pos = (vector_t){(rand() % (int)WINDOW.x), (rand() % (int)WINDOW.y)};
-  while (((pos.x > WINDOW.x * HALF_MULTIPLY - NO_GOLDEN_BONE_RADIUS) &&
-          (pos.x < WINDOW.x * HALF_MULTIPLY + NO_GOLDEN_BONE_RADIUS)) ||
-         ((pos.y > WINDOW.y * HALF_MULTIPLY - NO_GOLDEN_BONE_RADIUS) &&
-          (pos.y < WINDOW.y * HALF_MULTIPLY + NO_GOLDEN_BONE_RADIUS))) {
-    pos = (vector_t){(rand() % (int)WINDOW.x), (rand() % (int)WINDOW.y)};
-  }
-  return pos;
-}
-
-void populate_ground(scene_t *curr_scene) {
-  list_t *ground_shape =
-      make_rectangle(WALL_WIDTH, WINDOW.x, WINDOW.x * HALF_MULTIPLY, 0);
-  body_t *ground =
-      body_init_with_info(ground_shape, INFINITY, BLACK, "Ground", NULL);
-  body_set_centroid(ground, (vector_t){WINDOW.x * HALF_MULTIPLY, 0});
-
-  scene_add_body(curr_scene, ground);
-}
-
-void populate_portal(scene_t *scene) {
-  list_t *portal = make_portal_shape();
-
-  body_t *to_add = body_init_with_info(portal, INFINITY, BLACK, "Portal", NULL);
-  body_set_centroid(to_add,
-                    (vector_t){WINDOW.x - PORTAL_DIMENSIONS.x * HALF_MULTIPLY,
-                               WINDOW.y * HALF_MULTIPLY});
-  body_set_velocity(to_add, PORTAL_VELOCITY);
-  body_set_score(to_add, PORTAL_SCORE);
-  body_set_dimensions(to_add, PORTAL_DIMENSIONS);
-  body_set_img_texture(to_add, "for_images/portal.png");
-  scene_add_body(scene, to_add);
-  body_t *hopper = scene_get_body(scene, HOPPER_IDX);
-  create_one_destructive_collision(scene, hopper, to_add);
-}
-
-void portal_motion(state_t *state, size_t portal_idx, double dt) {
-  scene_t *scene = state->scene;
-  body_t *portal = scene_get_body(scene, portal_idx);
-  list_t *vertices = body_get_shape(portal);
+  }
+}
+
+// the jump from the middle of the left edge that collects the level 1
+// trajectory bones, one point per half second
+void sample_best_path(vector_t *points, size_t num_points) {
+  trajectory_sample((vector_t){0, WINDOW.y * HALF_MULTIPLY}, HOPPER_VELOCITY,
+                    (vector_t){0, -GRAVITY2}, HALF_MULTIPLY, points,
+                    num_points);
+}
+
+void portal_motion(state_t *state, body_t *portal, double dt) {
+  vector_t *vertices = posed_vertices(state->portal_shape, portal);
+  size_t num_vertices = shape_cache_size(state->portal_shape);
   vector_t curr_vel = body_get_velocity(portal);
-  for (size_t i = 0; i < list_size(vertices); i++) {
+  for (size_t i = 0; i < num_vertices; i++) {
     vector_t distance = vec_multiply(dt, curr_vel);
-    vector_t *vertex = list_get(vertices, i);
+    vector_t *vertex = &vertices[i];
     double y = vertex->y + distance.y;
     size_t changed = 0;
     curr_vel = body_get_velocity(portal);
@@ -497,14 +973,22 @@ void portal_motion(state_t *state, size_t portal_idx, double dt) {
   }
 }
 
+// leaves the game from the level 1 quit key
+void game_exit(void) {
+#ifdef __EMSCRIPTEN__
+  emscripten_force_exit(0);
+#else
+  exit(0);
+#endif
+}
+
 void on_key1(char key, key_event_type_t type, double held_time,
              state_t *state) {
-  scene_t *scene = state->scene;
-  body_t *player = scene_get_body(scene, HOPPER_IDX);
+  body_t *player = state->hopper;
   if (type == KEY_PRESSED) {
     switch (key) {
     case T:
-      emscripten_force_exit(0);
+      game_exit();
     case DOWN_ARROW:
       body_set_velocity(player, (vector_t){0, -HOPPER_VELOCITY.y});
       break;
@@ -522,168 +1006,14 @@ void on_key1(char key, key_event_type_t type, double held_time,
   }
 }
 
-// POPULATING SCENE INIT
-void populate_scene1_init(scene_t *curr_scene) {
-  // background at index 0
-  populate_background(curr_scene, "for_images/Level_1_Background_FINAL.png");
-
-  // player at index 1
-  populate_hopper(curr_scene, LEVEL_1);
-
-  // ground at index 2
-  populate_ground(curr_scene);
-
-  // portal at index 3
-  populate_portal(curr_scene);
-
-  // pineapple at index 4
-  populate_pineapple_list(curr_scene, NUM_PINEAPPLES, LEVEL_1, HOPPER_IDX);
-
-  // bones at index 5 onwards
-  populate_bones_list(curr_scene, NUM_BONES, LEVEL_1);
-}
-
-// calculating the positions of the shelves for level 2
-list_t *calculate_shelf_positions(scene_t *scene, size_t num_shelves) {
-  time_t t;
-  srand((unsigned)time(&t));
-
-  list_t *pos = list_init(num_shelves, NULL);
-  // list of the y positions
-  double y_pos_top = (rand() % (int)(WINDOW.y * THIRD_MULTIPLY)) +
-                     (int)(WINDOW.y * TWO_THIRD_MULTIPLY);
-  double y_pos_mid = (rand() % (int)(WINDOW.y * THIRD_MULTIPLY)) +
-                     (int)WINDOW.y * THIRD_MULTIPLY;
-  double y_pos_bottom = (rand() % (int)(WINDOW.y * THIRD_MULTIPLY));
-  for (size_t i = 0; i < num_shelves; i++) {
-    double x_pos = (rand() % ((int)WINDOW.x / NUM_SUB_WINDOWS)) +
-                   ((i % REMAINDER_4) * (int)WINDOW.x / NUM_SUB_WINDOWS);
-    vector_t *posit = malloc(sizeof(vector_t));
-    // populate a third of the shelves in the bottom y third
-    if (i < num_shelves * THIRD_MULTIPLY) {
-      *posit = (vector_t){x_pos, y_pos_bottom};
-      list_add(pos, posit);
-    }
-    // populate a thid the shelves in the top y third
-    else if ((i >= num_shelves * THIRD_MULTIPLY) &&
-             (i < num_shelves * TWO_THIRD_MULTIPLY)) {
-      *posit = (vector_t){x_pos, y_pos_mid};
-      list_add(pos, posit);
-      // a third of the shelves are populated in random locations
-    } else {
-      *posit = (vector_t){x_pos, y_pos_top};
-      list_add(pos, posit);
-    }
-  }
-  return pos;
-}
-
-void populate_shelves(state_t *state, size_t num_shelves) {
-  scene_t *scene = state->scene;
-  body_t *hopper = scene_get_body(scene, HOPPER_IDX);
-  double hopper_cr = body_get_elasticity(hopper);
-  list_t *shelf_positions = calculate_shelf_positions(scene, num_shelves);
-  for (size_t i = 0; i < num_shelves; i++) {
-    list_t *shelf_shape = make_rectangle(SHELF_SIZE.y, SHELF_SIZE.x, 0, 0);
-    body_t *shelf =
-        body_init_with_info(shelf_shape, SHELF_MASS, BLACK, "Shelf", NULL);
-    body_set_score(shelf, 0);
-    body_set_centroid(shelf, *(vector_t *)list_get(shelf_positions, i));
-    body_set_dimensions(shelf, SHELF_SIZE);
-    scene_add_body(scene, shelf);
-
-    // 4 shelves are breakable
-    if (i % REMAINDER_3 == 0) {
-      create_physics_collision(scene, hopper_cr, hopper, shelf);
-      create_one_destructive_collision(scene, hopper, shelf);
-    }
-    // 4 shelves are rotatable (there are 6 but 2 of them also have one-sided
-    // destructive collisions)
-    else if (i % REMAINDER_2 == 0) {
-      create_physics_collision(scene, hopper_cr, hopper, shelf);
-      create_rotating_collision(scene, hopper, shelf);
-    }
-    // the other shelves have normal physics collisions
-    else {
-      create_physics_collision(scene, hopper_cr, hopper, shelf);
-    }
-  }
-}
-
-list_t *calculate_bone_positions_shelf(scene_t *scene,
-                                       list_t *shelf_positions) {
-  list_t *bone_pos = list_init(1, NULL);
-  for (size_t i = 0; i < list_size(shelf_positions); i += 1) {
-    vector_t *shelf_pos = list_get(shelf_positions, i);
-    vector_t shelf_top =
-        vec_add(*shelf_pos, (vector_t){0, SHELF_SIZE.y * HALF_MULTIPLY});
-    vector_t *bone_position = malloc(sizeof(vector_t));
-    *bone_position =
-        vec_add(shelf_top, (vector_t){0, BONE_SIZE.y * HALF_MULTIPLY});
-    list_add(bone_pos, bone_position);
-  }
-  return bone_pos;
-}
-
-void populate_bones2_list(scene_t *scene, size_t num_bones, rgb_color_t color) {
-  list_t *positions = list_init(DOUBLE, NULL);
-  list_add(positions,
-           calculate_bone_positions_rand(scene, num_bones * HALF_MULTIPLY));
-
-  // 12 (NUM_SHELVES) bones on the shelves
-  list_add(positions,
-           calculate_bone_positions_shelf(
-               scene, calculate_shelf_positions(scene, NUM_SHELVES)));
-
-  positions = list_merge(positions);
-
-  body_t *hopper = scene_get_body(scene, HOPPER_IDX);
-  for (size_t i = 0; i < list_size(positions); i++) {
-    list_t *bone_shape = make_bone_shape();
-    body_t *bone =
-        body_init_with_info(bone_shape, BONE_MASS, color, "Bone", NULL);
-
-    // all of the positions except 4 will be normal bones
-    // one bone is a golden bone
-    if (i % NUM_BONES == 0) {
-      body_set_score(bone, GOLDEN_BONE_SCORE);
-      body_set_img_texture(bone, "for_images/golden_bone.png");
-      body_set_info(bone, "Golden Bone");
-
-      // 3 bones are decoy bones
-    } else if (i % (int)(NUM_BONES * QUARTER_MULTIPLY) == 0) {
-      body_set_score(bone, DECOY_BONE_SCORE);
-      body_set_img_texture(bone, "for_images/decoy_bone.png");
-      body_set_info(bone, "Decoy Bone");
-    }
-    // the other bones will be normal
-    else {
-      body_set_img_texture(bone, "for_images/bone.png");
-      body_set_score(bone, BONE_SCORE);
-      body_set_info(bone, "Bone");
-    }
-
-    // golden bone should be accessible to the player
-    body_set_centroid(bone, *(vector_t *)list_get(positions, i));
-    if (!strcmp(body_get_info(bone), "Golden Bone")) {
-      body_set_centroid(bone,
-                        (vector_t){rand() % (int)(WINDOW.x),
-                                   rand() % (int)(WINDOW.y * HALF_MULTIPLY)});
-    }
-    body_set_dimensions(bone, BONE_SIZE);
-    scene_add_body(scene, bone);
-    create_one_destructive_collision(scene, hopper, bone);
-  }
-  free(positions);
-}
-
 void hopper_bounce(state_t *state, double dt) {
-  body_t *hopper = scene_get_body(state->scene, HOPPER_IDX);
-  list_t *vertices = body_get_shape(hopper);
+  body_t *hopper = state->hopper;
+  vector_t *vertices = posed_vertices(state->hopper_shape, hopper);
+  size_t num_vertices = shape_cache_size(state->hopper_shape);
   vector_t curr_vel = body_get_velocity(hopper);
-  for (size_t i = 0; i < list_size(vertices); i++) {
+  for (size_t i = 0; i < num_vertices; i++) {
     vector_t distance = vec_multiply(dt, curr_vel);
-    vector_t *vertex = list_get(vertices, i);
+    vector_t *vertex = &vertices[i];
     double y = vertex->y + distance.y;
     size_t changed = 0;
     vector_t curr_vel = body_get_velocity(hopper);
@@ -710,14 +1040,13 @@ void hopper_bounce(state_t *state, double dt) {
 
 void on_key2(char key, key_event_type_t type, double held_time,
              state_t *state) {
-  scene_t *scene = state->scene;
-  body_t *player = scene_get_body(scene, HOPPER_IDX);
+  body_t *player = state->hopper;
   double curr_elasticity = body_get_elasticity(player);
   vector_t curr_position = body_get_centroid(player);
   double set_elasticity = curr_elasticity;
 
   if (type == KEY_PRESSED) {
-    if (!check_status(scene).pineapple_status) {
+    if (!state->pineapple_state) {
       switch (key) {
       case DOWN_ARROW:
         set_elasticity = curr_elasticity - (ELASTICITY_STEP * held_time);
@@ -748,131 +1077,129 @@ void on_key2(char key, key_event_type_t type, double held_time,
   }
 }
 
-void populate_scene2_init(state_t *curr_state) {
-  scene_t *curr_scene = curr_state->scene;
-  // background at index 0
-  populate_background(curr_scene, "for_images/Level_2_Background_FINAL.png");
-
-  // player at index 1
-  populate_hopper(curr_scene, LEVEL_2);
-  // body_set_color(scene_get_body(curr_scene, HOPPER_IDX), BONE_COLOR_2);
-  body_t *hopper = scene_get_body(curr_scene, HOPPER_IDX);
-  body_set_centroid(hopper, (vector_t){HOPPER_SIZE.x * HALF_MULTIPLY,
-                                       WINDOW.y * HALF_MULTIPLY});
-  body_set_velocity(hopper, HOPPER_VELOCITY_2);
-  body_set_mass(hopper, HOPPER_MASS_2);
-
-  // ground at index 2
-  populate_ground(curr_scene);
-  body_t *ground = scene_get_body(curr_scene, GROUND_IDX);
-  create_physics_collision(curr_scene, GROUND_CR, hopper, ground);
-
-  // pineapple at index 3
-  populate_pineapple_list(curr_scene, NUM_PINEAPPLES, LEVEL_2, HOPPER_IDX);
-
-  // shelves from index 4 onwards
-  populate_shelves(curr_state, NUM_SHELVES);
-
-  // bones after shelves
-  populate_bones2_list(curr_scene, NUM_BONES, LEVEL_2);
-}
-
-void populate_lily_pad(scene_t *curr_scene) {
-  list_t *shape = make_pacman(LILY_PAD_LENGTH, WINDOW.x * HALF_MULTIPLY,
-                              WINDOW.y * HALF_MULTIPLY);
-  body_t *lily_pad =
-      body_init_with_info(shape, PAD_MASS, LEVEL_3_POND, "Lily Pad", NULL);
-  body_set_img_texture(lily_pad, "for_images/lily_pad.png");
-  body_set_dimensions(lily_pad, (vector_t){LILY_PAD_LENGTH * LILY_PIC_DIM,
-                                           LILY_PAD_LENGTH * LILY_PIC_DIM});
-  scene_add_body(curr_scene, lily_pad);
-}
-
-// spawns the turtles in random locations
-// applies newtonian gravity to the turtles with Hopper
-// creates destructive collision with hopper
-
-void populate_turtles(scene_t *scene, rgb_color_t color) {
-  srand(time(NULL));
-
-  body_t *hopper = scene_get_body(scene, HOPPER_IDX_3);
-  list_t *turtle_shape =
-      make_rectangle(TURTLE_SIZE.y, TURTLE_SIZE.y, WINDOW.x * HALF_MULTIPLY,
-                     WINDOW.y * HALF_MULTIPLY);
-  body_t *turtle =
-      body_init_with_info(turtle_shape, TURTLE_MASS, color, "Turtle", NULL);
-  body_set_dimensions(turtle, TURTLE_SIZE);
-
-  // make sure the turtles are far enough from hopper initially
-  vector_t pos = (vector_t){(rand() % (int)WINDOW.x), (rand() % (int)WINDOW.y)};
-  while (((pos.x > WINDOW.x * HALF_MULTIPLY - NO_TURTLE_RADIUS) &&
-          (pos.x < WINDOW.x * HALF_MULTIPLY + NO_TURTLE_RADIUS)) ||
-         ((pos.y > WINDOW.y * HALF_MULTIPLY - NO_TURTLE_RADIUS) &&
-          (pos.y < WINDOW.y * HALF_MULTIPLY + NO_TURTLE_RADIUS))) {
-    pos = (vector_t){(rand() % (int)WINDOW.x), (rand() % (int)WINDOW.y)};
-  }
-  body_set_centroid(turtle, pos);
-  if (pos.x <= WINDOW.x * HALF_MULTIPLY) {
-    body_set_img_texture(turtle, "for_images/Turtle_Left.png");
-  } else {
-    body_set_img_texture(turtle, "for_images/Turtle_Right.png");
-  }
-  body_set_score(turtle, TURTLE_SCORE);
-  scene_add_body(scene, turtle);
-  create_newtonian_gravity(scene, TURTLE_GRAVITY,
-                           scene_get_body(scene, LILY_PAD_IDX), turtle);
-  create_destructive_collision(scene, turtle, hopper);
+// pulls every body of one kind towards a single source body
+// the members are packed into flat arrays each tick so that the force is one
+// loop over positions rather than one force creator per body
+typedef struct attractor {
+  scene_t *scene;
+  force_index_t *index;
+  body_t *source;
+  char *kind;
+  double G;
+  double softening;
+  size_t capacity;
+  body_t **members;
+  double *x;
+  double *y;
+  double *mass;
+  double *force_x;
+  double *force_y;
+} attractor_t;
+
+// the arrays are force memory, sized to the capacity together; NULL arrays
+// are allocated
+void *attractor_array(void *array, size_t capacity, size_t size) {
+  return alloc_track_realloc(ALLOC_FORCE, array, capacity * size);
 }
 
-void populate_brick_projectile(scene_t *curr_scene) {
-  list_t *projectile_shape =
-      make_star(PROJECTILE_LENGTH, PROJECTILE_POINTS_MASS,
-                WINDOW.x * HALF_MULTIPLY, WINDOW.y * HALF_MULTIPLY);
-  body_t *hopper = scene_get_body(curr_scene, HOPPER_IDX_3);
+void attractor_resize(attractor_t *attractor) {
+  size_t capacity = attractor->capacity;
+  attractor->members =
+      attractor_array(attractor->members, capacity, sizeof(body_t *));
+  attractor->x = attractor_array(attractor->x, capacity, sizeof(double));
+  attractor->y = attractor_array(attractor->y, capacity, sizeof(double));
+  attractor->mass = attractor_array(attractor->mass, capacity, sizeof(double));
+  attractor->force_x =
+      attractor_array(attractor->force_x, capacity, sizeof(double));
+  attractor->force_y =
+      attractor_array(attractor->force_y, capacity, sizeof(double));
+}
 
-  body_t *projectile =
-      body_init_with_info(projectile_shape, PROJECTILE_POINTS_MASS, BLACK,
-                          "Brick Projectile", NULL);
-  body_set_velocity(projectile, PROJECTILE_VELOCITY);
-  body_set_centroid(projectile, body_get_centroid(hopper));
-  scene_add_body(curr_scene, projectile);
-
-  for (size_t i = 0; i < scene_bodies(curr_scene); i++) {
-    body_t *turtle = scene_get_body(curr_scene, i);
-    if (!strcmp(body_get_info(turtle), "Turtle")) {
-      create_destructive_collision(curr_scene, projectile, turtle);
-    }
-    create_destructive_collision(curr_scene, projectile,
-                                 scene_get_body(curr_scene, GOLDEN_BONE_IDX));
-    create_destructive_collision(
-        curr_scene, projectile, scene_get_body(curr_scene, PINEAPPLE_BOMB_IDX));
+void attractor_reserve(attractor_t *attractor, size_t capacity) {
+  if (capacity <= attractor->capacity) {
+    return;
   }
+  while (attractor->capacity < capacity) {
+    attractor->capacity *= DOUBLE;
+  }
+  attractor_resize(attractor);
 }
 
-void populate_golden_bone(scene_t *curr_scene, rgb_color_t color) {
-  time_t t;
-  srand((unsigned)time(&t));
+void attractor_free(void *aux) {
+  attractor_t *attractor = aux;
+  force_index_drop(attractor->index);
+  alloc_track_free(attractor->members);
+  alloc_track_free(attractor->x);
+  alloc_track_free(attractor->y);
+  alloc_track_free(attractor->mass);
+  alloc_track_free(attractor->force_x);
+  alloc_track_free(attractor->force_y);
+  alloc_track_free(attractor);
+}
 
-  list_t *bone_shape =
-      make_rectangle(BONE_SIZE.y, BONE_SIZE.y, WINDOW.x * HALF_MULTIPLY,
-                     WINDOW.y * HALF_MULTIPLY);
-  body_t *bone =
-      body_init_with_info(bone_shape, BONE_MASS, color, "Golden Bone", NULL);
-  body_set_img_texture(bone, "for_images/golden_bone.png");
-  body_set_dimensions(bone, BONE_SIZE);
+// softened newtonian gravity, F = G m1 m2 r / (|r|^2 + e^2)^(3/2)
+void apply_attractor(void *aux) {
+  attractor_t *attractor = aux;
+  scene_t *scene = attractor->scene;
+
+  // gather the live members of the group into the packed arrays
+  size_t count = 0;
+  for (size_t i = 0; i < scene_bodies(scene); i++) {
+    body_t *body = scene_get_body(scene, i);
+    if (body_is_removed(body) || strcmp(body_get_info(body), attractor->kind)) {
+      continue;
+    }
+    attractor_reserve(attractor, count + 1);
+    vector_t centroid = body_get_centroid(body);
+    attractor->members[count] = body;
+    attractor->x[count] = centroid.x;
+    attractor->y[count] = centroid.y;
+    attractor->mass[count] = body_get_mass(body);
+    count++;
+  }
 
-  vector_t pos = (vector_t){(rand() % (int)WINDOW.x), (rand() % (int)WINDOW.y)};
-  while (((pos.x > WINDOW.x * HALF_MULTIPLY - NO_GOLDEN_BONE_RADIUS) &&
-          (pos.x < WINDOW.x * HALF_MULTIPLY + NO_GOLDEN_BONE_RADIUS)) ||
-         ((pos.y > WINDOW.y * HALF_MULTIPLY - NO_GOLDEN_BONE_RADIUS) &&
-          (pos.y < WINDOW.y * HALF_MULTIPLY + NO_GOLDEN_BONE_RADIUS))) {
-    pos = (vector_t){(rand() % (int)WINDOW.x), (rand() % (int)WINDOW.y)};
+  vector_t source = body_get_centroid(attractor->source);
+  double source_gm = attractor->G * body_get_mass(attractor->source);
+  double softening_sq = attractor->softening * attractor->softening;
+  double *restrict x = attractor->x;
+  double *restrict y = attractor->y;
+  double *restrict mass = attractor->mass;
+  double *restrict force_x = attractor->force_x;
+  double *restrict force_y = attractor->force_y;
+  for (size_t i = 0; i < count; i++) {
+    double dx = source.x - x[i];
+    double dy = source.y - y[i];
+    double dist_sq = dx * dx + dy * dy + softening_sq;
+    double magnitude = source_gm * mass[i] / (dist_sq * sqrt(dist_sq));
+    force_x[i] = magnitude * dx;
+    force_y[i] = magnitude * dy;
   }
 
-  body_set_centroid(bone, pos);
-  body_set_score(bone, GOLDEN_BONE_SCORE);
+  for (size_t i = 0; i < count; i++) {
+    body_add_force(attractor->members[i], (vector_t){force_x[i], force_y[i]});
+  }
+}
 
-  scene_add_body(curr_scene, bone);
+// registers one force creator that attracts every body whose info is kind
+// towards source; the force is dropped with the source body
+void create_attractor(scene_t *scene, force_index_t *index, double G,
+                      double softening, body_t *source, char *kind) {
+  attractor_t *attractor =
+      alloc_track_malloc(ALLOC_FORCE, sizeof(attractor_t));
+  *attractor = (attractor_t){.scene = scene,
+                             .index = index,
+                             .source = source,
+                             .kind = kind,
+                             .G = G,
+                             .softening = softening,
+                             .capacity = INIT_ATTRACTOR_CAPACITY};
+  attractor_resize(attractor);
+
+  list_t *bodies = list_init(1, NULL);
+  list_add(bodies, source);
+  force_index_add(index);
+  scene_add_bodies_force_creator(scene, apply_attractor, attractor, bodies,
+                                 attractor_free);
 }
 
 void pineapple_bomb(state_t *curr_state) {
@@ -887,78 +1214,202 @@ void pineapple_bomb(state_t *curr_state) {
   }
 }
 
+// projectiles leave the lily pad in the direction it faces
+vector_t projectile_velocity(body_t *lily_pad) {
+  double angle = body_get_rotation(lily_pad);
+  return (vector_t){PROJECTILE_VELOCITY.x * cos(angle),
+                    PROJECTILE_VELOCITY.y * sin(angle)};
+}
+
+// fires a brick from the hopper in the direction the lily pad faces
+void fire_projectile(state_t *state) {
+  body_t *projectile =
+      spawn_body(state, find_kind(state, "Brick Projectile"),
+                 body_get_centroid(state->hopper));
+  body_set_velocity(projectile, projectile_velocity(state->lily_pad));
+}
+
 void on_key3(char key, key_event_type_t type, double held_time,
              state_t *state) {
-  scene_t *scene = state->scene;
-  body_t *lily_pad = scene_get_body(scene, LILY_PAD_IDX);
+  body_t *lily_pad = state->lily_pad;
   double curr_angle = body_get_rotation(lily_pad);
   if (type == KEY_PRESSED) {
     switch (key) {
     case LEFT_ARROW:
       body_set_rotation(lily_pad, (curr_angle + held_time * ANGLE_STEP));
-      body_set_img_texture(lily_pad, "for_images/lily_pad.png");
       break;
     case RIGHT_ARROW:
       body_set_rotation(lily_pad, (curr_angle - held_time * ANGLE_STEP));
-      body_set_img_texture(lily_pad, "for_images/lily_pad.png");
       break;
     case SPACE:
-      populate_brick_projectile(scene);
-      body_t *projectile = scene_get_body(scene, scene_bodies(scene) - 1);
-      vector_t velocity = {
-          PROJECTILE_VELOCITY.x * cos(body_get_rotation(lily_pad)),
-          PROJECTILE_VELOCITY.y * sin(body_get_rotation(lily_pad))};
-      body_set_velocity(projectile, velocity);
+      fire_projectile(state);
     }
   }
 }
 
-void populate_scene3_init(state_t *state) {
-  scene_t *curr_scene = state->scene;
+// the rules screens that passing a level leads to
+void level2_rules(state_t *curr_state);
+void level3_rules(state_t *curr_state);
 
-  // background at index 0
-  populate_background(curr_scene, "for_images/Level_3_Background_FINAL.png");
+void collect_score(rule_event_t *event, void *aux) {
+  state_t *state = aux;
+  state->score += event->score;
+}
 
-  // lily pad at index 1
-  populate_lily_pad(curr_scene);
+void pineapple_eaten(rule_event_t *event, void *aux) {
+  state_t *state = aux;
+  state->pineapple_state = 0;
+}
 
-  // hopper at index 2
-  populate_hopper(curr_scene, LEVEL_3_LILY_PAD);
+void reveal_best_path(rule_event_t *event, void *aux) {
+  state_t *state = aux;
+  state->show_best_path = true;
+}
 
-  body_t *hopper = scene_get_body(curr_scene, HOPPER_IDX_3);
-  body_set_centroid(
-      hopper, (vector_t){WINDOW.x * HALF_MULTIPLY, WINDOW.y * HALF_MULTIPLY});
-  body_set_velocity(hopper, VEC_ZERO);
+void pass_level1(rule_event_t *event, void *aux) {
+  state_t *state = aux;
+  state->level_passed = 1;
+  level2_rules(state);
+}
 
-  // golden bone at index 3
-  populate_golden_bone(curr_scene, LEVEL_3_GRASS);
+void wrap_around1(body_t *hopper) {
+  double curr_centre_x = body_get_centroid(hopper).x;
+  double curr_centre_y = body_get_centroid(hopper).y;
+  if (curr_centre_y > (WINDOW.y - HOPPER_SIZE.y * HALF_MULTIPLY)) {
+    body_set_centroid(hopper,
+                      (vector_t){curr_centre_x, HOPPER_SIZE.y * HALF_MULTIPLY});
+  } else if (curr_centre_y < (HOPPER_SIZE.y * HALF_MULTIPLY)) {
+    body_set_centroid(hopper,
+                      (vector_t){curr_centre_x,
+                                 (WINDOW.y - (HOPPER_SIZE.y * HALF_MULTIPLY))});
+  }
+}
+
+void tick_level1(state_t *state, double dt) {
+  wrap_around1(state->hopper);
+  if (state->cooldown_active) {
+    body_set_centroid(state->hopper,
+                      (vector_t){HOPPER_SIZE.x / 2, HOPPER_SIZE.y / 2});
+    state->projectile = false;
+  }
+  profiler_begin(state->profiler, PHASE_MOTION);
+  portal_motion(state, state->portal, dt);
+  profiler_end(state->profiler);
+}
+
+// level 1: everything the hopper collects scores, eating the pineapple
+// shows the best path and reaching the portal passes the level
+void arm_level1(state_t *state) {
+  rules_t *rules = state->forces.rules;
+  rules_on(rules, RULE_CONTACT, "Hopper", NULL, collect_score);
+  rules_on(rules, RULE_DESTROYED, "Pineapple", NULL, reveal_best_path);
+  rules_on(rules, RULE_DESTROYED, "Pineapple", NULL, pineapple_eaten);
+  rules_on(rules, RULE_DESTROYED, "Portal", NULL, pass_level1);
+  state->on_tick = tick_level1;
+}
+
+// the portal out of level 2 appears where the level file spawns it
+void spawn_level2_portal(rule_event_t *event, void *aux) {
+  state_t *state = aux;
+  state->portal = spawn_level_bodies(state, find_spawn(state, "Portal"));
+}
 
-  // pineapple at index 4
-  populate_pineapple_list(curr_scene, NUM_PINEAPPLES, LEVEL_3_GRASS,
-                          HOPPER_IDX_3);
-  body_t *pineapple = scene_get_body(curr_scene, PINEAPPLE_BOMB_IDX);
-  body_set_centroid(pineapple, calculate_pineapple_position3(curr_scene));
+void pass_level2(rule_event_t *event, void *aux) {
+  state_t *state = aux;
+  state->level_passed = 1;
+  level3_rules(state);
+}
 
-  // the next INIT_NUM_TURTLES(5) are turtles, from 5-8
-  for (size_t i = 0; i < INIT_NUM_TURTLES; i++) {
-    populate_turtles(curr_scene, LEVEL_3_GRASS);
+void tick_level2(state_t *state, double dt) {
+  profiler_begin(state->profiler, PHASE_MOTION);
+  hopper_bounce(state, dt);
+  profiler_end(state->profiler);
+  // the hopper leaving the top fails the level
+  if (state->on_tick == NULL) {
+    return;
+  }
+  if (state->portal != NULL) {
+    profiler_begin(state->profiler, PHASE_MOTION);
+    portal_motion(state, state->portal, dt);
+    profiler_end(state->profiler);
   }
+  LOG_VALUE(state->logger, LOG_CHANNEL_PHYSICS, LOG_DEBUG,
+            "Coefficient of restitution: %.2f",
+            body_get_elasticity(state->hopper));
+}
+
+// level 2: eating the pineapple unlocks the elasticity keys and eating the
+// golden bone opens the portal
+void arm_level2(state_t *state) {
+  rules_t *rules = state->forces.rules;
+  rules_on(rules, RULE_CONTACT, "Hopper", NULL, collect_score);
+  rules_on(rules, RULE_DESTROYED, "Pineapple", NULL, pineapple_eaten);
+  rules_on(rules, RULE_DESTROYED, "Golden Bone", NULL, spawn_level2_portal);
+  rules_on(rules, RULE_DESTROYED, "Portal", NULL, pass_level2);
+  state->on_tick = tick_level2;
+}
+
+void pass_wide(rule_event_t *event, void *aux) {
+  state_t *state = aux;
+  state->score += event->score;
+  end_init(state);
+}
+
+// the wide level plays like level 2, but its portal ends the game
+void arm_wide(state_t *state) {
+  rules_t *rules = state->forces.rules;
+  rules_on(rules, RULE_CONTACT, "Hopper", NULL, collect_score);
+  rules_on(rules, RULE_DESTROYED, "Pineapple", NULL, pineapple_eaten);
+  rules_on(rules, RULE_DESTROYED, "Golden Bone", NULL, spawn_level2_portal);
+  rules_on(rules, RULE_DESTROYED, "Portal", NULL, pass_wide);
+  state->on_tick = tick_level2;
+}
+
+void detonate_pineapple(rule_event_t *event, void *aux) {
+  state_t *state = aux;
+  state->score += event->score;
+  pineapple_bomb(state);
+}
+
+void win_level3(rule_event_t *event, void *aux) {
+  state_t *state = aux;
+  state->score += event->score;
+  end_init(state);
+}
+
+void lose_level3(rule_event_t *event, void *aux) { fail_init(aux); }
+
+void tick_level3(state_t *state, double dt) {
+  body_set_velocity(state->lily_pad, VEC_ZERO);
+}
+
+// level 3: turtles hit by a projectile score, the pineapple clears every
+// turtle, hitting the golden bone wins and losing the hopper fails
+void arm_level3(state_t *state) {
+  rules_t *rules = state->forces.rules;
+  rules_on(rules, RULE_CONTACT, "Brick Projectile", "Turtle", collect_score);
+  rules_on(rules, RULE_DESTROYED, "Pineapple", NULL, detonate_pineapple);
+  rules_on(rules, RULE_DESTROYED, "Pineapple", NULL, pineapple_eaten);
+  rules_on(rules, RULE_DESTROYED, "Golden Bone", NULL, win_level3);
+  rules_on(rules, RULE_DESTROYED, "Hopper", NULL, lose_level3);
+  state->on_tick = tick_level3;
 }
 
 void level1_init(state_t *curr_state) {
-  scene_free(curr_state->scene);
-  scene_t *level1_scene = scene_init();
-  curr_state->scene = level1_scene;
-  populate_scene1_init(level1_scene);
+  replace_scene(curr_state);
+  // the level's timed spawns count from here
+  curr_state->level1_start = rules_now(curr_state->forces.rules);
+  load_level(curr_state, "level1");
   curr_state->level_passed = false;
   curr_state->hoppers_left = INIT_NUM_HOPPERS;
   curr_state->score = 0.0;
   curr_state->projectile = false;
   curr_state->active_level = LEVEL1;
-  curr_state->time_passed = 0;
-  curr_state->time_since_death = 0;
   curr_state->cooldown_active = false;
-  sdl_on_key((void *)on_key1);
+  curr_state->show_best_path = false;
+  curr_state->pineapple_state = 1;
+  curr_state->on_key = on_key1;
+  arm_level1(curr_state);
 }
 
 void on_key_transition_1(char key, key_event_type_t type, double held_time,
@@ -972,13 +1423,10 @@ void on_key_transition_1(char key, key_event_type_t type, double held_time,
 }
 
 void level1_rules(state_t *curr_state) {
-  scene_free(curr_state->scene);
-  scene_t *level1 = scene_init();
-  curr_state->scene = level1;
-  populate_background(level1, "for_images/Level_1_Instructions_FINAL.png");
-  populate_hopper(level1, LEVEL_1_INSTRUCTIONS);
+  replace_scene(curr_state);
+  load_level(curr_state, "level1_rules");
   curr_state->active_level = LEVEL1_RULES;
-  sdl_on_key((void *)on_key_transition_1);
+  curr_state->on_key = on_key_transition_1;
 }
 
 void on_key_transition_0(char key, key_event_type_t type, double held_time,
@@ -992,26 +1440,23 @@ void on_key_transition_0(char key, key_event_type_t type, double held_time,
 }
 
 void opening_init(state_t *curr_state) {
-  scene_t *opening_scene = scene_init();
-  curr_state->scene = opening_scene;
-
-  populate_background(opening_scene, "for_images/Opening_FINAL.png");
-  populate_hopper(opening_scene, OPENING);
+  curr_state->scene = new_scene();
+  load_level(curr_state, "opening");
   curr_state->active_level = OPENING_LEVEL;
-  sdl_on_key((void *)on_key_transition_0);
+  curr_state->on_key = on_key_transition_0;
 }
 
 void level2_init(state_t *curr_state) {
-  scene_free(curr_state->scene);
-  scene_t *level2_scene = scene_init();
-  curr_state->scene = level2_scene;
+  replace_scene(curr_state);
   curr_state->level_passed = false;
   curr_state->hoppers_left = 1;
   curr_state->projectile = false;
   curr_state->active_level = LEVEL2;
-  populate_scene2_init(curr_state);
-  hopper_bounce(curr_state, time_since_last_tick());
-  sdl_on_key((void *)on_key2);
+  curr_state->pineapple_state = 1;
+  load_level(curr_state, "level2");
+  hopper_bounce(curr_state, curr_state->dt);
+  curr_state->on_key = on_key2;
+  arm_level2(curr_state);
 }
 
 void on_key_transition_2(char key, key_event_type_t type, double held_time,
@@ -1024,25 +1469,37 @@ void on_key_transition_2(char key, key_event_type_t type, double held_time,
   }
 }
 
+void wide_init(state_t *curr_state) {
+  replace_scene(curr_state);
+  curr_state->level_passed = false;
+  curr_state->hoppers_left = 1;
+  curr_state->projectile = false;
+  curr_state->active_level = WIDE_LEVEL;
+  curr_state->pineapple_state = 1;
+  load_level(curr_state, "wide");
+  hopper_bounce(curr_state, curr_state->dt);
+  curr_state->on_key = on_key2;
+  arm_wide(curr_state);
+}
+
 void level2_rules(state_t *curr_state) {
-  scene_free(curr_state->scene);
-  scene_t *level2 = scene_init();
-  curr_state->scene = level2;
-  populate_background(level2, "for_images/Level_2_Instructions_FINAL.png");
-  populate_hopper(level2, LEVEL_2_INSTRUCTIONS);
+  replace_scene(curr_state);
+  load_level(curr_state, "level2_rules");
   curr_state->active_level = LEVEL2_RULES;
-  sdl_on_key((void *)on_key_transition_2);
+  curr_state->on_key = on_key_transition_2;
 }
 
 void level3_init(state_t *curr_state) {
-  scene_free(curr_state->scene);
-  scene_t *level3_scene = scene_init();
-  curr_state->scene = level3_scene;
+  replace_scene(curr_state);
   curr_state->level_passed = false;
   curr_state->active_level = LEVEL3;
   curr_state->pineapple_state = 1;
-  populate_scene3_init(curr_state);
-  sdl_on_key((void *)on_key3);
+  load_level(curr_state, "level3");
+  // one attractor pulls every turtle, including later spawns, to the lily pad
+  create_attractor(curr_state->scene, &curr_state->forces, TURTLE_GRAVITY,
+                   TURTLE_SOFTENING, curr_state->lily_pad, "Turtle");
+  curr_state->on_key = on_key3;
+  arm_level3(curr_state);
 }
 
 void on_key_transition_3(char key, key_event_type_t type, double held_time,
@@ -1056,184 +1513,598 @@ void on_key_transition_3(char key, key_event_type_t type, double held_time,
 }
 
 void level3_rules(state_t *curr_state) {
-  scene_free(curr_state->scene);
-  scene_t *level3 = scene_init();
-  curr_state->scene = level3;
+  replace_scene(curr_state);
+  load_level(curr_state, "level3_rules");
   curr_state->active_level = LEVEL3_RULES;
-  populate_background(level3, "for_images/Level_3_Instructions_FINAL.png");
-  populate_hopper(level3, LEVEL_3_INSTRUCTIONS);
-  sdl_on_key((void *)on_key_transition_3);
+  curr_state->on_key = on_key_transition_3;
 }
 
-state_t *emscripten_init() {
-  sdl_init(VEC_ZERO, WINDOW);
+double now_seconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / NS_PER_SECOND;
+}
+
+// the event pump only queues keys, they are applied by the next tick
+void on_key(char key, key_event_type_t type, double held_time,
+            state_t *state) {
+  input_queue_push(state->input, key, type, held_time);
+}
+
+// every key goes through here so that debug keys work on every screen, the
+// level handler in state->on_key gets the rest
+void apply_key(state_t *state, input_event_t *event) {
+  if (event->key == PROFILER_KEY) {
+    if (event->type == KEY_PRESSED) {
+      profiler_toggle_overlay(state->profiler);
+    }
+  } else {
+    state->on_key(event->key, event->type, event->held_time, state);
+  }
+}
+
+// applies the keys queued since the last tick, in the order they arrived
+void apply_input(state_t *state) {
+  input_event_t *events;
+  size_t num_events = input_queue_drain(state->input, &events);
+  if (num_events == 0) {
+    return;
+  }
+  profiler_begin(state->profiler, PHASE_INPUT);
+  state->needs_render = true;
+  for (size_t i = 0; i < num_events; i++) {
+    apply_key(state, &events[i]);
+  }
+  profiler_end(state->profiler);
+  LOG_VALUE(state->logger, LOG_CHANNEL_GAME, LOG_DEBUG,
+            "Input latency: %.1f ms",
+            (now_seconds() - events[0].time) * MS_PER_SECOND);
+}
+
+void game_key(state_t *state, char key, key_event_type_t type,
+              double held_time) {
+  on_key(key, type, held_time, state);
+}
+
+// the texture, size, layer and depth of a body come from its kind; kinds
+// with a right-hand image, like the turtles, face the middle of the window
+sprite_t body_sprite(body_t *body, void *aux) {
+  state_t *state = aux;
+  level_kind_t *kind = body_kind(body);
+  char *path = kind->sprite[0] != '\0' ? kind->sprite : NULL;
+  double x = body_get_centroid(body).x - state->camera.x;
+  if (kind->sprite_right[0] != '\0' && x > WINDOW.x * HALF_MULTIPLY) {
+    path = kind->sprite_right;
+  }
+  return (sprite_t){path, kind->sprite_size, kind->layer, kind->depth};
+}
+
+// the shape of a kind, which the library only reads while the cache copies it
+shape_cache_t *kind_shape_cache(level_pack_t *pack, level_kind_t *kind) {
+  vector_t *vertices = level_pack_vertices(pack, kind);
+  list_t *shape = list_init(kind->num_vertices, NULL);
+  for (size_t i = 0; i < kind->num_vertices; i++) {
+    list_add(shape, &vertices[i]);
+  }
+  shape_cache_t *cache = shape_cache_init(shape);
+  list_free(shape);
+  return cache;
+}
+
+// without a pack the levels are compiled from their descriptions
+level_pack_t *open_levels(void) {
+  level_pack_t *levels = level_pack_open(LEVEL_PACK_PATH);
+  if (levels != NULL) {
+    return levels;
+  }
+  size_t size = 0;
+  uint8_t *data = level_compile(LEVEL_SOURCES, NUM_LEVEL_SOURCES, &size);
+  return data != NULL ? level_pack_from_memory(data, size) : NULL;
+}
+
+state_t *game_session_init(uint32_t seed) {
+  level_pack_t *levels = open_levels();
+  if (levels == NULL) {
+    fprintf(stderr, "cannot open the level pack %s or compile the levels\n",
+            LEVEL_PACK_PATH);
+    return NULL;
+  }
   state_t *new_state = malloc(sizeof(state_t));
+  new_state->forces = (force_index_t){0};
+  new_state->forces.rules = rules_init(SIM_TICK);
+  new_state->on_tick = NULL;
+  new_state->profiler = profiler_init();
+  new_state->logger = logger_init();
+  new_state->renderer = NULL;
+  new_state->needs_render = true;
+  new_state->idle = false;
+  new_state->idle_frames_skipped = 0;
+  // xorshift never leaves zero
+  new_state->seed = seed != 0 ? seed : 1;
+  new_state->dt = 0;
+  new_state->input = input_queue_init();
+  pthread_mutex_init(&new_state->lock, NULL);
+  atomic_init(&new_state->running, false);
+  new_state->snapshots = NULL;
+  new_state->ticks = 0;
+  new_state->render_ms = 0;
+  new_state->frames_drawn = 0;
+  new_state->draw_calls = 0;
+  new_state->max_draw_calls = 0;
+  new_state->aim_index = spatial_index_init(WINDOW, AIM_INDEX_CELL);
+  new_state->guide = malloc(AIM_GUIDE_POINTS * sizeof(vector_t));
+  new_state->guide_length = 0;
+  new_state->show_best_path = false;
+  new_state->aim_hit = false;
+  new_state->budget = NULL;
+  new_state->quality = QUALITY_FULL;
+  new_state->levels = levels;
+  point_list_init(&new_state->level_points);
+  point_list_extend(&new_state->level_points,
+                    level_pack_max_points(new_state->levels));
+  new_state->world = NULL;
+  new_state->camera = VEC_ZERO;
+  // every level's hopper and portals have the shapes of the ones in level 1
+  new_state->level = level_pack_find(new_state->levels, "level1");
+  assert(new_state->level != NULL);
+  new_state->hopper_shape =
+      kind_shape_cache(new_state->levels, find_kind(new_state, "Hopper"));
+  new_state->portal_shape =
+      kind_shape_cache(new_state->levels, find_kind(new_state, "Portal"));
+  // headless sessions only report problems, the browser build turns the
+  // debug channels back on
+  for (size_t i = 0; i < NUM_LOG_CHANNELS; i++) {
+    logger_set_level(new_state->logger, i, LOG_WARN);
+  }
+  logger_set_rate_limit(new_state->logger, LOG_CHANNEL_PHYSICS,
+                        ELASTICITY_LOG_INTERVAL_MS);
+  new_state->level_mark = alloc_track_mark();
+  new_state->leaks = 0;
   opening_init(new_state);
+  new_state->level_held = alloc_track_since(&new_state->level_mark);
   return new_state;
 }
 
-bool check_pass(state_t *state, size_t portal_idx) {
-  if (scene_get_body(state->scene, portal_idx) == NULL) {
-    return 1;
+void game_session_free(state_t *state) {
+  input_queue_free(state->input);
+  rules_free(state->forces.rules);
+  pthread_mutex_destroy(&state->lock);
+  spatial_index_free(state->aim_index);
+  free(state->guide);
+  shape_cache_free(state->hopper_shape);
+  shape_cache_free(state->portal_shape);
+  profiler_free(state->profiler);
+  logger_free(state->logger);
+  free_scene(state->scene);
+  free_world(state);
+  point_list_free(&state->level_points);
+  level_pack_close(state->levels);
+  if (state->snapshots != NULL) {
+    snapshot_buffer_free(state->snapshots);
   }
-  scene_t *curr_scene = state->scene;
-  body_t *hopper = scene_get_body(curr_scene, HOPPER_IDX);
-  if (state->active_level == LEVEL3) {
-    hopper = scene_get_body(curr_scene, HOPPER_IDX_3);
+  free(state);
+}
+
+void game_start_level(state_t *state, double level) {
+  if (level == LEVEL1_RULES) {
+    level1_rules(state);
+  } else if (level == LEVEL1) {
+    level1_init(state);
+  } else if (level == LEVEL2_RULES) {
+    level2_rules(state);
+  } else if (level == LEVEL2) {
+    level2_init(state);
+  } else if (level == LEVEL3_RULES) {
+    level3_rules(state);
+  } else if (level == LEVEL3) {
+    level3_init(state);
+  } else if (level == WIDE_LEVEL) {
+    wide_init(state);
   }
-  list_t *hopper_shape = body_get_actual_shape(hopper);
-  body_t *portal = scene_get_body(curr_scene, portal_idx);
-  list_t *portal_shape = body_get_actual_shape(portal);
-  if (get_collision_bool(find_collision(hopper_shape, portal_shape)) == 1) {
-    state->level_passed = 1;
-  } else {
-    state->level_passed = 0;
+}
+
+double game_score(state_t *state) { return state->score; }
+
+double game_active_level(state_t *state) { return state->active_level; }
+
+size_t game_hoppers_left(state_t *state) { return state->hoppers_left; }
+
+size_t game_level_leaks(state_t *state) { return state->leaks; }
+
+void game_set_pool(state_t *state, pool_t *pool) { state->forces.pool = pool; }
+
+uint64_t fingerprint_mix(uint64_t hash, const void *data, size_t size) {
+  const unsigned char *bytes = data;
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * FINGERPRINT_PRIME;
   }
-  return state->level_passed;
+  return hash;
 }
 
-void wrap_around1(scene_t *scene) {
-  body_t *hopper = scene_get_body(scene, HOPPER_IDX);
-  double curr_centre_x = body_get_centroid(hopper).x;
-  double curr_centre_y = body_get_centroid(hopper).y;
-  if (curr_centre_y > (WINDOW.y - HOPPER_SIZE.y * HALF_MULTIPLY)) {
-    body_set_centroid(hopper,
-                      (vector_t){curr_centre_x, HOPPER_SIZE.y * HALF_MULTIPLY});
-  } else if (curr_centre_y < (HOPPER_SIZE.y * HALF_MULTIPLY)) {
-    body_set_centroid(hopper,
-                      (vector_t){curr_centre_x,
-                                 (WINDOW.y - (HOPPER_SIZE.y * HALF_MULTIPLY))});
+uint64_t game_fingerprint(state_t *state) {
+  uint64_t hash = FINGERPRINT_SEED;
+  hash = fingerprint_mix(hash, &state->score, sizeof(double));
+  hash = fingerprint_mix(hash, &state->active_level, sizeof(double));
+  hash = fingerprint_mix(hash, &state->hoppers_left, sizeof(size_t));
+  for (size_t i = 0; i < scene_bodies(state->scene); i++) {
+    body_t *body = scene_get_body(state->scene, i);
+    vector_t centroid = body_get_centroid(body);
+    vector_t velocity = body_get_velocity(body);
+    double rotation = body_get_rotation(body);
+    double score = body_get_score(body);
+    bool removed = body_is_removed(body);
+    hash = fingerprint_mix(hash, &centroid, sizeof(vector_t));
+    hash = fingerprint_mix(hash, &velocity, sizeof(vector_t));
+    hash = fingerprint_mix(hash, &rotation, sizeof(double));
+    hash = fingerprint_mix(hash, &score, sizeof(double));
+    hash = fingerprint_mix(hash, &removed, sizeof(bool));
   }
+  return hash;
 }
 
-void emscripten_main(state_t *state) {
-  double dt = time_since_last_tick();
-  scene_t *curr_scene = state->scene;
+quality_tier_t game_quality_tier(state_t *state) { return state->quality; }
 
-  if (state->active_level == LEVEL1 || state->active_level == LEVEL2 ||
-      state->active_level == LEVEL3) {
-    body_t *hopper = scene_get_body(curr_scene, HOPPER_IDX);
+size_t game_over_budget_frames(state_t *state) {
+  return state->budget != NULL ? frame_budget_over(state->budget) : 0;
+}
+
+// true on the opening, rules, win and lose screens
+bool is_static_screen(state_t *state) {
+  return state->active_level != LEVEL1 && state->active_level != LEVEL2 &&
+         state->active_level != LEVEL3 && state->active_level != WIDE_LEVEL;
+}
 
-    if (state->active_level == LEVEL3) {
-      hopper = scene_get_body(curr_scene, HOPPER_IDX_3);
+// checks that no body would move on the next tick
+bool scene_at_rest(scene_t *scene) {
+  for (size_t i = 0; i < scene_bodies(scene); i++) {
+    vector_t velocity = body_get_velocity(scene_get_body(scene, i));
+    if (velocity.x != 0 || velocity.y != 0) {
+      return false;
     }
+  }
+  return true;
+}
 
-    scene_tick(curr_scene, dt);
-    state->time_passed++;
-
-    // if Hopper passes through the portal, transition to the next level
-    // for level 1, if the pineapple is eaten, show the best path
-    if ((state->active_level) == LEVEL1) {
-      if (check_pass(state, PORTAL_IDX_1)) {
-        level2_rules(state);
-        state->active_level = LEVEL2_RULES;
-        curr_scene = state->scene;
-        hopper = scene_get_body(curr_scene, HOPPER_IDX);
-      } else {
-        wrap_around1(curr_scene);
-        if (!check_status(curr_scene).pineapple_status) {
-          show_best_path(calculate_bone_positions_2(
-                             curr_scene, NUM_BONES * QUARTER_MULTIPLY),
-                         curr_scene);
-        }
-        if (state->time_since_death < COOLDOWN_TIME && state->cooldown_active) {
-          body_set_centroid(hopper,
-                            (vector_t){HOPPER_SIZE.x / 2, HOPPER_SIZE.y / 2});
-          state->time_since_death = state->time_since_death + dt;
-          // state->hoppers_left = state->hoppers_left + 1;
-          state->projectile = false;
-        } else {
-          state->cooldown_active = false;
-        }
-        portal_motion(state, PORTAL_IDX_1, dt);
-      }
+// a static screen is stepped and published once, after that ticks are
+// skipped and the simulation slowed down until a key press is queued;
+// with nothing new published the render loop draws nothing either
+bool skip_idle_frame(state_t *state) {
+  if (state->needs_render || input_queue_pending(state->input) ||
+      !is_static_screen(state) ||
+      !scene_at_rest(state->scene)) {
+    if (state->idle) {
+      state->idle = false;
+      LOG_VALUE(state->logger, LOG_CHANNEL_GAME, LOG_INFO,
+                "Idle frames skipped: %.0f", state->idle_frames_skipped);
     }
+    return false;
+  }
+  state->idle = true;
+  state->idle_frames_skipped++;
+  return true;
+}
 
-    // for level 2, if the golden bone has been eaten, spawn the portal
-    else if ((state->active_level) == LEVEL2) {
-      if (check_pass(state, scene_bodies(curr_scene) - 1)) {
-        level3_rules(state);
-        state->active_level = LEVEL3_RULES;
-        curr_scene = state->scene;
-        hopper = scene_get_body(curr_scene, HOPPER_IDX);
-      } else {
-        hopper_bounce(state, dt);
-        body_t *potential_portal =
-            scene_get_body(curr_scene, scene_bodies(curr_scene) - 1);
-        if ((!check_status(curr_scene).golden_bone_status) &&
-            (strcmp(body_get_info(potential_portal), "Portal"))) {
-          populate_portal(curr_scene);
-          body_t *portal =
-              scene_get_body(curr_scene, scene_bodies(curr_scene) - 1);
-          body_set_rotation(portal, M_PI * HALF_MULTIPLY);
-          vector_t portal_centroid =
-              (vector_t){WINDOW.x - PORTAL_DIMENSIONS.y * HALF_MULTIPLY,
-                         PORTAL_DIMENSIONS.x};
-          body_set_centroid(portal, portal_centroid);
-        }
-        if (!strcmp(body_get_info(potential_portal), "Portal")) {
-          portal_motion(state, scene_bodies(curr_scene) - 1, dt);
-        }
-        emscripten_log(EM_LOG_NO_PATHS, "Coefficient of restitution: %.2f",
-                       body_get_elasticity(hopper));
-      }
+void game_step(state_t *state, double dt) {
+  state->dt = dt;
+  // a key may change level, so the scene is read after the input
+  apply_input(state);
+  if (state->on_tick == NULL) {
+    return;
+  }
+  profiler_t *profiler = state->profiler;
+
+  profiler_begin(profiler, PHASE_TICK);
+  scene_tick(state->scene, dt);
+  profiler_end(profiler);
+
+  // the contacts and removals of the tick fire the level's triggers, which
+  // may end the level and clear on_tick
+  profiler_begin(profiler, PHASE_RULES);
+  rules_tick(state->forces.rules, dt, state);
+  if (state->on_tick != NULL) {
+    state->on_tick(state, dt);
+  }
+  profiler_end(profiler);
+
+  if (state->on_tick != NULL && state->projectile) {
+    profiler_begin(profiler, PHASE_MOTION);
+    projectile_motion(state, dt);
+    profiler_end(profiler);
+  }
+
+  if (state->on_tick != NULL && state->world != NULL) {
+    profiler_begin(profiler, PHASE_MOTION);
+    scroll_world(state);
+    profiler_end(profiler);
+  }
+}
+
+void sleep_until(double deadline) {
+  double remaining = deadline - now_seconds();
+  if (remaining <= 0) {
+    return;
+  }
+  struct timespec duration = {.tv_sec = (time_t)remaining,
+                              .tv_nsec = (long)(fmod(remaining, 1.0) *
+                                                NS_PER_SECOND)};
+  nanosleep(&duration, NULL);
+}
+
+bool is_aim_target(body_t *body, void *aux) {
+  char *info = body_get_info(body);
+  return !strcmp(info, "Turtle") || !strcmp(info, "Golden Bone") ||
+         !strcmp(info, "Pineapple");
+}
+
+// fills state->guide with the best path once the level 1 pineapple is eaten,
+// or with the line a level 3 projectile would fly up to the first target it
+// would hit
+void update_guide(state_t *state) {
+  state->guide_length = 0;
+  state->aim_hit = false;
+  if (state->active_level == LEVEL1 && state->show_best_path) {
+    sample_best_path(state->guide, BEST_PATH_POINTS);
+    state->guide_length = BEST_PATH_POINTS;
+  } else if (state->active_level == LEVEL3) {
+    if (body_is_removed(state->hopper)) {
+      return;
+    }
+    vector_t origin = body_get_centroid(state->hopper);
+    vector_t velocity = projectile_velocity(state->lily_pad);
+    spatial_index_build(state->aim_index, state->scene, is_aim_target, NULL);
+    ray_hit_t hit;
+    double distance = AIM_RANGE;
+    state->aim_hit = query_sweep(state->aim_index, origin, velocity, AIM_RANGE,
+                                 PROJECTILE_LENGTH, &hit);
+    if (state->aim_hit) {
+      distance = hit.distance;
+      state->aim_point = hit.point;
     }
+    double flight_time = distance / sqrt(vec_dot(velocity, velocity));
+    trajectory_sample(origin, velocity, VEC_ZERO,
+                      flight_time / (AIM_GUIDE_POINTS - 1), state->guide,
+                      AIM_GUIDE_POINTS);
+    state->guide_length = AIM_GUIDE_POINTS;
+  }
+}
 
-    // turtles spawn randomly
-    else if ((state->active_level) == LEVEL3) {
-      double time_passed = state->time_passed;
-      scene_t *curr_scene = state->scene;
-      hopper = scene_get_body(curr_scene, HOPPER_IDX_3);
-      body_t *lily_pad = scene_get_body(curr_scene, LILY_PAD_IDX);
-      body_set_velocity(lily_pad, VEC_ZERO);
-
-      // every spawn_time seconds, spawn a new turtle
-      if ((int)time_passed % (int)SPAWN_TIME == 1) {
-        populate_turtles(curr_scene, LEVEL_3_GRASS);
-      }
+void add_marker(snapshot_t *snapshot, vector_t centre, double length) {
+  vector_t diamond[] = {{centre.x, centre.y + length},
+                        {centre.x + length, centre.y},
+                        {centre.x, centre.y - length},
+                        {centre.x - length, centre.y}};
+  snapshot_add_polygon(snapshot, diamond, sizeof(diamond) / sizeof(vector_t),
+                       BLACK, LAYER_DYNAMIC);
+}
 
-      if (!check_status(curr_scene).pineapple_status) {
-        pineapple_bomb(state);
-        state->pineapple_state = 0;
-      }
+void add_guide(state_t *state, snapshot_t *snapshot) {
+  update_guide(state);
+  for (size_t i = 0; i < state->guide_length; i++) {
+    add_marker(snapshot, state->guide[i], MARKER_LENGTH);
+  }
+  if (state->aim_hit) {
+    add_marker(snapshot, state->aim_point, AIM_MARKER_LENGTH);
+  }
+}
 
-      status_t status = check_status(curr_scene);
-      // if the golden bone is destroyed, then the game is won
-      if (!status.golden_bone_status) {
-        end_init(state);
-        state->level_passed = 1;
-      }
+// the score and lives are shown on every level, the elasticity on level 2
+// and the wide level, where the arrow keys change it
+hud_values_t hud_values(state_t *state) {
+  hud_values_t values = {
+      .visible = !is_static_screen(state),
+      .show_elasticity = state->active_level == LEVEL2 ||
+                         state->active_level == WIDE_LEVEL,
+      .hoppers_left = state->hoppers_left,
+      .score = state->score};
+  if (values.show_elasticity) {
+    values.elasticity = body_get_elasticity(state->hopper);
+  }
+  return values;
+}
 
-      // if Hopper no longer exists, the player has failed
-      else if (!status.hopper_status) {
-        fail_init(state);
-        state->level_passed = 0;
-      }
+// the render prep of a tick, timed as the capture phase
+void capture_snapshot(state_t *state, snapshot_t *snapshot) {
+  profiler_begin(state->profiler, PHASE_CAPTURE);
+  snapshot_capture(snapshot, state->scene, state->ticks, body_sprite, state);
+  snapshot->hud = hud_values(state);
+  snapshot->camera = state->camera;
+  if (state->quality < QUALITY_NO_COSMETICS) {
+    add_guide(state, snapshot);
+  }
+  profiler_end(state->profiler);
+}
+
+void game_profile_frame(state_t *state, double dt) {
+  // headless sessions have nobody to publish to, so they capture into a
+  // buffer of their own
+  if (state->snapshots == NULL) {
+    state->snapshots = snapshot_buffer_init();
+  }
+  profiler_t *profiler = state->profiler;
+  profiler_begin_frame(profiler);
+  game_step(state, dt);
+  state->ticks++;
+  capture_snapshot(state, snapshot_buffer_back(state->snapshots));
+  snapshot_buffer_publish(state->snapshots);
+  profiler_end_frame(profiler, scene_bodies(state->scene),
+                     tracked_force_creators(state));
+}
+
+profiler_t *game_profiler(state_t *state) { return state->profiler; }
+
+void track_budget(state_t *state, double frame_ms) {
+  if (frame_budget_record(state->budget, frame_ms)) {
+    state->quality = frame_budget_tier(state->budget);
+    LOG_VALUE(state->logger, LOG_CHANNEL_GAME, LOG_INFO, "Quality tier: %.0f",
+              state->quality);
+  }
+}
+
+// runs on its own thread (a worker in the browser build): steps the game
+// every SIM_TICK and publishes a snapshot of each tick, so tick N + 1 is
+// simulated while the main thread draws tick N
+void *run_simulation(void *aux) {
+  state_t *state = aux;
+  // the first level was made on the main thread and is freed on this one
+  pthread_mutex_lock(&state->lock);
+  state->level_mark = alloc_track_adopt(&state->level_held);
+  pthread_mutex_unlock(&state->lock);
+  double last_tick = now_seconds();
+  while (atomic_load(&state->running)) {
+    double start = now_seconds();
+    double dt = start - last_tick;
+    last_tick = start;
+
+    pthread_mutex_lock(&state->lock);
+    bool idle = skip_idle_frame(state);
+    if (!idle) {
+      profiler_t *profiler = state->profiler;
+      profiler_begin_frame(profiler);
+      game_step(state, dt);
+      state->ticks++;
+      // the render of the previous tick overlapped this one
+      double render_ms = state->render_ms;
+      profiler_record(profiler, PHASE_RENDER, render_ms);
+      state->render_ms = 0;
+      capture_snapshot(state, snapshot_buffer_back(state->snapshots));
+      snapshot_buffer_publish(state->snapshots);
+      profiler_end_frame(profiler, scene_bodies(state->scene),
+                         tracked_force_creators(state));
+      state->needs_render = false;
+      // simulating and drawing run side by side, so a frame is as slow as
+      // the slower of the two
+      double sim_ms = (now_seconds() - start) * MS_PER_SECOND;
+      track_budget(state, fmax(sim_ms, render_ms));
     }
+    pthread_mutex_unlock(&state->lock);
 
-    // loops through all that hopper can destructively collide with, and adds
-    // the scores to the state
-    // if (check_status(curr_scene).hopper_status) {
-    if (state->level_passed == 0) {
-      for (size_t i = 1; i < scene_bodies(curr_scene); i++) {
-        if (scene_get_body(curr_scene, i) != NULL) {
-          if (state->active_level >= LEVEL3) {
-            add_score_level3(state);
-          } else {
-            add_score(state, hopper, scene_get_body(curr_scene, i));
-          }
-        }
-      }
+    size_t period = 1;
+    if (idle) {
+      period = IDLE_FRAME_INTERVAL;
+    } else if (state->quality >= QUALITY_HALF_RATE) {
+      period = DOUBLE;
+    }
+    sleep_until(start + period * SIM_TICK);
+  }
+  return NULL;
+}
 
-      if (state->projectile == true) {
-        projectile_motion(state, dt);
-      }
+// drawn by the renderer just before it shows each frame; the simulation
+// thread writes the profiler, so it is read under the lock
+void draw_profiler_overlay(void *aux) {
+  state_t *state = aux;
+  pthread_mutex_lock(&state->lock);
+  if (profiler_overlay_shown(state->profiler)) {
+    profiler_draw_overlay(state->profiler);
+  }
+  pthread_mutex_unlock(&state->lock);
+}
+
+state_t *emscripten_init() {
+  sdl_init(VEC_ZERO, WINDOW);
+  state_t *new_state = game_session_init(time(NULL));
+  // without levels the window stays empty; the reason is already on stderr
+  if (new_state == NULL) {
+    return NULL;
+  }
+  for (size_t i = 0; i < NUM_LOG_CHANNELS; i++) {
+    logger_set_level(new_state->logger, i, LOG_DEBUG);
+  }
+  new_state->renderer = renderer_init(sdl_get_renderer(), WINDOW);
+  // one thread per core natively, the browser build checks contacts serially
+  new_state->forces.pool = pool_init(0);
+  // without a pack the images are decoded from for_images/ as they are drawn
+  asset_pack_t *pack = asset_pack_open(ASSET_PACK_PATH);
+  if (pack != NULL) {
+    render_preload_pack(new_state->renderer, pack);
+    asset_pack_close(pack);
+  }
+  // without the font the levels are drawn with no score or lives readout
+  if (!render_init_hud(new_state->renderer, HUD_FONT_PATH, HUD_POINT_SIZE)) {
+    fprintf(stderr, "cannot open the HUD font %s\n", HUD_FONT_PATH);
+  }
+  render_set_overlay(new_state->renderer, draw_profiler_overlay, new_state);
+  new_state->snapshots = snapshot_buffer_init();
+  new_state->budget = frame_budget_init(SIM_TICK * MS_PER_SECOND);
+  atomic_store(&new_state->running, true);
+  pthread_create(&new_state->simulation, NULL, run_simulation, new_state);
+  sdl_on_key((void *)on_key);
+  return new_state;
+}
+
+// the browser's main loop only draws; it picks up the latest snapshot from
+// the simulation thread and skips the frame when there is none
+void emscripten_main(state_t *state) {
+  if (state == NULL) {
+    return;
+  }
+  snapshot_t *snapshot = snapshot_buffer_latest(state->snapshots);
+  if (snapshot != NULL) {
+    double start = now_seconds();
+    render_snapshot(state->renderer, snapshot);
+    double render_ms = (now_seconds() - start) * MS_PER_SECOND;
+    size_t draw_calls = render_draw_calls(state->renderer);
+    state->frames_drawn++;
+    state->draw_calls += draw_calls;
+    if (draw_calls > state->max_draw_calls) {
+      state->max_draw_calls = draw_calls;
     }
+
+    pthread_mutex_lock(&state->lock);
+    state->render_ms += render_ms;
+    pthread_mutex_unlock(&state->lock);
+  }
+  logger_maybe_flush(state->logger);
+}
+
+// writes the frame profile if the overlay was opened during the session
+void dump_profile(profiler_t *profiler) {
+  if (!profiler_was_used(profiler)) {
+    return;
+  }
+  FILE *json = fopen(PROFILE_JSON_PATH, "w");
+  if (json != NULL) {
+    profiler_dump_json(profiler, json);
+    fclose(json);
+  }
+  FILE *csv = fopen(PROFILE_CSV_PATH, "w");
+  if (csv != NULL) {
+    profiler_dump_csv(profiler, csv);
+    fclose(csv);
   }
-  sdl_render_scene(state);
+}
+
+// what the renderer did over the session, printed with the frame profile
+void report_rendering(state_t *state) {
+  if (!profiler_was_used(state->profiler)) {
+    return;
+  }
+  if (state->frames_drawn > 0) {
+    fprintf(stderr, "%.1f draw calls per frame, at most %zu\n",
+            (double)state->draw_calls / state->frames_drawn,
+            state->max_draw_calls);
+  }
+  fprintf(stderr, "static layer rebuilt %zu times\n",
+          render_static_rebuilds(state->renderer));
+  fprintf(stderr, "HUD laid out %zu times\n",
+          render_hud_layouts(state->renderer));
 }
 
 void emscripten_free(state_t *state) {
-  scene_free(state->scene);
-  free(state);
+  if (state == NULL) {
+    return;
+  }
+  atomic_store(&state->running, false);
+  pthread_join(state->simulation, NULL);
+  dump_profile(state->profiler);
+  report_rendering(state);
+  renderer_free(state->renderer);
+  frame_budget_free(state->budget);
+  state->budget = NULL;
+  pool_free(state->forces.pool);
+  game_session_free(state);
+#ifdef ALLOC_TRACKING
+  // debug builds show what the session allocated and anything still live
+  alloc_track_report(stderr);
+#endif
 }
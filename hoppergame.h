@@ -0,0 +1,149 @@
+#ifndef __HOPPERGAME_H__
+#define __HOPPERGAME_H__
+
+#include "frame_budget.h"
+#include "pool.h"
+#include "profiler.h"
+#include "sdl_wrapper.h"
+#include "state.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The values of state->active_level for each screen of the game.
+ * The rules screens sit halfway between the levels they introduce.
+ */
+extern const double OPENING_LEVEL;
+extern const double LEVEL1_RULES;
+extern const double LEVEL1;
+extern const double LEVEL2_RULES;
+extern const double LEVEL2;
+extern const double LEVEL3_RULES;
+extern const double LEVEL3;
+extern const double FAIL;
+extern const double WIN;
+
+/**
+ * The value of state->active_level on the wide level, a level 2 three windows
+ * wide that scrolls with the hopper. No other screen leads to it; only
+ * game_start_level() opens it, and passing it wins the game.
+ */
+extern const double WIDE_LEVEL;
+
+/**
+ * Creates a game session on the opening screen without opening a window.
+ * Every session owns its scene, random generator and key handler, so
+ * separate sessions can be stepped from separate threads.
+ *
+ * @param seed the seed of the session's random bone, shelf, pineapple and
+ *   turtle placement; the same seed always lays out the same levels
+ * @return the new session, or NULL if the level pack could not be opened and
+ *   the level descriptions could not be compiled, which is reported on stderr
+ */
+state_t *game_session_init(uint32_t seed);
+
+/**
+ * Releases the scene and memory of a session.
+ *
+ * @param state a pointer to a session returned from game_session_init()
+ */
+void game_session_free(state_t *state);
+
+/**
+ * Jumps straight to a level or its rules screen.
+ *
+ * @param state a pointer to a session returned from game_session_init()
+ * @param level one of LEVEL1_RULES, LEVEL1, LEVEL2_RULES, LEVEL2,
+ *   LEVEL3_RULES, LEVEL3 or WIDE_LEVEL
+ */
+void game_start_level(state_t *state, double level);
+
+/**
+ * Advances the physics, level rules and scoring of a session by one tick.
+ * Nothing is drawn.
+ *
+ * @param state a pointer to a session returned from game_session_init()
+ * @param dt the time of the tick in seconds
+ */
+void game_step(state_t *state, double dt);
+
+/**
+ * Steps a session like game_step() and then prepares the snapshot a renderer
+ * would draw, like the browser build does every tick. Both are recorded as
+ * one frame of the session's profiler, with the preparation as its
+ * PHASE_CAPTURE.
+ *
+ * @param state a pointer to a session returned from game_session_init()
+ * @param dt the time of the tick in seconds
+ */
+void game_profile_frame(state_t *state, double dt);
+
+/**
+ * Gets the profiler the phases of a session are timed with.
+ *
+ * @param state a pointer to a session returned from game_session_init()
+ * @return the session's profiler
+ */
+profiler_t *game_profiler(state_t *state);
+
+/**
+ * Sends a key event to the session, as if it came from the keyboard.
+ * Keys are queued and applied at the start of the next game_step().
+ *
+ * @param state a pointer to a session returned from game_session_init()
+ * @param key the key, e.g. SPACE or UP_ARROW
+ * @param type whether the key was pressed or released
+ * @param held_time how long the key has been held in seconds
+ */
+void game_key(state_t *state, char key, key_event_type_t type,
+              double held_time);
+
+/**
+ * Gets the score, current screen and remaining tries of a session.
+ *
+ * @param state a pointer to a session returned from game_session_init()
+ */
+double game_score(state_t *state);
+double game_active_level(state_t *state);
+size_t game_hoppers_left(state_t *state);
+
+/**
+ * Gets how many objects the levels of a session left allocated after their
+ * scene was freed. Each one is also logged as a warning when it is found.
+ * Always 0 when allocation tracking is compiled out.
+ *
+ * @param state a pointer to a session returned from game_session_init()
+ * @return the number of leaked scenes, bodies, shapes, forces and lists
+ */
+size_t game_level_leaks(state_t *state);
+
+/**
+ * Checks a headless session's contacts on a pool instead of the calling
+ * thread. The session does not own the pool, which must outlive it.
+ *
+ * @param state a pointer to a session returned from game_session_init()
+ * @param pool a pointer to a pool returned from pool_init(), or NULL to
+ *   check contacts on the calling thread
+ */
+void game_set_pool(state_t *state, pool_t *pool);
+
+/**
+ * Hashes the score, screen and remaining tries of a session together with
+ * the pose, velocity and score of every body of its scene, bit for bit, so
+ * two runs of one seed can be compared tick by tick.
+ *
+ * @param state a pointer to a session returned from game_session_init()
+ * @return the hash
+ */
+uint64_t game_fingerprint(state_t *state);
+
+/**
+ * Gets the quality tier the browser build is running at and how many of its
+ * frames went over budget. Headless sessions always run at full quality.
+ *
+ * @param state a pointer to a session returned from game_session_init()
+ */
+quality_tier_t game_quality_tier(state_t *state);
+size_t game_over_budget_frames(state_t *state);
+
+#endif // #ifndef __HOPPERGAME_H__
@@ -0,0 +1,237 @@
+#include "hud.h"
+#include "alloc_track.h"
+#include <SDL2/SDL_ttf.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FIRST_GLYPH ' '
+#define LAST_GLYPH '~'
+#define NUM_GLYPHS (LAST_GLYPH - FIRST_GLYPH + 1)
+#define MAX_TEXT 64
+// every character is drawn twice, its shadow first
+#define MAX_QUADS (2 * MAX_TEXT)
+
+static const int ATLAS_WIDTH = 512;
+static const int GLYPH_PADDING = 1;
+static const size_t ATLAS_BYTES_PER_PIXEL = 4;
+static const float MARGIN = 10;
+static const float SHADOW_OFFSET = 2;
+static const SDL_Color TEXT_COLOR = {255, 255, 255, 255};
+static const SDL_Color SHADOW_COLOR = {0, 0, 0, 160};
+static const size_t QUAD_VERTICES = 4;
+static const int QUAD_INDICES[] = {0, 1, 2, 0, 2, 3};
+static const size_t NUM_QUAD_INDICES = 6;
+
+typedef struct glyph {
+  // where the glyph is in the atlas, empty for glyphs the font lacks
+  SDL_Rect rect;
+  int advance;
+} glyph_t;
+
+struct hud {
+  SDL_Renderer *sdl;
+  SDL_Texture *atlas;
+  int atlas_height;
+  int line_height;
+  glyph_t glyphs[NUM_GLYPHS];
+
+  bool laid_out;
+  hud_values_t shown;
+  char text[MAX_TEXT];
+  size_t num_quads;
+  SDL_Vertex vertices[MAX_QUADS * 4];
+  int indices[MAX_QUADS * 6];
+  size_t layouts;
+};
+
+static SDL_Surface *render_glyph(TTF_Font *font, char c) {
+  SDL_Surface *glyph = TTF_RenderGlyph_Blended(font, c, TEXT_COLOR);
+  if (glyph == NULL) {
+    return NULL;
+  }
+  SDL_Surface *rgba =
+      SDL_ConvertSurfaceFormat(glyph, SDL_PIXELFORMAT_RGBA32, 0);
+  SDL_FreeSurface(glyph);
+  return rgba;
+}
+
+// places the glyphs left to right in rows of one line each
+static void place_glyphs(hud_t *hud, SDL_Surface **surfaces) {
+  int x = 0;
+  int y = 0;
+  for (size_t i = 0; i < NUM_GLYPHS; i++) {
+    int width = surfaces[i] == NULL ? 0 : surfaces[i]->w;
+    int height = surfaces[i] == NULL ? 0 : surfaces[i]->h;
+    if (x + width > ATLAS_WIDTH) {
+      x = 0;
+      y += hud->line_height + GLYPH_PADDING;
+    }
+    hud->glyphs[i].rect = (SDL_Rect){x, y, width, height};
+    x += width + GLYPH_PADDING;
+  }
+  hud->atlas_height = y + hud->line_height;
+}
+
+static void build_atlas(hud_t *hud, SDL_Surface **surfaces) {
+  uint32_t *pixels =
+      calloc((size_t)ATLAS_WIDTH * hud->atlas_height, sizeof(uint32_t));
+  assert(pixels != NULL);
+  for (size_t i = 0; i < NUM_GLYPHS; i++) {
+    SDL_Surface *surface = surfaces[i];
+    SDL_Rect *rect = &hud->glyphs[i].rect;
+    for (int row = 0; surface != NULL && row < rect->h; row++) {
+      memcpy(&pixels[(size_t)(rect->y + row) * ATLAS_WIDTH + rect->x],
+             (uint8_t *)surface->pixels + (size_t)row * surface->pitch,
+             rect->w * ATLAS_BYTES_PER_PIXEL);
+    }
+  }
+  hud->atlas =
+      SDL_CreateTexture(hud->sdl, SDL_PIXELFORMAT_RGBA32,
+                        SDL_TEXTUREACCESS_STATIC, ATLAS_WIDTH,
+                        hud->atlas_height);
+  assert(hud->atlas != NULL);
+  SDL_UpdateTexture(hud->atlas, NULL, pixels,
+                    ATLAS_WIDTH * ATLAS_BYTES_PER_PIXEL);
+  SDL_SetTextureBlendMode(hud->atlas, SDL_BLENDMODE_BLEND);
+  alloc_track_add(ALLOC_TEXTURE, (size_t)ATLAS_WIDTH * hud->atlas_height *
+                                     ATLAS_BYTES_PER_PIXEL);
+  free(pixels);
+}
+
+hud_t *hud_init(SDL_Renderer *renderer, const char *font_path,
+                int point_size) {
+  if (TTF_Init() < 0) {
+    return NULL;
+  }
+  TTF_Font *font = TTF_OpenFont(font_path, point_size);
+  if (font == NULL) {
+    TTF_Quit();
+    return NULL;
+  }
+  hud_t *hud = malloc(sizeof(hud_t));
+  assert(hud != NULL);
+  *hud = (hud_t){.sdl = renderer, .line_height = TTF_FontHeight(font)};
+
+  SDL_Surface *surfaces[NUM_GLYPHS];
+  for (size_t i = 0; i < NUM_GLYPHS; i++) {
+    char c = FIRST_GLYPH + i;
+    surfaces[i] = render_glyph(font, c);
+    if (surfaces[i] != NULL && surfaces[i]->h > hud->line_height) {
+      hud->line_height = surfaces[i]->h;
+    }
+    int min_x, max_x, min_y, max_y, advance;
+    if (TTF_GlyphMetrics(font, c, &min_x, &max_x, &min_y, &max_y,
+                         &advance) == 0) {
+      hud->glyphs[i].advance = advance;
+    }
+  }
+  // the font is only needed until every glyph is in the atlas
+  TTF_CloseFont(font);
+  TTF_Quit();
+
+  place_glyphs(hud, surfaces);
+  build_atlas(hud, surfaces);
+  for (size_t i = 0; i < NUM_GLYPHS; i++) {
+    if (surfaces[i] != NULL) {
+      SDL_FreeSurface(surfaces[i]);
+    }
+  }
+  return hud;
+}
+
+void hud_free(hud_t *hud) {
+  alloc_track_remove(ALLOC_TEXTURE, (size_t)ATLAS_WIDTH * hud->atlas_height *
+                                        ATLAS_BYTES_PER_PIXEL);
+  SDL_DestroyTexture(hud->atlas);
+  free(hud);
+}
+
+static bool same_values(hud_values_t *values1, hud_values_t *values2) {
+  return values1->visible == values2->visible &&
+         values1->show_elasticity == values2->show_elasticity &&
+         values1->hoppers_left == values2->hoppers_left &&
+         values1->score == values2->score &&
+         values1->elasticity == values2->elasticity;
+}
+
+static void format_text(hud_values_t *values, char *text) {
+  if (values->show_elasticity) {
+    snprintf(text, MAX_TEXT, "Score %.0f\nLives %zu\nBounce %.2f",
+             values->score, values->hoppers_left, values->elasticity);
+  } else {
+    snprintf(text, MAX_TEXT, "Score %.0f\nLives %zu", values->score,
+             values->hoppers_left);
+  }
+}
+
+static void add_quad(hud_t *hud, glyph_t *glyph, float x, float y,
+                     SDL_Color color) {
+  SDL_Rect *rect = &glyph->rect;
+  float left = (float)rect->x / ATLAS_WIDTH;
+  float right = (float)(rect->x + rect->w) / ATLAS_WIDTH;
+  float top = (float)rect->y / hud->atlas_height;
+  float bottom = (float)(rect->y + rect->h) / hud->atlas_height;
+  SDL_Vertex *vertices = &hud->vertices[hud->num_quads * QUAD_VERTICES];
+  vertices[0] = (SDL_Vertex){{x, y}, color, {left, top}};
+  vertices[1] = (SDL_Vertex){{x + rect->w, y}, color, {right, top}};
+  vertices[2] =
+      (SDL_Vertex){{x + rect->w, y + rect->h}, color, {right, bottom}};
+  vertices[3] = (SDL_Vertex){{x, y + rect->h}, color, {left, bottom}};
+  int *indices = &hud->indices[hud->num_quads * NUM_QUAD_INDICES];
+  for (size_t i = 0; i < NUM_QUAD_INDICES; i++) {
+    indices[i] = QUAD_INDICES[i] + hud->num_quads * QUAD_VERTICES;
+  }
+  hud->num_quads++;
+}
+
+static void add_text(hud_t *hud, float offset, SDL_Color color) {
+  float x = MARGIN + offset;
+  float y = MARGIN + offset;
+  for (const char *c = hud->text; *c != '\0'; c++) {
+    if (*c == '\n') {
+      x = MARGIN + offset;
+      y += hud->line_height;
+      continue;
+    }
+    if (*c < FIRST_GLYPH || *c > LAST_GLYPH) {
+      continue;
+    }
+    glyph_t *glyph = &hud->glyphs[*c - FIRST_GLYPH];
+    if (glyph->rect.w > 0) {
+      add_quad(hud, glyph, x, y, color);
+    }
+    x += glyph->advance;
+  }
+}
+
+// a change that does not show in the text, such as a score of 10.2 becoming
+// 10.4, keeps the quads of the last layout
+static void layout(hud_t *hud, hud_values_t *values) {
+  hud->shown = *values;
+  char text[MAX_TEXT];
+  format_text(values, text);
+  if (hud->laid_out && !strcmp(text, hud->text)) {
+    return;
+  }
+  memcpy(hud->text, text, MAX_TEXT);
+  hud->num_quads = 0;
+  add_text(hud, SHADOW_OFFSET, SHADOW_COLOR);
+  add_text(hud, 0, TEXT_COLOR);
+  hud->laid_out = true;
+  hud->layouts++;
+}
+
+void hud_draw(hud_t *hud, hud_values_t *values) {
+  if (!hud->laid_out || !same_values(values, &hud->shown)) {
+    layout(hud, values);
+  }
+  SDL_RenderGeometry(hud->sdl, hud->atlas, hud->vertices,
+                     hud->num_quads * QUAD_VERTICES, hud->indices,
+                     hud->num_quads * NUM_QUAD_INDICES);
+}
+
+size_t hud_layouts(hud_t *hud) { return hud->layouts; }
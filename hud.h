@@ -0,0 +1,52 @@
+#ifndef __HUD_H__
+#define __HUD_H__
+
+#include "snapshot.h"
+#include <SDL2/SDL.h>
+#include <stddef.h>
+
+/**
+ * The score, lives and elasticity readout drawn over a level.
+ * Every printable ASCII glyph of the font is rasterized once into an atlas
+ * texture when the HUD is made. The text is only laid out again when the
+ * values it shows change, and each frame draws the laid out quads of every
+ * glyph with a single geometry call.
+ */
+typedef struct hud hud_t;
+
+/**
+ * Rasterizes the glyphs of a font into the HUD's atlas.
+ *
+ * @param renderer the SDL renderer the HUD is drawn with
+ * @param font_path the path of a TrueType font
+ * @param point_size the size of the text in output pixels
+ * @return the new HUD, or NULL if the font cannot be opened
+ */
+hud_t *hud_init(SDL_Renderer *renderer, const char *font_path,
+                int point_size);
+
+/**
+ * Releases the atlas and memory of a HUD.
+ *
+ * @param hud a pointer to a HUD returned from hud_init()
+ */
+void hud_free(hud_t *hud);
+
+/**
+ * Draws the HUD in the top left corner of the current frame, laying the text
+ * out again first if values differs from what was drawn last.
+ *
+ * @param hud a pointer to a HUD returned from hud_init()
+ * @param values the numbers to show
+ */
+void hud_draw(hud_t *hud, hud_values_t *values);
+
+/**
+ * Gets how many times the text has been laid out.
+ *
+ * @param hud a pointer to a HUD returned from hud_init()
+ * @return the number of layouts
+ */
+size_t hud_layouts(hud_t *hud);
+
+#endif // #ifndef __HUD_H__
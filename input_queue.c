@@ -0,0 +1,100 @@
+#include "input_queue.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+static const size_t INIT_EVENT_CAPACITY = 16;
+static const double NS_PER_SECOND = 1e9;
+
+typedef struct event_buffer {
+  input_event_t *events;
+  size_t size;
+  size_t capacity;
+} event_buffer_t;
+
+// events are pushed to pending; a drain swaps it with drained, so the lock is
+// only held for a push or a swap
+struct input_queue {
+  pthread_mutex_t lock;
+  event_buffer_t pending;
+  event_buffer_t drained;
+};
+
+static void buffer_init(event_buffer_t *buffer) {
+  buffer->events = malloc(INIT_EVENT_CAPACITY * sizeof(input_event_t));
+  assert(buffer->events != NULL);
+  buffer->size = 0;
+  buffer->capacity = INIT_EVENT_CAPACITY;
+}
+
+static void reserve(event_buffer_t *buffer, size_t capacity) {
+  if (capacity <= buffer->capacity) {
+    return;
+  }
+  buffer->capacity *= 2;
+  buffer->events =
+      realloc(buffer->events, buffer->capacity * sizeof(input_event_t));
+  assert(buffer->events != NULL);
+}
+
+static double now_seconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / NS_PER_SECOND;
+}
+
+input_queue_t *input_queue_init(void) {
+  input_queue_t *queue = malloc(sizeof(input_queue_t));
+  assert(queue != NULL);
+  pthread_mutex_init(&queue->lock, NULL);
+  buffer_init(&queue->pending);
+  buffer_init(&queue->drained);
+  return queue;
+}
+
+void input_queue_free(input_queue_t *queue) {
+  pthread_mutex_destroy(&queue->lock);
+  free(queue->pending.events);
+  free(queue->drained.events);
+  free(queue);
+}
+
+void input_queue_push(input_queue_t *queue, char key, key_event_type_t type,
+                      double held_time) {
+  input_event_t event = {.key = key,
+                         .type = type,
+                         .held_time = held_time,
+                         .time = now_seconds()};
+  pthread_mutex_lock(&queue->lock);
+  event_buffer_t *pending = &queue->pending;
+  input_event_t *newest =
+      pending->size > 0 ? &pending->events[pending->size - 1] : NULL;
+  if (newest != NULL && type == KEY_PRESSED && newest->type == KEY_PRESSED &&
+      newest->key == key) {
+    // keep the first arrival time so the latency of the press is not hidden
+    newest->held_time = held_time;
+  } else {
+    reserve(pending, pending->size + 1);
+    pending->events[pending->size++] = event;
+  }
+  pthread_mutex_unlock(&queue->lock);
+}
+
+bool input_queue_pending(input_queue_t *queue) {
+  pthread_mutex_lock(&queue->lock);
+  bool pending = queue->pending.size > 0;
+  pthread_mutex_unlock(&queue->lock);
+  return pending;
+}
+
+size_t input_queue_drain(input_queue_t *queue, input_event_t **events) {
+  pthread_mutex_lock(&queue->lock);
+  event_buffer_t drained = queue->pending;
+  queue->pending = queue->drained;
+  queue->pending.size = 0;
+  queue->drained = drained;
+  pthread_mutex_unlock(&queue->lock);
+  *events = drained.events;
+  return drained.size;
+}
@@ -0,0 +1,72 @@
+#ifndef __INPUT_QUEUE_H__
+#define __INPUT_QUEUE_H__
+
+#include "sdl_wrapper.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * One key event as delivered by the event pump, with the time it arrived.
+ */
+typedef struct input_event {
+  char key;
+  key_event_type_t type;
+  double held_time;
+  // seconds on CLOCK_MONOTONIC
+  double time;
+} input_event_t;
+
+/**
+ * Key events waiting for the next simulation tick.
+ * Any thread may push; a single consumer drains the whole queue at once,
+ * so events reach the game in order and at tick boundaries.
+ */
+typedef struct input_queue input_queue_t;
+
+/**
+ * Allocates an empty input queue.
+ *
+ * @return the new queue
+ */
+input_queue_t *input_queue_init(void);
+
+/**
+ * Releases the memory of an input queue and any events still in it.
+ *
+ * @param queue a pointer to a queue returned from input_queue_init()
+ */
+void input_queue_free(input_queue_t *queue);
+
+/**
+ * Adds an event to the queue, stamped with the current time.
+ * A press of the key pressed by the newest waiting event replaces that
+ * event's held time rather than queueing a repeat, so holding a key yields at
+ * most one press per tick however fast the key repeats.
+ *
+ * @param queue a pointer to a queue returned from input_queue_init()
+ * @param key the key
+ * @param type whether the key was pressed or released
+ * @param held_time how long the key has been held, in seconds
+ */
+void input_queue_push(input_queue_t *queue, char key, key_event_type_t type,
+                      double held_time);
+
+/**
+ * Checks whether any events are waiting.
+ *
+ * @param queue a pointer to a queue returned from input_queue_init()
+ * @return true if the next drain would return events
+ */
+bool input_queue_pending(input_queue_t *queue);
+
+/**
+ * Takes every waiting event, oldest first.
+ * The events stay valid until the next drain, and only one thread may drain.
+ *
+ * @param queue a pointer to a queue returned from input_queue_init()
+ * @param events set to the first event taken
+ * @return the number of events taken
+ */
+size_t input_queue_drain(input_queue_t *queue, input_event_t **events);
+
+#endif // #ifndef __INPUT_QUEUE_H__
@@ -0,0 +1,645 @@
+// Compiles the level descriptions into the bytes of a level pack, for the
+// pack_levels build step and for sessions started without a pack.
+//
+// A description is a list of lines, each a keyword and its arguments, with
+// names that contain spaces in double quotes, # starting a comment and a
+// backslash at the end of a line continuing it on the next:
+//
+//   level <name>
+//   world <width> [chunk <width>]
+//   kind <name>
+//     shape rectangle <width> <height> | star <length> <points> |
+//           pacman <radius>
+//     mass <mass | inf>     color <r> <g> <b>     score <score>
+//     elasticity <e>        velocity <x> <y>      rotation <radians>
+//     sprite <path> <width> <height>   sprite_right <path>
+//     layer static | dynamic   depth <depth>   streamed
+//   points <name> at <x> <y> [<count>]
+//   points <name> line <count> from <x> <y> step <x> <y>
+//   points <name> trajectory <count> from <x> <y> velocity <x> <y>
+//                 gravity <g> every <seconds>
+//   points <name> random <count> in <x0> <y0> <x1> <y1>
+//                 [avoid <x0> <y0> <x1> <y1>]...
+//   points <name> rows <count> in <x0> <y0> <x1> <y1> rows <r> columns <c>
+//   points <name> offset <points> by <x> <y>
+//   place <kind> <points> [<index>[-<index>],...] [score <score>]
+//   collide <kind> <kind> destroy | destroy_both | bounce <e> | rotate
+//   spawn <kind> <points> [every <ticks>]
+//
+// Kinds and point sets belong to the level they follow and must be described
+// before they are used. Shapes are made with the same functions the game
+// used to call and stored around their centroid. Colors are 0 to 255.
+// Within a layer, kinds of a lower depth are drawn under those of a higher
+// one; kinds are at depth 1 unless they say otherwise, so backgrounds go at 0.
+// Levels without a world fit the window; a wider world scrolls, and the
+// bodies of streamed kinds are only in the scene near the camera.
+#include "level_compiler.h"
+#include "polygon.h"
+#include "shape.h"
+#include "snapshot.h"
+#include <assert.h>
+#include <math.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LINE 512
+#define MAX_TOKENS 32
+
+static const double COLOR_SCALE = 255.0;
+static const double DEFAULT_CHUNK_WIDTH = 500;
+static const uint32_t DEFAULT_DEPTH = 1;
+
+typedef struct table {
+  void *data;
+  size_t size;
+  size_t count;
+  size_t capacity;
+} table_t;
+
+typedef struct tables {
+  table_t levels;
+  table_t kinds;
+  table_t vertices;
+  table_t point_sets;
+  table_t placements;
+  table_t indices;
+  table_t collisions;
+  table_t spawns;
+} tables_t;
+
+typedef struct parser {
+  const char *path;
+  size_t line;
+  char *tokens[MAX_TOKENS];
+  size_t num_tokens;
+  tables_t *tables;
+  level_entry_t *level;
+  level_kind_t *kind;
+  // where parse_file() picks up after a description fails to parse
+  jmp_buf failed;
+} parser_t;
+
+static void table_init(table_t *table, size_t size) {
+  *table = (table_t){.size = size};
+}
+
+// rows are handed out by index, since adding one may move the others
+static size_t table_add(table_t *table) {
+  if (table->count == table->capacity) {
+    table->capacity = table->capacity == 0 ? 16 : table->capacity * 2;
+    table->data = realloc(table->data, table->capacity * table->size);
+  }
+  memset((char *)table->data + table->count * table->size, 0, table->size);
+  return table->count++;
+}
+
+static void *table_get(table_t *table, size_t index) {
+  return (char *)table->data + index * table->size;
+}
+
+static void fail(parser_t *parser, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  fprintf(stderr, "levels: %s:%zu: ", parser->path, parser->line);
+  vfprintf(stderr, format, args);
+  fprintf(stderr, "\n");
+  va_end(args);
+  longjmp(parser->failed, 1);
+}
+
+// splits a line in place into words and quoted names, dropping comments
+static void tokenize(parser_t *parser, char *line) {
+  parser->num_tokens = 0;
+  char *c = line;
+  while (*c != '\0') {
+    while (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n') {
+      c++;
+    }
+    if (*c == '\0' || *c == '#') {
+      break;
+    }
+    if (parser->num_tokens == MAX_TOKENS) {
+      fail(parser, "too many words");
+    }
+    if (*c == '"') {
+      char *end = strchr(c + 1, '"');
+      if (end == NULL) {
+        fail(parser, "unterminated name");
+      }
+      *end = '\0';
+      parser->tokens[parser->num_tokens++] = c + 1;
+      c = end + 1;
+    } else {
+      parser->tokens[parser->num_tokens++] = c;
+      while (*c != '\0' && *c != ' ' && *c != '\t' && *c != '\r' &&
+             *c != '\n') {
+        c++;
+      }
+      if (*c != '\0') {
+        *c++ = '\0';
+      }
+    }
+  }
+}
+
+static char *token(parser_t *parser, size_t index) {
+  if (index >= parser->num_tokens) {
+    fail(parser, "%s needs more arguments", parser->tokens[0]);
+  }
+  return parser->tokens[index];
+}
+
+static bool is_token(parser_t *parser, size_t index, const char *word) {
+  return index < parser->num_tokens && !strcmp(parser->tokens[index], word);
+}
+
+static void expect(parser_t *parser, size_t index, const char *word) {
+  if (!is_token(parser, index, word)) {
+    fail(parser, "expected %s", word);
+  }
+}
+
+static double number(parser_t *parser, size_t index) {
+  char *text = token(parser, index);
+  if (!strcmp(text, "inf")) {
+    return INFINITY;
+  }
+  char *end;
+  double value = strtod(text, &end);
+  if (*end != '\0') {
+    fail(parser, "%s is not a number", text);
+  }
+  return value;
+}
+
+static uint32_t count(parser_t *parser, size_t index) {
+  double value = number(parser, index);
+  if (value < 0 || value != floor(value) || value > UINT32_MAX) {
+    fail(parser, "%s is not a count", token(parser, index));
+  }
+  return value;
+}
+
+static vector_t point(parser_t *parser, size_t index) {
+  return (vector_t){number(parser, index), number(parser, index + 1)};
+}
+
+static void copy_name(parser_t *parser, char *name, size_t length,
+                      size_t index) {
+  char *text = token(parser, index);
+  if (strlen(text) >= length) {
+    fail(parser, "%s is longer than %zu characters", text, length - 1);
+  }
+  strcpy(name, text);
+}
+
+static level_entry_t *current_level(parser_t *parser) {
+  if (parser->level == NULL) {
+    fail(parser, "%s outside a level", parser->tokens[0]);
+  }
+  return parser->level;
+}
+
+static level_kind_t *current_kind(parser_t *parser) {
+  if (parser->kind == NULL) {
+    fail(parser, "%s outside a kind", parser->tokens[0]);
+  }
+  return parser->kind;
+}
+
+// finds a kind of the current level, returning its level-relative index
+static uint32_t find_kind(parser_t *parser, size_t index) {
+  level_entry_t *level = current_level(parser);
+  char *name = token(parser, index);
+  for (size_t i = 0; i < level->num_kinds; i++) {
+    level_kind_t *kind = table_get(&parser->tables->kinds,
+                                   level->first_kind + i);
+    if (!strcmp(kind->name, name)) {
+      return i;
+    }
+  }
+  fail(parser, "no kind %s in level %s", name, level->name);
+  return 0;
+}
+
+static level_point_set_t *point_set_at(parser_t *parser, size_t index) {
+  return table_get(&parser->tables->point_sets,
+                   current_level(parser)->first_point_set + index);
+}
+
+static uint32_t find_point_set(parser_t *parser, size_t index) {
+  level_entry_t *level = current_level(parser);
+  char *name = token(parser, index);
+  for (size_t i = 0; i < level->num_point_sets; i++) {
+    if (!strcmp(point_set_at(parser, i)->name, name)) {
+      return i;
+    }
+  }
+  fail(parser, "no points %s in level %s", name, level->name);
+  return 0;
+}
+
+static void parse_level(parser_t *parser) {
+  tables_t *tables = parser->tables;
+  size_t index = table_add(&tables->levels);
+  level_entry_t *level = table_get(&tables->levels, index);
+  copy_name(parser, level->name, LEVEL_NAME_LENGTH, 1);
+  for (size_t i = 0; i < index; i++) {
+    level_entry_t *other = table_get(&tables->levels, i);
+    if (!strcmp(other->name, level->name)) {
+      fail(parser, "level %s is described twice", level->name);
+    }
+  }
+  level->first_kind = tables->kinds.count;
+  level->first_point_set = tables->point_sets.count;
+  level->first_placement = tables->placements.count;
+  level->first_collision = tables->collisions.count;
+  level->first_spawn = tables->spawns.count;
+  parser->level = level;
+  parser->kind = NULL;
+}
+
+static void parse_world(parser_t *parser) {
+  level_entry_t *level = current_level(parser);
+  level->world_width = number(parser, 1);
+  level->chunk_width = DEFAULT_CHUNK_WIDTH;
+  if (is_token(parser, 2, "chunk")) {
+    level->chunk_width = number(parser, 3);
+  }
+  if (!(level->world_width > 0) || !(level->chunk_width > 0) ||
+      isinf(level->world_width) || isinf(level->chunk_width)) {
+    fail(parser, "world and chunk widths must be positive");
+  }
+}
+
+static void parse_kind(parser_t *parser) {
+  level_entry_t *level = current_level(parser);
+  level_kind_t *kind = table_get(&parser->tables->kinds,
+                                 table_add(&parser->tables->kinds));
+  copy_name(parser, kind->name, LEVEL_NAME_LENGTH, 1);
+  kind->layer = LAYER_DYNAMIC;
+  kind->depth = DEFAULT_DEPTH;
+  kind->mass = 1;
+  level->num_kinds++;
+  parser->kind = kind;
+}
+
+// bakes the shape around its centroid, so placing a body is one copy of its
+// vertices
+static void parse_shape(parser_t *parser, level_kind_t *kind) {
+  list_t *shape = NULL;
+  if (is_token(parser, 1, "rectangle")) {
+    shape = make_rectangle(number(parser, 3), number(parser, 2), 0, 0);
+  } else if (is_token(parser, 1, "star")) {
+    shape = make_star(number(parser, 2), number(parser, 3), 0, 0);
+  } else if (is_token(parser, 1, "pacman")) {
+    shape = make_pacman(number(parser, 2), 0, 0);
+  } else {
+    fail(parser, "unknown shape %s", token(parser, 1));
+  }
+  vector_t centroid = polygon_centroid(shape);
+  table_t *vertices = &parser->tables->vertices;
+  kind->first_vertex = vertices->count;
+  kind->num_vertices = list_size(shape);
+  for (size_t i = 0; i < list_size(shape); i++) {
+    vector_t *vertex = table_get(vertices, table_add(vertices));
+    *vertex = vec_subtract(*(vector_t *)list_get(shape, i), centroid);
+  }
+  list_free(shape);
+}
+
+// the lines between a kind and the next keyword describe that kind
+static bool parse_property(parser_t *parser) {
+  char *keyword = parser->tokens[0];
+  if (!strcmp(keyword, "shape")) {
+    parse_shape(parser, current_kind(parser));
+  } else if (!strcmp(keyword, "mass")) {
+    current_kind(parser)->mass = number(parser, 1);
+  } else if (!strcmp(keyword, "color")) {
+    level_kind_t *kind = current_kind(parser);
+    for (size_t i = 0; i < 3; i++) {
+      kind->color[i] = number(parser, i + 1) / COLOR_SCALE;
+    }
+  } else if (!strcmp(keyword, "score")) {
+    current_kind(parser)->score = number(parser, 1);
+  } else if (!strcmp(keyword, "elasticity")) {
+    current_kind(parser)->elasticity = number(parser, 1);
+  } else if (!strcmp(keyword, "velocity")) {
+    current_kind(parser)->velocity = point(parser, 1);
+  } else if (!strcmp(keyword, "rotation")) {
+    current_kind(parser)->rotation = number(parser, 1);
+  } else if (!strcmp(keyword, "sprite")) {
+    level_kind_t *kind = current_kind(parser);
+    copy_name(parser, kind->sprite, LEVEL_PATH_LENGTH, 1);
+    kind->sprite_size = point(parser, 2);
+  } else if (!strcmp(keyword, "sprite_right")) {
+    level_kind_t *kind = current_kind(parser);
+    copy_name(parser, kind->sprite_right, LEVEL_PATH_LENGTH, 1);
+  } else if (!strcmp(keyword, "layer")) {
+    level_kind_t *kind = current_kind(parser);
+    if (is_token(parser, 1, "static")) {
+      kind->layer = LAYER_STATIC;
+    } else if (is_token(parser, 1, "dynamic")) {
+      kind->layer = LAYER_DYNAMIC;
+    } else {
+      fail(parser, "unknown layer %s", token(parser, 1));
+    }
+  } else if (!strcmp(keyword, "depth")) {
+    current_kind(parser)->depth = count(parser, 1);
+  } else if (!strcmp(keyword, "streamed")) {
+    current_kind(parser)->streamed = true;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static void parse_avoid(parser_t *parser, level_point_set_t *set,
+                        size_t index) {
+  while (index < parser->num_tokens) {
+    expect(parser, index, "avoid");
+    if (set->num_avoid == LEVEL_MAX_AVOID) {
+      fail(parser, "at most %d avoided boxes", LEVEL_MAX_AVOID);
+    }
+    set->avoid_min[set->num_avoid] = point(parser, index + 1);
+    set->avoid_max[set->num_avoid] = point(parser, index + 3);
+    set->num_avoid++;
+    index += 5;
+  }
+}
+
+static void parse_points(parser_t *parser) {
+  level_entry_t *level = current_level(parser);
+  level_point_set_t *set = table_get(&parser->tables->point_sets,
+                                     table_add(&parser->tables->point_sets));
+  copy_name(parser, set->name, LEVEL_NAME_LENGTH, 1);
+  level->num_point_sets++;
+  char *op = token(parser, 2);
+  if (!strcmp(op, "at")) {
+    set->op = POINTS_AT;
+    set->origin = point(parser, 3);
+    set->count = parser->num_tokens > 5 ? count(parser, 5) : 1;
+  } else if (!strcmp(op, "line")) {
+    set->op = POINTS_LINE;
+    set->count = count(parser, 3);
+    expect(parser, 4, "from");
+    set->origin = point(parser, 5);
+    expect(parser, 7, "step");
+    set->extent = point(parser, 8);
+  } else if (!strcmp(op, "trajectory")) {
+    set->op = POINTS_TRAJECTORY;
+    set->count = count(parser, 3);
+    expect(parser, 4, "from");
+    set->origin = point(parser, 5);
+    expect(parser, 7, "velocity");
+    set->extent = point(parser, 8);
+    expect(parser, 10, "gravity");
+    set->gravity = number(parser, 11);
+    expect(parser, 12, "every");
+    set->interval = number(parser, 13);
+  } else if (!strcmp(op, "random") || !strcmp(op, "rows")) {
+    set->op = !strcmp(op, "random") ? POINTS_RANDOM : POINTS_ROWS;
+    set->count = count(parser, 3);
+    expect(parser, 4, "in");
+    set->origin = point(parser, 5);
+    set->extent = point(parser, 7);
+    if (set->op == POINTS_RANDOM) {
+      parse_avoid(parser, set, 9);
+    } else {
+      expect(parser, 9, "rows");
+      set->rows = count(parser, 10);
+      expect(parser, 11, "columns");
+      set->columns = count(parser, 12);
+      if (set->rows == 0 || set->columns == 0) {
+        fail(parser, "rows and columns cannot be 0");
+      }
+      if (set->rows > LEVEL_MAX_ROWS) {
+        fail(parser, "more than %d rows", LEVEL_MAX_ROWS);
+      }
+    }
+  } else if (!strcmp(op, "offset")) {
+    set->op = POINTS_OFFSET;
+    // the set being described already counts as one of the level's sets
+    level->num_point_sets--;
+    set->source = find_point_set(parser, 3);
+    level->num_point_sets++;
+    set->count = point_set_at(parser, set->source)->count;
+    expect(parser, 4, "by");
+    set->origin = point(parser, 5);
+  } else {
+    fail(parser, "unknown points %s", op);
+  }
+  set->first_point = level->num_points;
+  level->num_points += set->count;
+}
+
+// a list such as 0,3,6-9 of indices into the set
+static void parse_indices(parser_t *parser, level_placement_t *placement,
+                          char *list, uint32_t num_points) {
+  table_t *indices = &parser->tables->indices;
+  placement->first_index = indices->count;
+  for (char *range = strtok(list, ","); range != NULL;
+       range = strtok(NULL, ",")) {
+    char *end;
+    unsigned long first = strtoul(range, &end, 10);
+    unsigned long last = first;
+    if (*end == '-') {
+      last = strtoul(end + 1, &end, 10);
+    }
+    if (*end != '\0' || last < first || last >= num_points) {
+      fail(parser, "bad indices %s for %u points", range, num_points);
+    }
+    for (unsigned long i = first; i <= last; i++) {
+      *(uint32_t *)table_get(indices, table_add(indices)) = i;
+      placement->num_indices++;
+    }
+  }
+}
+
+static void parse_place(parser_t *parser) {
+  level_entry_t *level = current_level(parser);
+  level_placement_t *placement =
+      table_get(&parser->tables->placements,
+                table_add(&parser->tables->placements));
+  level->num_placements++;
+  placement->kind = find_kind(parser, 1);
+  placement->point_set = find_point_set(parser, 2);
+  uint32_t num_points = point_set_at(parser, placement->point_set)->count;
+  size_t index = 3;
+  if (index < parser->num_tokens && !is_token(parser, index, "score")) {
+    parse_indices(parser, placement, token(parser, index), num_points);
+    index++;
+  }
+  if (is_token(parser, index, "score")) {
+    placement->has_score = true;
+    placement->score = number(parser, index + 1);
+  }
+  level->num_bodies +=
+      placement->num_indices > 0 ? placement->num_indices : num_points;
+}
+
+static void parse_collide(parser_t *parser) {
+  level_entry_t *level = current_level(parser);
+  level_collision_t *collision =
+      table_get(&parser->tables->collisions,
+                table_add(&parser->tables->collisions));
+  level->num_collisions++;
+  collision->kind1 = find_kind(parser, 1);
+  collision->kind2 = find_kind(parser, 2);
+  char *type = token(parser, 3);
+  if (!strcmp(type, "destroy")) {
+    collision->type = COLLIDE_DESTROY_SECOND;
+  } else if (!strcmp(type, "destroy_both")) {
+    collision->type = COLLIDE_DESTROY_BOTH;
+  } else if (!strcmp(type, "bounce")) {
+    collision->type = COLLIDE_BOUNCE;
+    collision->elasticity = number(parser, 4);
+  } else if (!strcmp(type, "rotate")) {
+    collision->type = COLLIDE_ROTATE;
+  } else {
+    fail(parser, "unknown collision %s", type);
+  }
+}
+
+static void parse_spawn(parser_t *parser) {
+  level_entry_t *level = current_level(parser);
+  level_spawn_t *spawn = table_get(&parser->tables->spawns,
+                                   table_add(&parser->tables->spawns));
+  level->num_spawns++;
+  spawn->kind = find_kind(parser, 1);
+  spawn->point_set = find_point_set(parser, 2);
+  if (is_token(parser, 3, "every")) {
+    spawn->interval = count(parser, 4);
+  }
+}
+
+// reads one line, joining the lines that end in a backslash to the next
+static bool read_line(parser_t *parser, FILE *file, char *line) {
+  size_t length = 0;
+  while (fgets(line + length, MAX_LINE - length, file) != NULL) {
+    parser->line++;
+    length += strcspn(line + length, "\r\n");
+    line[length] = '\0';
+    if (length == 0 || line[length - 1] != '\\') {
+      return true;
+    }
+    line[length - 1] = ' ';
+    if (length == MAX_LINE - 1) {
+      fail(parser, "line too long");
+    }
+  }
+  return length > 0;
+}
+
+// returns whether the whole file parsed, reporting the first error if not
+static bool parse_file(const char *path, tables_t *tables) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    fprintf(stderr, "levels: cannot read %s\n", path);
+    return false;
+  }
+  parser_t parser = {.path = path, .tables = tables};
+  if (setjmp(parser.failed) != 0) {
+    fclose(file);
+    return false;
+  }
+  char line[MAX_LINE];
+  while (read_line(&parser, file, line)) {
+    tokenize(&parser, line);
+    if (parser.num_tokens == 0) {
+      continue;
+    }
+    char *keyword = parser.tokens[0];
+    if (!strcmp(keyword, "level")) {
+      parse_level(&parser);
+    } else if (!strcmp(keyword, "kind")) {
+      parse_kind(&parser);
+    } else if (parse_property(&parser)) {
+      continue;
+    } else {
+      parser.kind = NULL;
+      if (!strcmp(keyword, "world")) {
+        parse_world(&parser);
+      } else if (!strcmp(keyword, "points")) {
+        parse_points(&parser);
+      } else if (!strcmp(keyword, "place")) {
+        parse_place(&parser);
+      } else if (!strcmp(keyword, "collide")) {
+        parse_collide(&parser);
+      } else if (!strcmp(keyword, "spawn")) {
+        parse_spawn(&parser);
+      } else {
+        fail(&parser, "unknown keyword %s", keyword);
+      }
+    }
+  }
+  fclose(file);
+  return true;
+}
+
+// copies a table to the end of the pack, returning where the next one goes
+static uint8_t *copy_table(uint8_t *to, table_t *table) {
+  size_t bytes = table->size * table->count;
+  if (bytes > 0) {
+    memcpy(to, table->data, bytes);
+  }
+  return to + bytes;
+}
+
+uint8_t *level_compile(const char *const *paths, size_t num_paths,
+                       size_t *size) {
+  tables_t tables;
+  table_init(&tables.levels, sizeof(level_entry_t));
+  table_init(&tables.kinds, sizeof(level_kind_t));
+  table_init(&tables.vertices, sizeof(vector_t));
+  table_init(&tables.point_sets, sizeof(level_point_set_t));
+  table_init(&tables.placements, sizeof(level_placement_t));
+  table_init(&tables.indices, sizeof(uint32_t));
+  table_init(&tables.collisions, sizeof(level_collision_t));
+  table_init(&tables.spawns, sizeof(level_spawn_t));
+  table_t *order[] = {&tables.levels,     &tables.kinds,
+                      &tables.vertices,   &tables.point_sets,
+                      &tables.placements, &tables.indices,
+                      &tables.collisions, &tables.spawns};
+  size_t num_tables = sizeof(order) / sizeof(order[0]);
+  for (size_t i = 0; i < num_paths; i++) {
+    if (!parse_file(paths[i], &tables)) {
+      for (size_t j = 0; j < num_tables; j++) {
+        free(order[j]->data);
+      }
+      return NULL;
+    }
+  }
+  // keeps the tables after the indices 8-byte aligned
+  if (tables.indices.count % 2 != 0) {
+    table_add(&tables.indices);
+  }
+
+  level_pack_header_t header = {.version = LEVEL_PACK_VERSION,
+                                .num_levels = tables.levels.count,
+                                .num_kinds = tables.kinds.count,
+                                .num_vertices = tables.vertices.count,
+                                .num_point_sets = tables.point_sets.count,
+                                .num_placements = tables.placements.count,
+                                .num_indices = tables.indices.count,
+                                .num_collisions = tables.collisions.count,
+                                .num_spawns = tables.spawns.count};
+  memcpy(header.magic, LEVEL_PACK_MAGIC, sizeof(header.magic));
+  *size = sizeof(header);
+  for (size_t i = 0; i < num_tables; i++) {
+    *size += order[i]->size * order[i]->count;
+  }
+  uint8_t *pack = malloc(*size);
+  assert(pack != NULL);
+  memcpy(pack, &header, sizeof(header));
+  uint8_t *next = pack + sizeof(header);
+  for (size_t i = 0; i < num_tables; i++) {
+    next = copy_table(next, order[i]);
+    free(order[i]->data);
+  }
+  return pack;
+}
@@ -0,0 +1,23 @@
+#ifndef __LEVEL_COMPILER_H__
+#define __LEVEL_COMPILER_H__
+
+#include "level_pack.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Compiles .level descriptions into a level pack, laid out exactly as the
+ * pack_levels tool writes it. The first description that cannot be read or
+ * does not parse is reported on stderr with its file and line, and nothing
+ * is compiled.
+ *
+ * @param paths the descriptions, in the order their levels are packed
+ * @param num_paths the number of descriptions
+ * @param size set to the length of the pack in bytes
+ * @return the pack, allocated with malloc(), to pass to
+ *   level_pack_from_memory() or write out; NULL if a description failed
+ */
+uint8_t *level_compile(const char *const *paths, size_t num_paths,
+                       size_t *size);
+
+#endif // #ifndef __LEVEL_COMPILER_H__
@@ -0,0 +1,422 @@
+#include "level_pack.h"
+#include "query.h"
+#include "snapshot.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef __EMSCRIPTEN__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct level_pack {
+  uint8_t *data;
+  size_t size;
+  // whether data was compiled in memory rather than read from a file
+  bool compiled;
+  level_pack_header_t *header;
+  level_entry_t *levels;
+  level_kind_t *kinds;
+  vector_t *vertices;
+  level_point_set_t *point_sets;
+  level_placement_t *placements;
+  uint32_t *indices;
+  level_collision_t *collisions;
+  level_spawn_t *spawns;
+};
+
+// reads the whole pack with one mapping, or one read in the browser
+static uint8_t *read_pack(const char *path, size_t *size) {
+#ifdef __EMSCRIPTEN__
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return NULL;
+  }
+  fseek(file, 0, SEEK_END);
+  *size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  uint8_t *data = malloc(*size);
+  assert(data != NULL);
+  size_t read = fread(data, 1, *size, file);
+  fclose(file);
+  if (read != *size) {
+    free(data);
+    return NULL;
+  }
+  return data;
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat info;
+  if (fstat(fd, &info) < 0) {
+    close(fd);
+    return NULL;
+  }
+  *size = info.st_size;
+  void *data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  return data == MAP_FAILED ? NULL : data;
+#endif
+}
+
+static void release_pack(uint8_t *data, size_t size) {
+#ifdef __EMSCRIPTEN__
+  free(data);
+#else
+  munmap(data, size);
+#endif
+}
+
+// hands out the tables in the order they are stored, failing once a table
+// would run past the end of the pack
+static void *take_table(level_pack_t *pack, size_t *offset, size_t count,
+                        size_t size) {
+  void *table = pack->data + *offset;
+  if (count > (pack->size - *offset) / size) {
+    return NULL;
+  }
+  *offset += count * size;
+  return table;
+}
+
+// names and paths are used as C strings, so each must end inside its field
+static bool terminated(const char *string, size_t length) {
+  return memchr(string, '\0', length) != NULL;
+}
+
+static bool valid_kind(level_pack_header_t *header, level_kind_t *kind) {
+  return terminated(kind->name, LEVEL_NAME_LENGTH) &&
+         terminated(kind->sprite, LEVEL_PATH_LENGTH) &&
+         terminated(kind->sprite_right, LEVEL_PATH_LENGTH) &&
+         kind->layer < NUM_LAYERS &&
+         kind->first_vertex + (size_t)kind->num_vertices <=
+             header->num_vertices;
+}
+
+// a set fills its own positions, and an offset set reads an earlier one
+static bool valid_point_set(level_entry_t *level, level_point_set_t *sets,
+                            size_t index) {
+  level_point_set_t *set = &sets[index];
+  if (set->first_point + (size_t)set->count > level->num_points) {
+    return false;
+  }
+  switch (set->op) {
+  case POINTS_ROWS:
+    return set->rows > 0 && set->rows <= LEVEL_MAX_ROWS && set->columns > 0;
+  case POINTS_OFFSET:
+    return set->source < index;
+  case POINTS_AT:
+  case POINTS_LINE:
+  case POINTS_TRAJECTORY:
+  case POINTS_RANDOM:
+    return true;
+  }
+  return false;
+}
+
+static bool valid_placement(level_pack_t *pack, level_entry_t *level,
+                            level_placement_t *placement) {
+  if (placement->kind >= level->num_kinds ||
+      placement->point_set >= level->num_point_sets ||
+      placement->first_index + (size_t)placement->num_indices >
+          pack->header->num_indices) {
+    return false;
+  }
+  level_point_set_t *set =
+      &pack->point_sets[level->first_point_set + placement->point_set];
+  uint32_t *indices = &pack->indices[placement->first_index];
+  for (size_t i = 0; i < placement->num_indices; i++) {
+    if (indices[i] >= set->count) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// every range a level names has to lie inside its table, and every index in
+// its rows inside the level, so that nothing read through the level can
+// leave the pack
+static bool valid_level(level_pack_t *pack, level_entry_t *level) {
+  level_pack_header_t *header = pack->header;
+  if (!terminated(level->name, LEVEL_NAME_LENGTH) ||
+      level->first_kind + (size_t)level->num_kinds > header->num_kinds ||
+      level->first_point_set + (size_t)level->num_point_sets >
+          header->num_point_sets ||
+      level->first_placement + (size_t)level->num_placements >
+          header->num_placements ||
+      level->first_collision + (size_t)level->num_collisions >
+          header->num_collisions ||
+      level->first_spawn + (size_t)level->num_spawns > header->num_spawns ||
+      (level->world_width != 0 && !(level->chunk_width > 0))) {
+    return false;
+  }
+  level_kind_t *kinds = level_pack_kinds(pack, level);
+  for (size_t i = 0; i < level->num_kinds; i++) {
+    if (!valid_kind(header, &kinds[i])) {
+      return false;
+    }
+  }
+  level_point_set_t *sets = level_pack_point_sets(pack, level);
+  for (size_t i = 0; i < level->num_point_sets; i++) {
+    if (!valid_point_set(level, sets, i)) {
+      return false;
+    }
+  }
+  level_placement_t *placements = level_pack_placements(pack, level);
+  for (size_t i = 0; i < level->num_placements; i++) {
+    if (!valid_placement(pack, level, &placements[i])) {
+      return false;
+    }
+  }
+  level_collision_t *collisions = level_pack_collisions(pack, level);
+  for (size_t i = 0; i < level->num_collisions; i++) {
+    if (collisions[i].kind1 >= level->num_kinds ||
+        collisions[i].kind2 >= level->num_kinds ||
+        collisions[i].type > COLLIDE_ROTATE) {
+      return false;
+    }
+  }
+  level_spawn_t *spawns = level_pack_spawns(pack, level);
+  for (size_t i = 0; i < level->num_spawns; i++) {
+    if (spawns[i].kind >= level->num_kinds ||
+        spawns[i].point_set >= level->num_point_sets) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void release(uint8_t *data, size_t size, bool compiled) {
+  if (compiled) {
+    free(data);
+  } else {
+    release_pack(data, size);
+  }
+}
+
+// checks the header and every table of the pack before handing it out
+static level_pack_t *load_pack(uint8_t *data, size_t size, bool compiled) {
+  level_pack_header_t *header = (level_pack_header_t *)data;
+  if (size < sizeof(level_pack_header_t) ||
+      memcmp(header->magic, LEVEL_PACK_MAGIC, sizeof(header->magic)) ||
+      header->version != LEVEL_PACK_VERSION) {
+    release(data, size, compiled);
+    return NULL;
+  }
+  level_pack_t *pack = malloc(sizeof(level_pack_t));
+  assert(pack != NULL);
+  *pack = (level_pack_t){
+      .data = data, .size = size, .compiled = compiled, .header = header};
+  size_t offset = sizeof(level_pack_header_t);
+  pack->levels = take_table(pack, &offset, header->num_levels,
+                            sizeof(level_entry_t));
+  pack->kinds =
+      take_table(pack, &offset, header->num_kinds, sizeof(level_kind_t));
+  pack->vertices =
+      take_table(pack, &offset, header->num_vertices, sizeof(vector_t));
+  pack->point_sets = take_table(pack, &offset, header->num_point_sets,
+                                sizeof(level_point_set_t));
+  pack->placements = take_table(pack, &offset, header->num_placements,
+                                sizeof(level_placement_t));
+  pack->indices =
+      take_table(pack, &offset, header->num_indices, sizeof(uint32_t));
+  pack->collisions = take_table(pack, &offset, header->num_collisions,
+                                sizeof(level_collision_t));
+  pack->spawns =
+      take_table(pack, &offset, header->num_spawns, sizeof(level_spawn_t));
+  bool valid = pack->levels != NULL && pack->kinds != NULL &&
+               pack->vertices != NULL && pack->point_sets != NULL &&
+               pack->placements != NULL && pack->indices != NULL &&
+               pack->collisions != NULL && pack->spawns != NULL;
+  for (size_t i = 0; valid && i < header->num_levels; i++) {
+    valid = valid_level(pack, &pack->levels[i]);
+  }
+  if (!valid) {
+    level_pack_close(pack);
+    return NULL;
+  }
+  return pack;
+}
+
+level_pack_t *level_pack_open(const char *path) {
+  size_t size = 0;
+  uint8_t *data = read_pack(path, &size);
+  if (data == NULL) {
+    return NULL;
+  }
+  return load_pack(data, size, false);
+}
+
+level_pack_t *level_pack_from_memory(uint8_t *data, size_t size) {
+  return load_pack(data, size, true);
+}
+
+void level_pack_close(level_pack_t *pack) {
+  release(pack->data, pack->size, pack->compiled);
+  free(pack);
+}
+
+level_entry_t *level_pack_find(level_pack_t *pack, const char *name) {
+  for (size_t i = 0; i < pack->header->num_levels; i++) {
+    if (!strncmp(pack->levels[i].name, name, LEVEL_NAME_LENGTH)) {
+      return &pack->levels[i];
+    }
+  }
+  return NULL;
+}
+
+size_t level_pack_max_points(level_pack_t *pack) {
+  size_t max_points = 0;
+  for (size_t i = 0; i < pack->header->num_levels; i++) {
+    if (pack->levels[i].num_points > max_points) {
+      max_points = pack->levels[i].num_points;
+    }
+  }
+  return max_points;
+}
+
+level_kind_t *level_pack_kinds(level_pack_t *pack, level_entry_t *level) {
+  return &pack->kinds[level->first_kind];
+}
+
+level_point_set_t *level_pack_point_sets(level_pack_t *pack,
+                                         level_entry_t *level) {
+  return &pack->point_sets[level->first_point_set];
+}
+
+level_placement_t *level_pack_placements(level_pack_t *pack,
+                                         level_entry_t *level) {
+  return &pack->placements[level->first_placement];
+}
+
+level_collision_t *level_pack_collisions(level_pack_t *pack,
+                                         level_entry_t *level) {
+  return &pack->collisions[level->first_collision];
+}
+
+level_spawn_t *level_pack_spawns(level_pack_t *pack, level_entry_t *level) {
+  return &pack->spawns[level->first_spawn];
+}
+
+uint32_t *level_pack_indices(level_pack_t *pack,
+                             level_placement_t *placement) {
+  assert(placement->first_index + (size_t)placement->num_indices <=
+         pack->header->num_indices);
+  return &pack->indices[placement->first_index];
+}
+
+vector_t *level_pack_vertices(level_pack_t *pack, level_kind_t *kind) {
+  assert(kind->first_vertex + (size_t)kind->num_vertices <=
+         pack->header->num_vertices);
+  return &pack->vertices[kind->first_vertex];
+}
+
+level_kind_t *level_pack_find_kind(level_pack_t *pack, level_entry_t *level,
+                                   const char *name) {
+  level_kind_t *kinds = level_pack_kinds(pack, level);
+  for (size_t i = 0; i < level->num_kinds; i++) {
+    if (!strncmp(kinds[i].name, name, LEVEL_NAME_LENGTH)) {
+      return &kinds[i];
+    }
+  }
+  return NULL;
+}
+
+// a whole number from low up to but not including high
+static double random_between(double low, double high, level_random_t random,
+                             void *aux) {
+  int span = (int)(high - low);
+  return span > 0 ? low + random(aux) % span : low;
+}
+
+static bool avoided(level_point_set_t *set, vector_t point) {
+  for (size_t i = 0; i < set->num_avoid && i < LEVEL_MAX_AVOID; i++) {
+    if (point.x > set->avoid_min[i].x && point.x < set->avoid_max[i].x &&
+        point.y > set->avoid_min[i].y && point.y < set->avoid_max[i].y) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static vector_t random_point(level_point_set_t *set, level_random_t random,
+                             void *aux) {
+  vector_t point;
+  do {
+    point.x = random_between(set->origin.x, set->extent.x, random, aux);
+    point.y = random_between(set->origin.y, set->extent.y, random, aux);
+  } while (avoided(set, point));
+  return point;
+}
+
+// every row gets one height before any point is spread over the columns
+static void generate_rows(level_point_set_t *set, vector_t *points,
+                          level_random_t random, void *aux) {
+  if (set->rows == 0 || set->columns == 0) {
+    return;
+  }
+  double heights[LEVEL_MAX_ROWS];
+  double row_height = (int)((set->extent.y - set->origin.y) / set->rows);
+  double column_width = (int)((set->extent.x - set->origin.x) / set->columns);
+  for (size_t row = 0; row < set->rows; row++) {
+    double bottom = set->origin.y +
+                    (int)(row * (set->extent.y - set->origin.y) / set->rows);
+    heights[row] = random_between(bottom, bottom + row_height, random, aux);
+  }
+  size_t per_row = (set->count + set->rows - 1) / set->rows;
+  for (size_t i = 0; i < set->count; i++) {
+    double left = set->origin.x + (i % set->columns) * column_width;
+    points[i] = (vector_t){
+        random_between(left, left + column_width, random, aux),
+        heights[i / per_row]};
+  }
+}
+
+void level_pack_generate(level_pack_t *pack, level_entry_t *level,
+                         size_t point_set, vector_t *positions,
+                         level_random_t random, void *aux) {
+  assert(point_set < level->num_point_sets);
+  level_point_set_t *set = &level_pack_point_sets(pack, level)[point_set];
+  assert(set->first_point + (size_t)set->count <= level->num_points);
+  vector_t *points = &positions[set->first_point];
+  switch (set->op) {
+  case POINTS_AT:
+    for (size_t i = 0; i < set->count; i++) {
+      points[i] = set->origin;
+    }
+    break;
+  case POINTS_LINE:
+    for (size_t i = 0; i < set->count; i++) {
+      points[i] = vec_add(set->origin, vec_multiply(i + 1, set->extent));
+    }
+    break;
+  case POINTS_TRAJECTORY:
+    trajectory_sample(set->origin, set->extent, (vector_t){0, -set->gravity},
+                      set->interval, points, set->count);
+    break;
+  case POINTS_RANDOM:
+    for (size_t i = 0; i < set->count; i++) {
+      points[i] = random_point(set, random, aux);
+    }
+    break;
+  case POINTS_ROWS:
+    generate_rows(set, points, random, aux);
+    break;
+  case POINTS_OFFSET: {
+    assert(set->source < point_set);
+    level_point_set_t *source =
+        &level_pack_point_sets(pack, level)[set->source];
+    vector_t *from = &positions[source->first_point];
+    for (size_t i = 0; i < set->count && i < source->count; i++) {
+      points[i] = vec_add(from[i], set->origin);
+    }
+    break;
+  }
+  }
+}
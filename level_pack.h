@@ -0,0 +1,293 @@
+#ifndef __LEVEL_PACK_H__
+#define __LEVEL_PACK_H__
+
+#include "vector.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A level pack holds every screen and level of the game, compiled from the
+ * .level descriptions by the pack_levels tool, or by level_compile() when
+ * no pack was built, and laid out as
+ *   level_pack_header_t
+ *   level_entry_t[num_levels]
+ *   level_kind_t[num_kinds]
+ *   vector_t[num_vertices]
+ *   level_point_set_t[num_point_sets]
+ *   level_placement_t[num_placements]
+ *   uint32_t[num_indices]
+ *   level_collision_t[num_collisions]
+ *   level_spawn_t[num_spawns]
+ * Tables refer to each other by index, never by pointer, so the pack is used
+ * exactly as it was read. Indices stored in a level's entries are relative
+ * to that level's first row of the table. The index table is padded to an
+ * even length so that every table after it stays 8-byte aligned. All
+ * integers are little endian. Opening a pack checks every index and count
+ * in it, so a stale or damaged pack is refused rather than read past.
+ */
+#define LEVEL_PACK_MAGIC "HLVL"
+#define LEVEL_PACK_VERSION 3
+#define LEVEL_NAME_LENGTH 24
+#define LEVEL_PATH_LENGTH 64
+#define LEVEL_MAX_AVOID 2
+#define LEVEL_MAX_ROWS 64
+
+typedef struct level_pack_header {
+  char magic[4];
+  uint32_t version;
+  uint32_t num_levels;
+  uint32_t num_kinds;
+  uint32_t num_vertices;
+  uint32_t num_point_sets;
+  uint32_t num_placements;
+  uint32_t num_indices;
+  uint32_t num_collisions;
+  uint32_t num_spawns;
+} level_pack_header_t;
+
+/**
+ * One screen or level: ranges of the tables below.
+ * num_points is the total size of the level's point sets, so their positions
+ * fit one buffer; num_bodies is how many bodies the placements make.
+ * world_width is 0 for levels that fit the window; wider levels scroll and
+ * keep the bodies of streamed kinds in chunks of chunk_width.
+ */
+typedef struct level_entry {
+  char name[LEVEL_NAME_LENGTH];
+  uint32_t first_kind;
+  uint32_t num_kinds;
+  uint32_t first_point_set;
+  uint32_t num_point_sets;
+  uint32_t first_placement;
+  uint32_t num_placements;
+  uint32_t first_collision;
+  uint32_t num_collisions;
+  uint32_t first_spawn;
+  uint32_t num_spawns;
+  uint32_t num_points;
+  uint32_t num_bodies;
+  double world_width;
+  double chunk_width;
+} level_entry_t;
+
+/**
+ * Everything the bodies of one kind share. The name becomes the body info.
+ * The shape is stored around its centroid. sprite is empty for bodies drawn
+ * as polygons, and sprite_right, when set, is drawn instead while the body
+ * is right of the middle of the window. layer holds a layer_t and depth
+ * orders the kinds of one layer, lowest first. Bodies of streamed kinds
+ * leave the scene while they are far from the camera.
+ */
+typedef struct level_kind {
+  char name[LEVEL_NAME_LENGTH];
+  char sprite[LEVEL_PATH_LENGTH];
+  char sprite_right[LEVEL_PATH_LENGTH];
+  vector_t sprite_size;
+  uint32_t layer;
+  uint32_t first_vertex;
+  uint32_t num_vertices;
+  uint32_t streamed;
+  uint32_t depth;
+  uint32_t reserved;
+  double mass;
+  double color[3];
+  double score;
+  double elasticity;
+  vector_t velocity;
+  double rotation;
+} level_kind_t;
+
+/**
+ * How the positions of a point set are made.
+ * POINTS_AT repeats origin. POINTS_LINE steps by extent from origin, starting
+ * one step out. POINTS_TRAJECTORY samples a jump from origin at velocity
+ * extent every interval seconds. POINTS_RANDOM draws whole numbers in the box
+ * from origin to extent, drawing again inside an avoided box. POINTS_ROWS
+ * splits the box into rows, each at one random height, and spreads the points
+ * of a row over the columns at random. POINTS_OFFSET moves every point of an
+ * earlier set by origin.
+ */
+typedef enum {
+  POINTS_AT,
+  POINTS_LINE,
+  POINTS_TRAJECTORY,
+  POINTS_RANDOM,
+  POINTS_ROWS,
+  POINTS_OFFSET
+} points_op_t;
+
+typedef struct level_point_set {
+  char name[LEVEL_NAME_LENGTH];
+  uint32_t op;
+  uint32_t count;
+  // where the set starts in the level's positions
+  uint32_t first_point;
+  uint32_t source;
+  uint32_t rows;
+  uint32_t columns;
+  uint32_t num_avoid;
+  uint32_t reserved;
+  vector_t origin;
+  vector_t extent;
+  double gravity;
+  double interval;
+  vector_t avoid_min[LEVEL_MAX_AVOID];
+  vector_t avoid_max[LEVEL_MAX_AVOID];
+} level_point_set_t;
+
+/**
+ * Bodies of one kind at some points of a set: the indices listed in the
+ * index table, or all of them when num_indices is 0. has_score replaces the
+ * kind's score for these bodies.
+ */
+typedef struct level_placement {
+  uint32_t kind;
+  uint32_t point_set;
+  uint32_t first_index;
+  uint32_t num_indices;
+  uint32_t has_score;
+  uint32_t reserved;
+  double score;
+} level_placement_t;
+
+/**
+ * What happens when a body of kind1 touches a body of kind2.
+ */
+typedef enum {
+  COLLIDE_DESTROY_SECOND,
+  COLLIDE_DESTROY_BOTH,
+  COLLIDE_BOUNCE,
+  COLLIDE_ROTATE
+} collide_t;
+
+typedef struct level_collision {
+  uint32_t kind1;
+  uint32_t kind2;
+  uint32_t type;
+  uint32_t reserved;
+  double elasticity;
+} level_collision_t;
+
+/**
+ * Bodies of a kind that appear during the level, one per point of the set,
+ * every interval ticks or, when interval is 0, when the game asks.
+ */
+typedef struct level_spawn {
+  uint32_t kind;
+  uint32_t point_set;
+  uint32_t interval;
+  uint32_t reserved;
+} level_spawn_t;
+
+typedef struct level_pack level_pack_t;
+
+/**
+ * Draws a random non-negative number for POINTS_RANDOM and POINTS_ROWS.
+ */
+typedef int (*level_random_t)(void *aux);
+
+/**
+ * Opens a level pack with a single read, like asset_pack_open().
+ *
+ * @param path the path of the pack file
+ * @return the pack, or NULL if the file is missing or not a valid pack
+ */
+level_pack_t *level_pack_open(const char *path);
+
+/**
+ * Uses the bytes of a pack built in memory, e.g. by level_compile().
+ *
+ * @param data the pack, allocated with malloc(); the pack takes ownership
+ *   and frees it when closed, or at once if it is not a valid pack
+ * @param size the length of data in bytes
+ * @return the pack, or NULL if data is not a valid pack
+ */
+level_pack_t *level_pack_from_memory(uint8_t *data, size_t size);
+
+/**
+ * Unmaps or frees the pack. Nothing read from it stays valid.
+ *
+ * @param pack a pointer to a pack returned from level_pack_open() or
+ *   level_pack_from_memory()
+ */
+void level_pack_close(level_pack_t *pack);
+
+/**
+ * Finds a level by name.
+ *
+ * @param pack a pointer to a pack returned from level_pack_open()
+ * @param name the name the level was described under, e.g. "level1"
+ * @return the level, or NULL if the pack has no such level
+ */
+level_entry_t *level_pack_find(level_pack_t *pack, const char *name);
+
+/**
+ * Gets the most positions any level of the pack makes, so one buffer can be
+ * allocated up front for every level.
+ *
+ * @param pack a pointer to a pack returned from level_pack_open()
+ * @return the largest num_points of the pack's levels
+ */
+size_t level_pack_max_points(level_pack_t *pack);
+
+/**
+ * Gets the rows of a level's tables. Each returns the level's first row;
+ * indices stored in the level are relative to it.
+ *
+ * @param pack a pointer to a pack returned from level_pack_open()
+ * @param level a level of the pack
+ */
+level_kind_t *level_pack_kinds(level_pack_t *pack, level_entry_t *level);
+level_point_set_t *level_pack_point_sets(level_pack_t *pack,
+                                         level_entry_t *level);
+level_placement_t *level_pack_placements(level_pack_t *pack,
+                                         level_entry_t *level);
+level_collision_t *level_pack_collisions(level_pack_t *pack,
+                                         level_entry_t *level);
+level_spawn_t *level_pack_spawns(level_pack_t *pack, level_entry_t *level);
+
+/**
+ * Gets the indices of a placement.
+ *
+ * @param pack a pointer to a pack returned from level_pack_open()
+ * @param placement a placement of the pack
+ * @return placement->num_indices indices into its point set
+ */
+uint32_t *level_pack_indices(level_pack_t *pack, level_placement_t *placement);
+
+/**
+ * Gets the shape of a kind, around its centroid.
+ *
+ * @param pack a pointer to a pack returned from level_pack_open()
+ * @param kind a kind of the pack
+ * @return kind->num_vertices vertices
+ */
+vector_t *level_pack_vertices(level_pack_t *pack, level_kind_t *kind);
+
+/**
+ * Finds a kind of a level by name.
+ *
+ * @param pack a pointer to a pack returned from level_pack_open()
+ * @param level a level of the pack
+ * @param name the name of the kind
+ * @return the kind, or NULL if the level has no such kind
+ */
+level_kind_t *level_pack_find_kind(level_pack_t *pack, level_entry_t *level,
+                                   const char *name);
+
+/**
+ * Makes the positions of one point set of a level.
+ *
+ * @param pack a pointer to a pack returned from level_pack_open()
+ * @param level a level of the pack
+ * @param point_set the level-relative index of the set
+ * @param positions the level's level->num_points positions; the set writes
+ *   its own range and POINTS_OFFSET reads the range of its source
+ * @param random the generator for random sets
+ * @param aux the argument of random
+ */
+void level_pack_generate(level_pack_t *pack, level_entry_t *level,
+                         size_t point_set, vector_t *positions,
+                         level_random_t random, void *aux);
+
+#endif // #ifndef __LEVEL_PACK_H__
@@ -0,0 +1,155 @@
+#include "logger.h"
+#include <assert.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+#endif
+
+// must be a power of two so the indices can wrap with a mask
+static const size_t LOG_CAPACITY = 1024;
+static const size_t LOG_FLUSH_BATCH = 64;
+static const double LOG_FLUSH_INTERVAL_MS = 1000;
+static const size_t LOG_LINE_LENGTH = 256;
+static const double LOG_MS_PER_SECOND = 1000.0;
+static const double LOG_MS_PER_NANOSECOND = 1e-6;
+
+static const char *LEVEL_NAMES[] = {"debug", "info", "warn", "error"};
+static const char *CHANNEL_NAMES[NUM_LOG_CHANNELS] = {"game", "physics",
+                                                      "level"};
+
+typedef struct log_record {
+  const char *format;
+  double value;
+  double time_ms;
+  log_channel_t channel;
+  log_level_t level;
+} log_record_t;
+
+typedef struct log_channel_config {
+  log_level_t level;
+  double interval_ms;
+  double last_ms;
+  size_t dropped;
+} log_channel_config_t;
+
+struct logger {
+  log_record_t *records;
+  atomic_size_t head;
+  atomic_size_t tail;
+  log_channel_config_t channels[NUM_LOG_CHANNELS];
+  double last_flush_ms;
+};
+
+static double log_now_ms(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * LOG_MS_PER_SECOND + now.tv_nsec * LOG_MS_PER_NANOSECOND;
+}
+
+logger_t *logger_init(void) {
+  logger_t *logger = malloc(sizeof(logger_t));
+  assert(logger != NULL);
+  logger->records = malloc(LOG_CAPACITY * sizeof(log_record_t));
+  assert(logger->records != NULL);
+  atomic_init(&logger->head, 0);
+  atomic_init(&logger->tail, 0);
+  for (size_t i = 0; i < NUM_LOG_CHANNELS; i++) {
+    logger->channels[i] = (log_channel_config_t){
+        .level = LOG_DEBUG, .interval_ms = 0, .last_ms = -INFINITY};
+  }
+  logger->last_flush_ms = log_now_ms();
+  return logger;
+}
+
+void logger_free(logger_t *logger) {
+  logger_flush(logger);
+  free(logger->records);
+  free(logger);
+}
+
+void logger_set_level(logger_t *logger, log_channel_t channel,
+                      log_level_t level) {
+  logger->channels[channel].level = level;
+}
+
+void logger_set_rate_limit(logger_t *logger, log_channel_t channel,
+                           double interval_ms) {
+  logger->channels[channel].interval_ms = interval_ms;
+}
+
+void logger_write(logger_t *logger, log_channel_t channel, log_level_t level,
+                  const char *format, double value) {
+  log_channel_config_t *config = &logger->channels[channel];
+  if (level < config->level) {
+    config->dropped++;
+    return;
+  }
+  double now = log_now_ms();
+  if (now - config->last_ms < config->interval_ms) {
+    config->dropped++;
+    return;
+  }
+
+  size_t head = atomic_load_explicit(&logger->head, memory_order_relaxed);
+  size_t tail = atomic_load_explicit(&logger->tail, memory_order_acquire);
+  if (head - tail == LOG_CAPACITY) {
+    config->dropped++;
+    return;
+  }
+  config->last_ms = now;
+  logger->records[head & (LOG_CAPACITY - 1)] =
+      (log_record_t){.format = format,
+                     .value = value,
+                     .time_ms = now,
+                     .channel = channel,
+                     .level = level};
+  atomic_store_explicit(&logger->head, head + 1, memory_order_release);
+}
+
+void logger_maybe_flush(logger_t *logger) {
+  size_t head = atomic_load_explicit(&logger->head, memory_order_acquire);
+  size_t tail = atomic_load_explicit(&logger->tail, memory_order_relaxed);
+  if (head == tail) {
+    return;
+  }
+  if (head - tail >= LOG_FLUSH_BATCH ||
+      log_now_ms() - logger->last_flush_ms >= LOG_FLUSH_INTERVAL_MS) {
+    logger_flush(logger);
+  }
+}
+
+void logger_flush(logger_t *logger) {
+  size_t head = atomic_load_explicit(&logger->head, memory_order_acquire);
+  size_t tail = atomic_load_explicit(&logger->tail, memory_order_relaxed);
+  char line[LOG_LINE_LENGTH];
+  for (; tail != head; tail++) {
+    log_record_t *record = &logger->records[tail & (LOG_CAPACITY - 1)];
+    snprintf(line, LOG_LINE_LENGTH, record->format, record->value);
+#ifdef __EMSCRIPTEN__
+    int flags = EM_LOG_NO_PATHS;
+    if (record->level == LOG_WARN) {
+      flags |= EM_LOG_WARN;
+    } else if (record->level == LOG_ERROR) {
+      flags |= EM_LOG_ERROR;
+    }
+    emscripten_log(flags, "[%.0f %s %s] %s", record->time_ms,
+                   CHANNEL_NAMES[record->channel], LEVEL_NAMES[record->level],
+                   line);
+#else
+    // native builds, such as the headless tools, log to stderr
+    fprintf(stderr, "[%.0f %s %s] %s\n", record->time_ms,
+            CHANNEL_NAMES[record->channel], LEVEL_NAMES[record->level], line);
+#endif
+  }
+  atomic_store_explicit(&logger->tail, tail, memory_order_release);
+  logger->last_flush_ms = log_now_ms();
+}
+
+size_t logger_dropped(logger_t *logger, log_channel_t channel) {
+  return logger->channels[channel].dropped;
+}
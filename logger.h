@@ -0,0 +1,109 @@
+#ifndef __LOGGER_H__
+#define __LOGGER_H__
+
+#include <stddef.h>
+
+/**
+ * Channels that can be filtered and rate limited independently.
+ */
+typedef enum {
+  LOG_CHANNEL_GAME,
+  LOG_CHANNEL_PHYSICS,
+  LOG_CHANNEL_LEVEL,
+  NUM_LOG_CHANNELS
+} log_channel_t;
+
+typedef enum { LOG_DEBUG, LOG_INFO, LOG_WARN, LOG_ERROR } log_level_t;
+
+/**
+ * A single-producer single-consumer ring buffer of unformatted records.
+ * Writing stores the format string pointer and a value; formatting and
+ * printing only happen when the buffer is flushed.
+ */
+typedef struct logger logger_t;
+
+/**
+ * Allocates a logger where every channel accepts LOG_DEBUG and up,
+ * without a rate limit.
+ *
+ * @return the new logger
+ */
+logger_t *logger_init(void);
+
+/**
+ * Flushes the remaining records and releases the memory of a logger.
+ *
+ * @param logger a pointer to a logger returned from logger_init()
+ */
+void logger_free(logger_t *logger);
+
+/**
+ * Sets the lowest level a channel records.
+ *
+ * @param logger a pointer to a logger returned from logger_init()
+ * @param channel the channel to configure
+ * @param level records below this level are dropped
+ */
+void logger_set_level(logger_t *logger, log_channel_t channel,
+                      log_level_t level);
+
+/**
+ * Sets the shortest time between two records of a channel.
+ * Records arriving sooner are dropped and counted.
+ *
+ * @param logger a pointer to a logger returned from logger_init()
+ * @param channel the channel to configure
+ * @param interval_ms the minimum interval in milliseconds, 0 for no limit
+ */
+void logger_set_rate_limit(logger_t *logger, log_channel_t channel,
+                           double interval_ms);
+
+/**
+ * Appends a record to the ring buffer. Use the LOG macros instead, so that
+ * release builds do not evaluate the arguments.
+ *
+ * @param logger a pointer to a logger returned from logger_init()
+ * @param channel the channel of the record
+ * @param level the level of the record
+ * @param format a printf format with at most one double conversion; it must
+ *   outlive the logger, which a string literal does
+ * @param value the value for the conversion
+ */
+void logger_write(logger_t *logger, log_channel_t channel, log_level_t level,
+                  const char *format, double value);
+
+/**
+ * Formats and prints the buffered records, if enough have accumulated or
+ * enough time has passed since the last flush.
+ *
+ * @param logger a pointer to a logger returned from logger_init()
+ */
+void logger_maybe_flush(logger_t *logger);
+
+/**
+ * Formats and prints every buffered record.
+ *
+ * @param logger a pointer to a logger returned from logger_init()
+ */
+void logger_flush(logger_t *logger);
+
+/**
+ * Gets the number of records dropped by levels, rate limits or a full buffer.
+ *
+ * @param logger a pointer to a logger returned from logger_init()
+ * @param channel the channel to query
+ * @return the number of dropped records
+ */
+size_t logger_dropped(logger_t *logger, log_channel_t channel);
+
+#ifdef NDEBUG
+#define LOG_VALUE(logger, channel, level, format, value) ((void)0)
+#define LOG_EVENT(logger, channel, level, format) ((void)0)
+#else
+#define LOG_VALUE(logger, channel, level, format, value)                      \
+  logger_write(logger, channel, level, format, value)
+#define LOG_EVENT(logger, channel, level, format)                             \
+  logger_write(logger, channel, level, format, 0)
+#endif
+
+#endif // #ifndef __LOGGER_H__
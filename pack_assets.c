@@ -0,0 +1,142 @@
+// Build step that decodes the game's images into one asset pack.
+//
+//   pack_assets for_images/assets.pack for_images/*.png
+//
+// Every image is stored as RGBA32 under the path it was given on the command
+// line, run-length encoded when that is smaller. Run it from the directory
+// the game is served from so the packed paths match the ones in
+// body_sprite().
+#include "asset_pack.h"
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct packed_image {
+  uint8_t *data;
+  size_t size;
+} packed_image_t;
+
+// returns the runs, or NULL when they would not be smaller than the pixels
+static uint8_t *encode_rle(const uint32_t *pixels, size_t num_pixels,
+                           size_t *size) {
+  size_t raw_size = num_pixels * sizeof(uint32_t);
+  uint32_t *runs = malloc(raw_size);
+  size_t num_words = 0;
+  size_t i = 0;
+  while (i < num_pixels) {
+    uint32_t length = 1;
+    while (i + length < num_pixels && pixels[i + length] == pixels[i]) {
+      length++;
+    }
+    if ((num_words + 2) * sizeof(uint32_t) >= raw_size) {
+      free(runs);
+      return NULL;
+    }
+    runs[num_words++] = length;
+    runs[num_words++] = pixels[i];
+    i += length;
+  }
+  *size = num_words * sizeof(uint32_t);
+  return (uint8_t *)runs;
+}
+
+static bool pack_image(const char *path, pack_entry_t *entry,
+                       packed_image_t *image) {
+  SDL_Surface *loaded = IMG_Load(path);
+  if (loaded == NULL) {
+    fprintf(stderr, "pack_assets: cannot load %s: %s\n", path,
+            SDL_GetError());
+    return false;
+  }
+  SDL_Surface *surface =
+      SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0);
+  SDL_FreeSurface(loaded);
+  if (surface == NULL) {
+    fprintf(stderr, "pack_assets: cannot convert %s\n", path);
+    return false;
+  }
+
+  size_t row_size = (size_t)surface->w * PACK_BYTES_PER_PIXEL;
+  size_t num_pixels = (size_t)surface->w * surface->h;
+  uint32_t *pixels = malloc(num_pixels * sizeof(uint32_t));
+  for (int y = 0; y < surface->h; y++) {
+    memcpy((uint8_t *)pixels + y * row_size,
+           (uint8_t *)surface->pixels + y * surface->pitch, row_size);
+  }
+  entry->width = surface->w;
+  entry->height = surface->h;
+  SDL_FreeSurface(surface);
+
+  size_t rle_size = 0;
+  uint8_t *rle = encode_rle(pixels, num_pixels, &rle_size);
+  if (rle != NULL) {
+    free(pixels);
+    entry->encoding = PACK_RLE;
+    *image = (packed_image_t){.data = rle, .size = rle_size};
+  } else {
+    entry->encoding = PACK_RAW;
+    *image = (packed_image_t){.data = (uint8_t *)pixels,
+                              .size = num_pixels * sizeof(uint32_t)};
+  }
+  entry->size = image->size;
+  return true;
+}
+
+static size_t align(size_t offset) {
+  return (offset + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT * PACK_ALIGNMENT;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s <pack> <image>...\n", argv[0]);
+    return 1;
+  }
+  size_t num_images = argc - 2;
+  pack_entry_t *entries = calloc(num_images, sizeof(pack_entry_t));
+  packed_image_t *images = calloc(num_images, sizeof(packed_image_t));
+  SDL_Init(SDL_INIT_VIDEO);
+
+  size_t offset =
+      align(sizeof(pack_header_t) + num_images * sizeof(pack_entry_t));
+  for (size_t i = 0; i < num_images; i++) {
+    const char *path = argv[i + 2];
+    if (strlen(path) >= PACK_PATH_LENGTH) {
+      fprintf(stderr, "pack_assets: path too long: %s\n", path);
+      return 1;
+    }
+    strncpy(entries[i].path, path, PACK_PATH_LENGTH - 1);
+    if (!pack_image(path, &entries[i], &images[i])) {
+      return 1;
+    }
+    entries[i].offset = offset;
+    offset = align(offset + images[i].size);
+  }
+
+  FILE *file = fopen(argv[1], "wb");
+  if (file == NULL) {
+    fprintf(stderr, "pack_assets: cannot write %s\n", argv[1]);
+    return 1;
+  }
+  pack_header_t header = {.version = PACK_VERSION, .num_entries = num_images};
+  memcpy(header.magic, PACK_MAGIC, sizeof(header.magic));
+  fwrite(&header, sizeof(header), 1, file);
+  fwrite(entries, sizeof(pack_entry_t), num_images, file);
+  static const uint8_t PADDING[PACK_ALIGNMENT] = {0};
+  for (size_t i = 0; i < num_images; i++) {
+    long position = ftell(file);
+    fwrite(PADDING, 1, entries[i].offset - position, file);
+    fwrite(images[i].data, 1, images[i].size, file);
+    printf("%s: %ux%u, %zu bytes%s\n", entries[i].path, entries[i].width,
+           entries[i].height, images[i].size,
+           entries[i].encoding == PACK_RLE ? " (rle)" : "");
+    free(images[i].data);
+  }
+  fclose(file);
+  free(entries);
+  free(images);
+  SDL_Quit();
+  return 0;
+}
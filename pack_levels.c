@@ -0,0 +1,45 @@
+// Build step that compiles the level descriptions into one level pack.
+//
+//   pack_levels for_levels/levels.pack for_levels/*.level
+//
+// The grammar of the descriptions is given in level_compiler.c. The game
+// compiles them itself at startup when no pack was built.
+#include "level_compiler.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s <pack> <level>...\n", argv[0]);
+    return 1;
+  }
+  size_t size = 0;
+  uint8_t *pack = level_compile((const char *const *)&argv[2], argc - 2, &size);
+  if (pack == NULL) {
+    return 1;
+  }
+
+  FILE *file = fopen(argv[1], "wb");
+  if (file == NULL) {
+    fprintf(stderr, "pack_levels: cannot write %s\n", argv[1]);
+    free(pack);
+    return 1;
+  }
+  fwrite(pack, 1, size, file);
+  fclose(file);
+  level_pack_header_t *header = (level_pack_header_t *)pack;
+  level_entry_t *levels = (level_entry_t *)(pack + sizeof(*header));
+  for (size_t i = 0; i < header->num_levels; i++) {
+    level_entry_t *level = &levels[i];
+    printf("%s: %u kinds, %u points, %u bodies", level->name,
+           level->num_kinds, level->num_points, level->num_bodies);
+    if (level->world_width > 0) {
+      printf(", %.0f wide in %.0f chunks", level->world_width,
+             ceil(level->world_width / level->chunk_width));
+    }
+    printf("\n");
+  }
+  free(pack);
+  return 0;
+}
@@ -0,0 +1,108 @@
+#include "perf_counters.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define HAVE_PERF_EVENTS
+#endif
+
+static const char *COUNTER_NAMES[NUM_COUNTERS] = {
+    "cycles", "instructions", "cache_misses", "branch_misses"};
+
+struct perf_counters {
+  int fds[NUM_COUNTERS];
+  // where each open counter is in a group read, in the order they joined
+  size_t slots[NUM_COUNTERS];
+  size_t num_open;
+  int leader;
+};
+
+#ifdef HAVE_PERF_EVENTS
+static const uint64_t COUNTER_CONFIGS[NUM_COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+// the leader starts disabled and enables the whole group once it is built
+static int open_counter(counter_t counter, int leader) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = COUNTER_CONFIGS[counter];
+  attr.disabled = leader < 0;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+  return syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+}
+#endif
+
+perf_counters_t *perf_counters_open(void) {
+#ifdef HAVE_PERF_EVENTS
+  perf_counters_t *counters = malloc(sizeof(perf_counters_t));
+  assert(counters != NULL);
+  counters->num_open = 0;
+  counters->leader = -1;
+  for (size_t i = 0; i < NUM_COUNTERS; i++) {
+    int fd = open_counter(i, counters->leader);
+    counters->fds[i] = fd;
+    if (fd < 0) {
+      continue;
+    }
+    if (counters->leader < 0) {
+      counters->leader = fd;
+    }
+    counters->slots[i] = counters->num_open++;
+  }
+  if (counters->leader < 0) {
+    free(counters);
+    return NULL;
+  }
+  ioctl(counters->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(counters->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  return counters;
+#else
+  return NULL;
+#endif
+}
+
+void perf_counters_close(perf_counters_t *counters) {
+#ifdef HAVE_PERF_EVENTS
+  // members go before the leader
+  for (size_t i = NUM_COUNTERS; i-- > 0;) {
+    if (counters->fds[i] >= 0) {
+      close(counters->fds[i]);
+    }
+  }
+#endif
+  free(counters);
+}
+
+void perf_counters_read(perf_counters_t *counters, uint64_t *values) {
+  memset(values, 0, NUM_COUNTERS * sizeof(uint64_t));
+#ifdef HAVE_PERF_EVENTS
+  // a group read is the number of counters followed by their values
+  uint64_t group[1 + NUM_COUNTERS];
+  ssize_t size = (1 + counters->num_open) * sizeof(uint64_t);
+  if (read(counters->leader, group, size) != size) {
+    return;
+  }
+  for (size_t i = 0; i < NUM_COUNTERS; i++) {
+    if (counters->fds[i] >= 0) {
+      values[i] = group[1 + counters->slots[i]];
+    }
+  }
+#endif
+}
+
+bool perf_counters_available(perf_counters_t *counters, counter_t counter) {
+  return counters->fds[counter] >= 0;
+}
+
+const char *perf_counter_name(counter_t counter) {
+  return COUNTER_NAMES[counter];
+}
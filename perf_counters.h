@@ -0,0 +1,68 @@
+#ifndef __PERF_COUNTERS_H__
+#define __PERF_COUNTERS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * The hardware events counted for headless benchmark runs.
+ */
+typedef enum {
+  COUNTER_CYCLES,
+  COUNTER_INSTRUCTIONS,
+  COUNTER_CACHE_MISSES,
+  COUNTER_BRANCH_MISSES,
+  NUM_COUNTERS
+} counter_t;
+
+/**
+ * The CPU counters of one thread, opened with perf_event_open() as a single
+ * group so that all of them are read with one system call and cover exactly
+ * the same instructions. Only user space is counted.
+ * The browser build and other systems have no counters.
+ */
+typedef struct perf_counters perf_counters_t;
+
+/**
+ * Starts counting on the calling thread. Counters the CPU or the kernel
+ * does not allow are left out and read as 0.
+ *
+ * @return the counters, or NULL if none of them could be opened, e.g. when
+ *   perf_event_paranoid forbids it or in a virtual machine without a PMU
+ */
+perf_counters_t *perf_counters_open(void);
+
+/**
+ * Stops counting and releases the counters.
+ *
+ * @param counters a pointer to counters returned from perf_counters_open()
+ */
+void perf_counters_close(perf_counters_t *counters);
+
+/**
+ * Reads the running totals of every counter. Only the thread that opened
+ * the counters may read them.
+ *
+ * @param counters a pointer to counters returned from perf_counters_open()
+ * @param values an array of NUM_COUNTERS totals to fill in
+ */
+void perf_counters_read(perf_counters_t *counters, uint64_t *values);
+
+/**
+ * Tells whether a counter could be opened.
+ *
+ * @param counters a pointer to counters returned from perf_counters_open()
+ * @param counter the counter to check
+ * @return true if the counter is counting
+ */
+bool perf_counters_available(perf_counters_t *counters, counter_t counter);
+
+/**
+ * Gets the name a counter is reported under, e.g. "cache_misses".
+ *
+ * @param counter the counter
+ * @return a static string
+ */
+const char *perf_counter_name(counter_t counter);
+
+#endif // #ifndef __PERF_COUNTERS_H__
@@ -0,0 +1,50 @@
+#include "point_list.h"
+#include "alloc_track.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+void point_list_init(point_list_t *list) {
+  list->heap = NULL;
+  list->size = 0;
+  list->capacity = POINT_LIST_INLINE;
+}
+
+void point_list_free(point_list_t *list) {
+  alloc_track_free(list->heap);
+  point_list_init(list);
+}
+
+vector_t *point_list_data(point_list_t *list) {
+  return list->heap != NULL ? list->heap : list->inline_points;
+}
+
+void point_list_reserve(point_list_t *list, size_t capacity) {
+  if (capacity <= list->capacity) {
+    return;
+  }
+  size_t new_capacity = list->capacity;
+  while (new_capacity < capacity) {
+    new_capacity *= 2;
+  }
+  if (list->heap == NULL) {
+    list->heap =
+        alloc_track_malloc(ALLOC_LIST, new_capacity * sizeof(vector_t));
+    assert(list->heap != NULL);
+    memcpy(list->heap, list->inline_points, list->size * sizeof(vector_t));
+  } else {
+    list->heap = alloc_track_realloc(ALLOC_LIST, list->heap,
+                                     new_capacity * sizeof(vector_t));
+    assert(list->heap != NULL);
+  }
+  list->capacity = new_capacity;
+}
+
+size_t point_list_size(point_list_t *list) { return list->size; }
+
+vector_t *point_list_extend(point_list_t *list, size_t count) {
+  point_list_reserve(list, list->size + count);
+  vector_t *first = point_list_data(list) + list->size;
+  list->size += count;
+  return first;
+}
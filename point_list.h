@@ -0,0 +1,74 @@
+#ifndef __POINT_LIST_H__
+#define __POINT_LIST_H__
+
+#include "vector.h"
+#include <stddef.h>
+
+// lists of up to this many points need no allocation
+#define POINT_LIST_INLINE 16
+
+/**
+ * A growable array of vector_t held by value.
+ * Short lists, such as the corners of a polygon, live in the struct itself;
+ * longer ones move to one heap block. A point_list_t is usually a local
+ * variable or a struct field, so it is initialised in place rather than
+ * allocated, and must not be copied while it holds points.
+ */
+typedef struct point_list {
+  vector_t *heap;
+  size_t size;
+  size_t capacity;
+  vector_t inline_points[POINT_LIST_INLINE];
+} point_list_t;
+
+/**
+ * Initialises an empty list in place.
+ *
+ * @param list the list to initialise
+ */
+void point_list_init(point_list_t *list);
+
+/**
+ * Releases the heap block of a list, if it has one, and empties it.
+ *
+ * @param list a list initialised with point_list_init()
+ */
+void point_list_free(point_list_t *list);
+
+/**
+ * Makes room for at least capacity points, so adding up to that many
+ * does not reallocate.
+ *
+ * @param list a list initialised with point_list_init()
+ * @param capacity the number of points to make room for
+ */
+void point_list_reserve(point_list_t *list, size_t capacity);
+
+/**
+ * Gets the number of points in a list.
+ *
+ * @param list a list initialised with point_list_init()
+ * @return the number of points
+ */
+size_t point_list_size(point_list_t *list);
+
+/**
+ * Gets the points of a list as one array.
+ * The pointer is valid until the list next grows.
+ *
+ * @param list a list initialised with point_list_init()
+ * @return the first point
+ */
+vector_t *point_list_data(point_list_t *list);
+
+/**
+ * Appends count points to a list without setting them, for code that
+ * writes straight into the array, such as trajectory_sample().
+ *
+ * @param list a list initialised with point_list_init()
+ * @param count the number of points to append
+ * @return the first of the new points
+ */
+vector_t *point_list_extend(point_list_t *list, size_t count);
+
+#endif // #ifndef __POINT_LIST_H__
@@ -0,0 +1,208 @@
+#include "pool.h"
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static const size_t INIT_DEQUE_CAPACITY = 16;
+
+typedef struct range {
+  size_t start;
+  size_t end;
+} range_t;
+
+// the owner pops from the bottom, thieves take from the top
+typedef struct deque {
+  pthread_mutex_t lock;
+  range_t *ranges;
+  size_t top;
+  size_t bottom;
+  size_t capacity;
+} deque_t;
+
+typedef struct worker {
+  struct pool *pool;
+  size_t index;
+} worker_t;
+
+struct pool {
+  size_t num_threads;
+  pthread_t *threads;
+  worker_t *workers;
+  deque_t *deques;
+
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  size_t generation;
+  bool stopping;
+
+  pool_task_t task;
+  void *aux;
+  atomic_size_t remaining;
+};
+
+static void deque_push(deque_t *deque, range_t range) {
+  pthread_mutex_lock(&deque->lock);
+  if (deque->bottom == deque->capacity) {
+    deque->capacity *= 2;
+    deque->ranges = realloc(deque->ranges, deque->capacity * sizeof(range_t));
+    assert(deque->ranges != NULL);
+  }
+  deque->ranges[deque->bottom++] = range;
+  pthread_mutex_unlock(&deque->lock);
+}
+
+static bool deque_pop(deque_t *deque, range_t *range) {
+  pthread_mutex_lock(&deque->lock);
+  bool found = deque->bottom > deque->top;
+  if (found) {
+    *range = deque->ranges[--deque->bottom];
+  }
+  if (deque->bottom == deque->top) {
+    deque->top = 0;
+    deque->bottom = 0;
+  }
+  pthread_mutex_unlock(&deque->lock);
+  return found;
+}
+
+static bool deque_steal(deque_t *deque, range_t *range) {
+  pthread_mutex_lock(&deque->lock);
+  bool found = deque->bottom > deque->top;
+  if (found) {
+    *range = deque->ranges[deque->top++];
+  }
+  pthread_mutex_unlock(&deque->lock);
+  return found;
+}
+
+// runs ranges until neither this worker's deque nor any other has one left
+static void work(pool_t *pool, size_t index) {
+  range_t range;
+  while (true) {
+    bool found = deque_pop(&pool->deques[index], &range);
+    for (size_t i = 1; !found && i < pool->num_threads; i++) {
+      found = deque_steal(&pool->deques[(index + i) % pool->num_threads],
+                          &range);
+    }
+    if (!found) {
+      return;
+    }
+    pool->task(range.start, range.end, pool->aux);
+    atomic_fetch_sub_explicit(&pool->remaining, 1, memory_order_release);
+  }
+}
+
+static void *run_worker(void *aux) {
+  worker_t *worker = aux;
+  pool_t *pool = worker->pool;
+  size_t seen = 0;
+  while (true) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->generation == seen && !pool->stopping) {
+      pthread_cond_wait(&pool->wake, &pool->lock);
+    }
+    seen = pool->generation;
+    bool stopping = pool->stopping;
+    pthread_mutex_unlock(&pool->lock);
+    if (stopping) {
+      return NULL;
+    }
+    work(pool, worker->index);
+  }
+}
+
+pool_t *pool_init(size_t num_threads) {
+#ifdef __EMSCRIPTEN__
+  // the browser build keeps every loop on the calling thread
+  num_threads = 1;
+#else
+  if (num_threads == 0) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = cores > 0 ? cores : 1;
+  }
+#endif
+  pool_t *pool = malloc(sizeof(pool_t));
+  assert(pool != NULL);
+  *pool = (pool_t){.num_threads = num_threads};
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+  atomic_init(&pool->remaining, 0);
+  pool->deques = calloc(num_threads, sizeof(deque_t));
+  pool->workers = calloc(num_threads, sizeof(worker_t));
+  pool->threads = calloc(num_threads, sizeof(pthread_t));
+  assert(pool->deques != NULL && pool->workers != NULL &&
+         pool->threads != NULL);
+  for (size_t i = 0; i < num_threads; i++) {
+    deque_t *deque = &pool->deques[i];
+    pthread_mutex_init(&deque->lock, NULL);
+    deque->capacity = INIT_DEQUE_CAPACITY;
+    deque->ranges = malloc(deque->capacity * sizeof(range_t));
+    assert(deque->ranges != NULL);
+    pool->workers[i] = (worker_t){.pool = pool, .index = i};
+  }
+  // the caller is worker 0
+  for (size_t i = 1; i < num_threads; i++) {
+    pthread_create(&pool->threads[i], NULL, run_worker, &pool->workers[i]);
+  }
+  return pool;
+}
+
+void pool_free(pool_t *pool) {
+  pthread_mutex_lock(&pool->lock);
+  pool->stopping = true;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+  for (size_t i = 1; i < pool->num_threads; i++) {
+    pthread_join(pool->threads[i], NULL);
+  }
+  for (size_t i = 0; i < pool->num_threads; i++) {
+    pthread_mutex_destroy(&pool->deques[i].lock);
+    free(pool->deques[i].ranges);
+  }
+  pthread_cond_destroy(&pool->wake);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool->deques);
+  free(pool->workers);
+  free(pool->threads);
+  free(pool);
+}
+
+size_t pool_threads(pool_t *pool) { return pool->num_threads; }
+
+void pool_parallel_for(pool_t *pool, size_t count, size_t grain,
+                       pool_task_t task, void *aux) {
+  if (grain == 0) {
+    grain = 1;
+  }
+  if (pool == NULL || pool->num_threads == 1 || count <= grain) {
+    if (count > 0) {
+      task(0, count, aux);
+    }
+    return;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->task = task;
+  pool->aux = aux;
+  size_t num_ranges = (count + grain - 1) / grain;
+  atomic_store(&pool->remaining, num_ranges);
+  // deal the ranges out in turn so every worker starts with a fair share
+  for (size_t i = 0; i < num_ranges; i++) {
+    size_t start = i * grain;
+    size_t end = start + grain < count ? start + grain : count;
+    deque_push(&pool->deques[i % pool->num_threads],
+               (range_t){.start = start, .end = end});
+  }
+  pool->generation++;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+
+  work(pool, 0);
+  while (atomic_load_explicit(&pool->remaining, memory_order_acquire) > 0) {
+    sched_yield();
+  }
+}
@@ -0,0 +1,63 @@
+#ifndef __POOL_H__
+#define __POOL_H__
+
+#include <stddef.h>
+
+/**
+ * A fixed set of worker threads that split loops between them.
+ * Each worker owns a deque of index ranges and steals from the others
+ * once its own runs out, so uneven ranges still finish together.
+ * The browser build has no workers and runs every loop on the caller.
+ */
+typedef struct pool pool_t;
+
+/**
+ * Runs the indices [start, end) of a parallel loop.
+ *
+ * @param start the first index of the range
+ * @param end one past the last index of the range
+ * @param aux the aux passed to pool_parallel_for()
+ */
+typedef void (*pool_task_t)(size_t start, size_t end, void *aux);
+
+/**
+ * Starts a pool.
+ *
+ * @param num_threads the number of threads that run loops, including the
+ *   calling thread, or 0 for one per core
+ * @return the new pool
+ */
+pool_t *pool_init(size_t num_threads);
+
+/**
+ * Stops the workers of a pool and releases its memory.
+ *
+ * @param pool a pointer to a pool returned from pool_init()
+ */
+void pool_free(pool_t *pool);
+
+/**
+ * Gets the number of threads that run loops, including the caller.
+ *
+ * @param pool a pointer to a pool returned from pool_init()
+ * @return the number of threads
+ */
+size_t pool_threads(pool_t *pool);
+
+/**
+ * Calls task on ranges of at most grain indices that together cover
+ * [0, count), and returns once every range has run.
+ * The ranges may run in any order and on any thread, so task must only
+ * write to memory that belongs to its own indices.
+ *
+ * @param pool a pointer to a pool returned from pool_init(), or NULL to run
+ *   the whole loop on the calling thread
+ * @param count the number of indices
+ * @param grain the largest range handed to one call of task
+ * @param task the body of the loop
+ * @param aux passed to task
+ */
+void pool_parallel_for(pool_t *pool, size_t count, size_t grain,
+                       pool_task_t task, void *aux);
+
+#endif // #ifndef __POOL_H__
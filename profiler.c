@@ -0,0 +1,262 @@
+#include "profiler.h"
+#include "color.h"
+#include "list.h"
+#include "sdl_wrapper.h"
+#include "shape.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const size_t PROFILER_FRAMES = 256;
+static const double MS_PER_SECOND = 1000.0;
+static const double MS_PER_NANOSECOND = 1e-6;
+
+static const char *PHASE_NAMES[NUM_PHASES] = {
+    "input", "tick", "rules", "motion", "capture", "render"};
+static const rgb_color_t PHASE_COLORS[NUM_PHASES] = {{0.5, 0.5, 0.5},
+                                                     {0.2, 0.4, 0.9},
+                                                     {0.9, 0.6, 0.1},
+                                                     {0.7, 0.2, 0.7},
+                                                     {0.2, 0.7, 0.3},
+                                                     {0.8, 0.1, 0.1}};
+static const rgb_color_t HISTOGRAM_COLOR = {0.1, 0.1, 0.1};
+
+// the overlay sits in the top left corner of the window
+static const double OVERLAY_LEFT = 10;
+static const double OVERLAY_TOP = 490;
+static const double PHASE_BAR_HEIGHT = 8;
+static const double PHASE_BAR_GAP = 4;
+static const double PIXELS_PER_MS = 20;
+static const size_t HISTOGRAM_BUCKETS = 16;
+static const double HISTOGRAM_BUCKET_MS = 2;
+static const double HISTOGRAM_BAR_WIDTH = 8;
+static const double HISTOGRAM_HEIGHT = 80;
+
+struct profiler {
+  frame_sample_t *samples;
+  size_t next;
+  size_t count;
+  frame_sample_t current;
+  double frame_start;
+  phase_t stack[NUM_PHASES];
+  double stack_start[NUM_PHASES];
+  size_t depth;
+  perf_counters_t *counters;
+  // the counter totals at the last phase change
+  uint64_t last_counters[NUM_COUNTERS];
+  bool overlay;
+  bool used;
+};
+
+static double now_ms(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * MS_PER_SECOND + now.tv_nsec * MS_PER_NANOSECOND;
+}
+
+profiler_t *profiler_init(void) {
+  profiler_t *profiler = malloc(sizeof(profiler_t));
+  assert(profiler != NULL);
+  *profiler = (profiler_t){0};
+  profiler->samples = calloc(PROFILER_FRAMES, sizeof(frame_sample_t));
+  assert(profiler->samples != NULL);
+  return profiler;
+}
+
+void profiler_free(profiler_t *profiler) {
+  free(profiler->samples);
+  free(profiler);
+}
+
+void profiler_set_counters(profiler_t *profiler, perf_counters_t *counters) {
+  profiler->counters = counters;
+  if (counters != NULL) {
+    perf_counters_read(counters, profiler->last_counters);
+  }
+}
+
+// gives the events since the last phase change to the innermost phase, or
+// drops them when no phase is running
+static void count_events(profiler_t *profiler) {
+  if (profiler->counters == NULL) {
+    return;
+  }
+  uint64_t now[NUM_COUNTERS];
+  perf_counters_read(profiler->counters, now);
+  if (profiler->depth > 0) {
+    phase_t phase = profiler->stack[profiler->depth - 1];
+    for (size_t i = 0; i < NUM_COUNTERS; i++) {
+      profiler->current.phase_counters[phase][i] +=
+          now[i] - profiler->last_counters[i];
+    }
+  }
+  memcpy(profiler->last_counters, now, sizeof(now));
+}
+
+void profiler_begin_frame(profiler_t *profiler) {
+  memset(&profiler->current, 0, sizeof(frame_sample_t));
+  profiler->depth = 0;
+  profiler->frame_start = now_ms();
+}
+
+void profiler_begin(profiler_t *profiler, phase_t phase) {
+  assert(profiler->depth < NUM_PHASES);
+  count_events(profiler);
+  double now = now_ms();
+  if (profiler->depth > 0) {
+    size_t top = profiler->depth - 1;
+    profiler->current.phase_ms[profiler->stack[top]] +=
+        now - profiler->stack_start[top];
+  }
+  profiler->stack[profiler->depth] = phase;
+  profiler->stack_start[profiler->depth] = now;
+  profiler->depth++;
+}
+
+void profiler_end(profiler_t *profiler) {
+  assert(profiler->depth > 0);
+  count_events(profiler);
+  double now = now_ms();
+  profiler->depth--;
+  size_t top = profiler->depth;
+  profiler->current.phase_ms[profiler->stack[top]] +=
+      now - profiler->stack_start[top];
+  if (profiler->depth > 0) {
+    profiler->stack_start[profiler->depth - 1] = now;
+  }
+}
+
+void profiler_record(profiler_t *profiler, phase_t phase, double ms) {
+  profiler->current.phase_ms[phase] += ms;
+}
+
+void profiler_end_frame(profiler_t *profiler, size_t bodies,
+                        size_t tracked_creators) {
+  profiler->current.frame_ms = now_ms() - profiler->frame_start;
+  profiler->current.bodies = bodies;
+  profiler->current.tracked_creators = tracked_creators;
+  profiler->samples[profiler->next] = profiler->current;
+  profiler->next = (profiler->next + 1) % PROFILER_FRAMES;
+  if (profiler->count < PROFILER_FRAMES) {
+    profiler->count++;
+  }
+}
+
+size_t profiler_samples(profiler_t *profiler) { return profiler->count; }
+
+frame_sample_t *profiler_get_sample(profiler_t *profiler, size_t index) {
+  assert(index < profiler->count);
+  size_t oldest = (profiler->next + PROFILER_FRAMES - profiler->count) %
+                  PROFILER_FRAMES;
+  return &profiler->samples[(oldest + index) % PROFILER_FRAMES];
+}
+
+void profiler_average(profiler_t *profiler, double *phase_ms) {
+  for (size_t phase = 0; phase < NUM_PHASES; phase++) {
+    phase_ms[phase] = 0;
+  }
+  if (profiler->count == 0) {
+    return;
+  }
+  for (size_t i = 0; i < profiler->count; i++) {
+    for (size_t phase = 0; phase < NUM_PHASES; phase++) {
+      phase_ms[phase] += profiler->samples[i].phase_ms[phase];
+    }
+  }
+  for (size_t phase = 0; phase < NUM_PHASES; phase++) {
+    phase_ms[phase] /= profiler->count;
+  }
+}
+
+void profiler_histogram(profiler_t *profiler, size_t *buckets,
+                        size_t num_buckets, double bucket_ms) {
+  memset(buckets, 0, num_buckets * sizeof(size_t));
+  for (size_t i = 0; i < profiler->count; i++) {
+    size_t bucket = profiler->samples[i].frame_ms / bucket_ms;
+    if (bucket >= num_buckets) {
+      bucket = num_buckets - 1;
+    }
+    buckets[bucket]++;
+  }
+}
+
+const char *profiler_phase_name(phase_t phase) { return PHASE_NAMES[phase]; }
+
+void profiler_toggle_overlay(profiler_t *profiler) {
+  profiler->overlay = !profiler->overlay;
+  profiler->used = true;
+}
+
+bool profiler_overlay_shown(profiler_t *profiler) { return profiler->overlay; }
+
+bool profiler_was_used(profiler_t *profiler) { return profiler->used; }
+
+static void draw_bar(double left, double bottom, double width, double height,
+                     rgb_color_t color) {
+  if (width <= 0 || height <= 0) {
+    return;
+  }
+  list_t *bar = make_rectangle(height, width, left + width / 2,
+                               bottom + height / 2);
+  sdl_draw_polygon(bar, color);
+  list_free(bar);
+}
+
+void profiler_draw_overlay(profiler_t *profiler) {
+  double phase_ms[NUM_PHASES];
+  profiler_average(profiler, phase_ms);
+  double y = OVERLAY_TOP;
+  for (size_t phase = 0; phase < NUM_PHASES; phase++) {
+    y -= PHASE_BAR_HEIGHT;
+    draw_bar(OVERLAY_LEFT, y, phase_ms[phase] * PIXELS_PER_MS,
+             PHASE_BAR_HEIGHT, PHASE_COLORS[phase]);
+    y -= PHASE_BAR_GAP;
+  }
+
+  size_t buckets[HISTOGRAM_BUCKETS];
+  profiler_histogram(profiler, buckets, HISTOGRAM_BUCKETS,
+                     HISTOGRAM_BUCKET_MS);
+  y -= HISTOGRAM_HEIGHT;
+  for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    double height = profiler->count == 0
+                        ? 0
+                        : HISTOGRAM_HEIGHT * buckets[i] / profiler->count;
+    draw_bar(OVERLAY_LEFT + i * HISTOGRAM_BAR_WIDTH, y,
+             HISTOGRAM_BAR_WIDTH - 1, height, HISTOGRAM_COLOR);
+  }
+}
+
+void profiler_dump_json(profiler_t *profiler, FILE *file) {
+  fprintf(file, "{\"frames\": [\n");
+  for (size_t i = 0; i < profiler->count; i++) {
+    frame_sample_t *sample = profiler_get_sample(profiler, i);
+    fprintf(file,
+            "  {\"frame_ms\": %.4f, \"bodies\": %zu, "
+            "\"tracked_force_creators\": %zu",
+            sample->frame_ms, sample->bodies, sample->tracked_creators);
+    for (size_t phase = 0; phase < NUM_PHASES; phase++) {
+      fprintf(file, ", \"%s_ms\": %.4f", PHASE_NAMES[phase],
+              sample->phase_ms[phase]);
+    }
+    fprintf(file, "}%s\n", i + 1 < profiler->count ? "," : "");
+  }
+  fprintf(file, "]}\n");
+}
+
+void profiler_dump_csv(profiler_t *profiler, FILE *file) {
+  fprintf(file, "frame_ms,bodies,tracked_force_creators");
+  for (size_t phase = 0; phase < NUM_PHASES; phase++) {
+    fprintf(file, ",%s_ms", PHASE_NAMES[phase]);
+  }
+  fprintf(file, "\n");
+  for (size_t i = 0; i < profiler->count; i++) {
+    frame_sample_t *sample = profiler_get_sample(profiler, i);
+    fprintf(file, "%.4f,%zu,%zu", sample->frame_ms, sample->bodies,
+            sample->tracked_creators);
+    for (size_t phase = 0; phase < NUM_PHASES; phase++) {
+      fprintf(file, ",%.4f", sample->phase_ms[phase]);
+    }
+    fprintf(file, "\n");
+  }
+}
@@ -0,0 +1,185 @@
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include "perf_counters.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * The phases of a frame that are timed separately.
+ * Phases nest: beginning a phase pauses the enclosing one, so each sample
+ * holds exclusive time per phase.
+ */
+typedef enum {
+  PHASE_INPUT,
+  PHASE_TICK,
+  PHASE_RULES,
+  PHASE_MOTION,
+  // copying the scene into the snapshot the renderer draws
+  PHASE_CAPTURE,
+  PHASE_RENDER,
+  NUM_PHASES
+} phase_t;
+
+/**
+ * Timing and population of one finished frame.
+ * phase_counters stays 0 unless counters were given to the profiler, and
+ * never includes time recorded with profiler_record(). tracked_creators only
+ * counts the force creators the game registered itself.
+ */
+typedef struct frame_sample {
+  double phase_ms[NUM_PHASES];
+  uint64_t phase_counters[NUM_PHASES][NUM_COUNTERS];
+  double frame_ms;
+  size_t bodies;
+  size_t tracked_creators;
+} frame_sample_t;
+
+/**
+ * A fixed-size ring buffer of frame samples plus the timers of the frame
+ * currently being recorded.
+ */
+typedef struct profiler profiler_t;
+
+/**
+ * Allocates a profiler with room for the last PROFILER_FRAMES frames.
+ *
+ * @return the new profiler
+ */
+profiler_t *profiler_init(void);
+
+/**
+ * Releases the memory allocated for a profiler.
+ *
+ * @param profiler a pointer to a profiler returned from profiler_init()
+ */
+void profiler_free(profiler_t *profiler);
+
+/**
+ * Makes every phase also count hardware events, attributed to phases the
+ * same way as time. The profiler's phases must then begin and end on the
+ * thread that opened the counters.
+ *
+ * @param profiler a pointer to a profiler returned from profiler_init()
+ * @param counters counters from perf_counters_open(), or NULL to stop
+ *   counting; the profiler does not close them
+ */
+void profiler_set_counters(profiler_t *profiler, perf_counters_t *counters);
+
+/**
+ * Starts timing a new frame.
+ *
+ * @param profiler a pointer to a profiler returned from profiler_init()
+ */
+void profiler_begin_frame(profiler_t *profiler);
+
+/**
+ * Starts timing a phase, pausing the phase it is nested in.
+ *
+ * @param profiler a pointer to a profiler returned from profiler_init()
+ * @param phase the phase that starts
+ */
+void profiler_begin(profiler_t *profiler, phase_t phase);
+
+/**
+ * Stops timing the innermost phase and resumes the one it was nested in.
+ *
+ * @param profiler a pointer to a profiler returned from profiler_init()
+ */
+void profiler_end(profiler_t *profiler);
+
+/**
+ * Adds time measured elsewhere, such as on the render thread, to a phase of
+ * the current frame.
+ *
+ * @param profiler a pointer to a profiler returned from profiler_init()
+ * @param phase the phase the time belongs to
+ * @param ms the time in milliseconds
+ */
+void profiler_record(profiler_t *profiler, phase_t phase, double ms);
+
+/**
+ * Finishes the current frame and stores it in the ring buffer.
+ *
+ * @param profiler a pointer to a profiler returned from profiler_init()
+ * @param bodies the number of bodies in the scene this frame
+ * @param tracked_creators the number of live force creators the game
+ *   registered itself this frame; creators the library makes are not seen
+ */
+void profiler_end_frame(profiler_t *profiler, size_t bodies,
+                        size_t tracked_creators);
+
+/**
+ * Gets the number of frames held in the ring buffer.
+ *
+ * @param profiler a pointer to a profiler returned from profiler_init()
+ * @return the number of stored frames, at most PROFILER_FRAMES
+ */
+size_t profiler_samples(profiler_t *profiler);
+
+/**
+ * Gets a stored frame, oldest first.
+ *
+ * @param profiler a pointer to a profiler returned from profiler_init()
+ * @param index an index less than profiler_samples(profiler)
+ * @return the frame sample at that index
+ */
+frame_sample_t *profiler_get_sample(profiler_t *profiler, size_t index);
+
+/**
+ * Averages each phase over the stored frames.
+ *
+ * @param profiler a pointer to a profiler returned from profiler_init()
+ * @param phase_ms an array of NUM_PHASES averages to fill in
+ */
+void profiler_average(profiler_t *profiler, double *phase_ms);
+
+/**
+ * Counts the stored frames by frame time.
+ * The last bucket also counts every frame longer than the histogram.
+ *
+ * @param profiler a pointer to a profiler returned from profiler_init()
+ * @param buckets an array of num_buckets counts to fill in
+ * @param num_buckets the number of buckets
+ * @param bucket_ms the width of each bucket in milliseconds
+ */
+void profiler_histogram(profiler_t *profiler, size_t *buckets,
+                        size_t num_buckets, double bucket_ms);
+
+/**
+ * Gets the name a phase is reported under, e.g. "tick".
+ *
+ * @param phase the phase
+ * @return a static string
+ */
+const char *profiler_phase_name(phase_t phase);
+
+/**
+ * Toggles and reads whether the overlay is drawn.
+ * The overlay having been shown once is what arms the dump on exit.
+ */
+void profiler_toggle_overlay(profiler_t *profiler);
+bool profiler_overlay_shown(profiler_t *profiler);
+bool profiler_was_used(profiler_t *profiler);
+
+/**
+ * Draws per-phase bars and the frame-time histogram over the current frame.
+ * Must be called after the scene was drawn and before the frame is shown,
+ * e.g. from the renderer's overlay hook.
+ *
+ * @param profiler a pointer to a profiler returned from profiler_init()
+ */
+void profiler_draw_overlay(profiler_t *profiler);
+
+/**
+ * Writes every stored frame as JSON or as CSV.
+ *
+ * @param profiler a pointer to a profiler returned from profiler_init()
+ * @param file an open file to write to
+ */
+void profiler_dump_json(profiler_t *profiler, FILE *file);
+void profiler_dump_csv(profiler_t *profiler, FILE *file);
+
+#endif // #ifndef __PROFILER_H__
@@ -0,0 +1,375 @@
+#include "query.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const size_t INIT_CAPACITY = 64;
+static const double PARALLEL_EPSILON = 1e-12;
+
+// the corners of an indexed body are points[first_point] onwards in the
+// index, copied at build time
+typedef struct indexed_body {
+  body_t *body;
+  size_t first_point;
+  size_t num_points;
+  vector_t min;
+  vector_t max;
+  size_t stamp;
+} indexed_body_t;
+
+// the cells are stored compressed: the bodies of cell c are
+// entries[cell_start[c]] up to entries[cell_start[c + 1]]
+struct spatial_index {
+  vector_t window;
+  double cell_size;
+  size_t columns;
+  size_t rows;
+
+  indexed_body_t *bodies;
+  size_t num_bodies;
+  size_t bodies_capacity;
+  vector_t *points;
+  size_t num_points;
+  size_t points_capacity;
+
+  size_t *cell_start;
+  size_t *cell_fill;
+  size_t *entries;
+  size_t entries_capacity;
+  // bodies reaching past the grid, tested when a cast leaves it
+  size_t *outside;
+  size_t num_outside;
+  size_t outside_capacity;
+
+  size_t query;
+};
+
+// grows an array so that it holds at least needed elements
+static void reserve(void **data, size_t *capacity, size_t needed,
+                    size_t element_size) {
+  if (needed <= *capacity) {
+    return;
+  }
+  size_t new_capacity = *capacity == 0 ? INIT_CAPACITY : *capacity;
+  while (new_capacity < needed) {
+    new_capacity *= 2;
+  }
+  *data = realloc(*data, new_capacity * element_size);
+  assert(*data != NULL);
+  *capacity = new_capacity;
+}
+
+spatial_index_t *spatial_index_init(vector_t window, double cell_size) {
+  spatial_index_t *index = malloc(sizeof(spatial_index_t));
+  assert(index != NULL);
+  *index = (spatial_index_t){.window = window, .cell_size = cell_size};
+  index->columns = (size_t)ceil(window.x / cell_size);
+  index->rows = (size_t)ceil(window.y / cell_size);
+  size_t num_cells = index->columns * index->rows;
+  index->cell_start = calloc(num_cells + 1, sizeof(size_t));
+  index->cell_fill = calloc(num_cells, sizeof(size_t));
+  assert(index->cell_start != NULL && index->cell_fill != NULL);
+  return index;
+}
+
+void spatial_index_free(spatial_index_t *index) {
+  free(index->bodies);
+  free(index->points);
+  free(index->cell_start);
+  free(index->cell_fill);
+  free(index->entries);
+  free(index->outside);
+  free(index);
+}
+
+static size_t clamp_cell(double coordinate, double cell_size, size_t count) {
+  double cell = floor(coordinate / cell_size);
+  if (cell < 0) {
+    return 0;
+  }
+  return cell >= count ? count - 1 : (size_t)cell;
+}
+
+// the library hands out a new list of the corners, which is copied into the
+// index's own points and freed at once
+static void add_body(spatial_index_t *index, body_t *body) {
+  list_t *shape = body_get_actual_shape(body);
+  size_t num_points = list_size(shape);
+  if (num_points == 0) {
+    list_free(shape);
+    return;
+  }
+  reserve((void **)&index->points, &index->points_capacity,
+          index->num_points + num_points, sizeof(vector_t));
+  vector_t *points = &index->points[index->num_points];
+  for (size_t i = 0; i < num_points; i++) {
+    points[i] = *(vector_t *)list_get(shape, i);
+  }
+  list_free(shape);
+  vector_t min = points[0];
+  vector_t max = points[0];
+  for (size_t i = 1; i < num_points; i++) {
+    min.x = fmin(min.x, points[i].x);
+    min.y = fmin(min.y, points[i].y);
+    max.x = fmax(max.x, points[i].x);
+    max.y = fmax(max.y, points[i].y);
+  }
+  reserve((void **)&index->bodies, &index->bodies_capacity,
+          index->num_bodies + 1, sizeof(indexed_body_t));
+  if (min.x < 0 || min.y < 0 || max.x > index->window.x ||
+      max.y > index->window.y) {
+    reserve((void **)&index->outside, &index->outside_capacity,
+            index->num_outside + 1, sizeof(size_t));
+    index->outside[index->num_outside++] = index->num_bodies;
+  }
+  index->bodies[index->num_bodies++] =
+      (indexed_body_t){.body = body,
+                       .first_point = index->num_points,
+                       .num_points = num_points,
+                       .min = min,
+                       .max = max,
+                       .stamp = 0};
+  index->num_points += num_points;
+}
+
+typedef struct cell_range {
+  size_t first_column;
+  size_t last_column;
+  size_t first_row;
+  size_t last_row;
+} cell_range_t;
+
+// the cells an indexed body's bounding box covers
+static cell_range_t body_cells(spatial_index_t *index, indexed_body_t *entry) {
+  return (cell_range_t){
+      .first_column =
+          clamp_cell(entry->min.x, index->cell_size, index->columns),
+      .last_column = clamp_cell(entry->max.x, index->cell_size, index->columns),
+      .first_row = clamp_cell(entry->min.y, index->cell_size, index->rows),
+      .last_row = clamp_cell(entry->max.y, index->cell_size, index->rows)};
+}
+
+void spatial_index_build(spatial_index_t *index, scene_t *scene,
+                         query_filter_t filter, void *aux) {
+  index->num_bodies = 0;
+  index->num_points = 0;
+  index->num_outside = 0;
+  for (size_t i = 0; i < scene_bodies(scene); i++) {
+    body_t *body = scene_get_body(scene, i);
+    if (body_is_removed(body) || (filter != NULL && !filter(body, aux))) {
+      continue;
+    }
+    add_body(index, body);
+  }
+
+  size_t num_cells = index->columns * index->rows;
+  memset(index->cell_start, 0, (num_cells + 1) * sizeof(size_t));
+  for (size_t i = 0; i < index->num_bodies; i++) {
+    cell_range_t range = body_cells(index, &index->bodies[i]);
+    for (size_t row = range.first_row; row <= range.last_row; row++) {
+      for (size_t column = range.first_column; column <= range.last_column;
+           column++) {
+        index->cell_start[row * index->columns + column + 1]++;
+      }
+    }
+  }
+  for (size_t cell = 0; cell < num_cells; cell++) {
+    index->cell_start[cell + 1] += index->cell_start[cell];
+    index->cell_fill[cell] = index->cell_start[cell];
+  }
+  reserve((void **)&index->entries, &index->entries_capacity,
+          index->cell_start[num_cells], sizeof(size_t));
+  for (size_t i = 0; i < index->num_bodies; i++) {
+    cell_range_t range = body_cells(index, &index->bodies[i]);
+    for (size_t row = range.first_row; row <= range.last_row; row++) {
+      for (size_t column = range.first_column; column <= range.last_column;
+           column++) {
+        size_t cell = row * index->columns + column;
+        index->entries[index->cell_fill[cell]++] = i;
+      }
+    }
+  }
+}
+
+// the first t >= 0 at which origin + t direction is on the circle, or
+// INFINITY if it never is or starts inside it
+static double cast_circle(vector_t origin, vector_t direction, vector_t centre,
+                          double radius) {
+  vector_t offset = vec_subtract(origin, centre);
+  double b = vec_dot(offset, direction);
+  double c = vec_dot(offset, offset) - radius * radius;
+  double discriminant = b * b - c;
+  if (c <= 0 || discriminant < 0) {
+    return INFINITY;
+  }
+  double t = -b - sqrt(discriminant);
+  return t >= 0 ? t : INFINITY;
+}
+
+static double cast_segment(vector_t origin, vector_t direction, vector_t a,
+                           vector_t edge) {
+  double denominator = vec_cross(direction, edge);
+  if (fabs(denominator) < PARALLEL_EPSILON) {
+    return INFINITY;
+  }
+  vector_t offset = vec_subtract(a, origin);
+  double t = vec_cross(offset, edge) / denominator;
+  double s = vec_cross(offset, direction) / denominator;
+  return t >= 0 && s >= 0 && s <= 1 ? t : INFINITY;
+}
+
+// the edge swept by a circle is a capsule: the edge moved out by radius on
+// both sides, with a circle around each end
+static double cast_edge(vector_t origin, vector_t direction, vector_t a,
+                        vector_t b, double radius) {
+  vector_t edge = vec_subtract(b, a);
+  double length = sqrt(vec_dot(edge, edge));
+  if (radius == 0) {
+    return length == 0 ? INFINITY : cast_segment(origin, direction, a, edge);
+  }
+  double t = cast_circle(origin, direction, a, radius);
+  if (length == 0) {
+    return t;
+  }
+  vector_t normal = {-edge.y * radius / length, edge.x * radius / length};
+  t = fmin(t, cast_segment(origin, direction, vec_add(a, normal), edge));
+  t = fmin(t, cast_segment(origin, direction, vec_subtract(a, normal), edge));
+  return t;
+}
+
+static bool contains(vector_t *points, size_t num_points, vector_t point) {
+  bool inside = false;
+  for (size_t i = 0, j = num_points - 1; i < num_points; j = i++) {
+    vector_t *a = &points[i];
+    vector_t *b = &points[j];
+    if ((a->y > point.y) != (b->y > point.y) &&
+        point.x < (b->x - a->x) * (point.y - a->y) / (b->y - a->y) + a->x) {
+      inside = !inside;
+    }
+  }
+  return inside;
+}
+
+static double cast_body(spatial_index_t *index, indexed_body_t *entry,
+                        vector_t origin, vector_t direction, double radius) {
+  vector_t *points = &index->points[entry->first_point];
+  size_t num_points = entry->num_points;
+  if (contains(points, num_points, origin)) {
+    return INFINITY;
+  }
+  double t = INFINITY;
+  for (size_t i = 0; i < num_points; i++) {
+    t = fmin(t, cast_edge(origin, direction, points[i],
+                          points[(i + 1) % num_points], radius));
+  }
+  return t;
+}
+
+// tests the bodies at some indices that this cast has not tested yet
+static void test_bodies(spatial_index_t *index, size_t *indices, size_t count,
+                        vector_t origin, vector_t direction, double radius,
+                        double *best, indexed_body_t **hit) {
+  for (size_t i = 0; i < count; i++) {
+    indexed_body_t *entry = &index->bodies[indices[i]];
+    if (entry->stamp == index->query) {
+      continue;
+    }
+    entry->stamp = index->query;
+    double t = cast_body(index, entry, origin, direction, radius);
+    if (t < *best) {
+      *best = t;
+      *hit = entry;
+    }
+  }
+}
+
+// walks the cells along the ray in order (Amanatides and Woo), testing the
+// cells within the radius of each one; a body the sweep touches at distance
+// t has a point within radius of the centre at t, so once the next cell
+// starts beyond the best hit nothing closer is left
+static bool cast(spatial_index_t *index, vector_t origin, vector_t direction,
+                 double max_distance, double radius, ray_hit_t *hit) {
+  double length = sqrt(vec_dot(direction, direction));
+  if (length == 0) {
+    return false;
+  }
+  direction = vec_multiply(1 / length, direction);
+  index->query++;
+
+  double cell_size = index->cell_size;
+  long columns = index->columns;
+  long rows = index->rows;
+  long column = clamp_cell(origin.x, cell_size, index->columns);
+  long row = clamp_cell(origin.y, cell_size, index->rows);
+  int step_x = direction.x > 0 ? 1 : -1;
+  int step_y = direction.y > 0 ? 1 : -1;
+  double next_x =
+      direction.x != 0
+          ? ((column + (step_x > 0)) * cell_size - origin.x) / direction.x
+          : INFINITY;
+  double next_y =
+      direction.y != 0
+          ? ((row + (step_y > 0)) * cell_size - origin.y) / direction.y
+          : INFINITY;
+  double delta_x = direction.x != 0 ? cell_size / fabs(direction.x) : INFINITY;
+  double delta_y = direction.y != 0 ? cell_size / fabs(direction.y) : INFINITY;
+  long reach = (long)ceil(radius / cell_size);
+
+  double best = max_distance;
+  indexed_body_t *closest = NULL;
+  // the walk may leave the grid while the swept circle still reaches into it
+  while (column + reach >= 0 && column - reach < columns && row + reach >= 0 &&
+         row - reach < rows) {
+    long first_row = row - reach > 0 ? row - reach : 0;
+    long last_row = row + reach < rows ? row + reach : rows - 1;
+    long first_column = column - reach > 0 ? column - reach : 0;
+    long last_column = column + reach < columns ? column + reach : columns - 1;
+    for (long r = first_row; r <= last_row; r++) {
+      for (long c = first_column; c <= last_column; c++) {
+        size_t cell = r * columns + c;
+        size_t first = index->cell_start[cell];
+        test_bodies(index, &index->entries[first],
+                    index->cell_start[cell + 1] - first, origin, direction,
+                    radius, &best, &closest);
+      }
+    }
+
+    if (fmin(next_x, next_y) > best) {
+      break;
+    }
+    if (next_x < next_y) {
+      column += step_x;
+      next_x += delta_x;
+    } else {
+      row += step_y;
+      next_y += delta_y;
+    }
+  }
+  test_bodies(index, index->outside, index->num_outside, origin, direction,
+              radius, &best, &closest);
+
+  if (closest == NULL) {
+    return false;
+  }
+  *hit = (ray_hit_t){.body = closest->body,
+                     .point = vec_add(origin, vec_multiply(best, direction)),
+                     .distance = best};
+  return true;
+}
+
+bool query_sweep(spatial_index_t *index, vector_t origin, vector_t direction,
+                 double max_distance, double radius, ray_hit_t *hit) {
+  return cast(index, origin, direction, max_distance, radius, hit);
+}
+
+void trajectory_sample(vector_t start, vector_t velocity,
+                       vector_t acceleration, double dt, vector_t *points,
+                       size_t num_points) {
+  for (size_t i = 0; i < num_points; i++) {
+    double t = i * dt;
+    points[i] = (vector_t){
+        start.x + velocity.x * t + 0.5 * acceleration.x * t * t,
+        start.y + velocity.y * t + 0.5 * acceleration.y * t * t};
+  }
+}
@@ -0,0 +1,102 @@
+#ifndef __QUERY_H__
+#define __QUERY_H__
+
+#include "body.h"
+#include "scene.h"
+#include "vector.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Picks the bodies a spatial index holds.
+ *
+ * @param body a live body of the scene
+ * @param aux the aux passed to spatial_index_build()
+ * @return whether the body can be hit by queries
+ */
+typedef bool (*query_filter_t)(body_t *body, void *aux);
+
+/**
+ * The first body a cast reaches.
+ * point is where the centre of the swept circle is when it first touches
+ * the body, distance away from the origin.
+ */
+typedef struct ray_hit {
+  body_t *body;
+  vector_t point;
+  double distance;
+} ray_hit_t;
+
+/**
+ * A uniform grid over the window that buckets bodies by bounding box, so a
+ * cast only tests the bodies in the cells it passes through.
+ * It is rebuilt from the scene whenever the bodies move; its arrays, the
+ * bodies' corners among them, are kept between builds so the index itself
+ * does not allocate once they are big enough. The library still makes a
+ * short-lived copy of each body's shape while it is read.
+ */
+typedef struct spatial_index spatial_index_t;
+
+/**
+ * Allocates an empty spatial index.
+ *
+ * @param window the size of the area covered by the grid; bodies outside it
+ *   are put in the nearest border cells
+ * @param cell_size the width and height of one cell
+ * @return the new index
+ */
+spatial_index_t *spatial_index_init(vector_t window, double cell_size);
+
+/**
+ * Releases the memory of a spatial index.
+ *
+ * @param index a pointer to an index returned from spatial_index_init()
+ */
+void spatial_index_free(spatial_index_t *index);
+
+/**
+ * Replaces the contents of the index with the live bodies of a scene.
+ * The index keeps a copy of each body's corners taken now, so it describes
+ * the scene as it was until the next build.
+ *
+ * @param index a pointer to an index returned from spatial_index_init()
+ * @param scene the scene to index
+ * @param filter picks the bodies to index, or NULL for all of them
+ * @param aux passed to filter
+ */
+void spatial_index_build(spatial_index_t *index, scene_t *scene,
+                         query_filter_t filter, void *aux);
+
+/**
+ * Sweeps a circle along a ray and finds the first indexed body it touches.
+ * This is how far a round projectile gets before it collides. A radius of 0
+ * casts a plain ray.
+ *
+ * @param index a pointer to a built index
+ * @param origin the start of the circle's centre
+ * @param direction the direction of the sweep, of any nonzero length
+ * @param max_distance how far the centre travels
+ * @param radius the radius of the circle
+ * @param hit filled in with the first hit, if there is one
+ * @return whether anything was hit
+ */
+bool query_sweep(spatial_index_t *index, vector_t origin, vector_t direction,
+                 double max_distance, double radius, ray_hit_t *hit);
+
+/**
+ * Samples the path of a point under constant acceleration,
+ * start + velocity t + acceleration t^2 / 2, at t = 0, dt, 2 dt, ...
+ * Nothing is allocated.
+ *
+ * @param start the position at t = 0
+ * @param velocity the velocity at t = 0
+ * @param acceleration the constant acceleration, e.g. gravity
+ * @param dt the time between samples
+ * @param points the buffer the samples are written to
+ * @param num_points the number of samples to write
+ */
+void trajectory_sample(vector_t start, vector_t velocity,
+                       vector_t acceleration, double dt, vector_t *points,
+                       size_t num_points);
+
+#endif // #ifndef __QUERY_H__
@@ -0,0 +1,439 @@
+#include "render.h"
+#include "alloc_track.h"
+#include "asset_pack.h"
+#include "hud.h"
+#include "sdl_wrapper.h"
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const size_t INIT_CAPACITY = 64;
+static const uint64_t SIGNATURE_SEED = 14695981039346656037ULL;
+static const uint64_t SIGNATURE_PRIME = 1099511628211ULL;
+static const double COLOR_SCALE = 255.0;
+static const size_t QUAD_VERTICES = 4;
+static const int QUAD_INDICES[] = {0, 1, 2, 0, 2, 3};
+static const size_t NUM_QUAD_INDICES = 6;
+static const SDL_Color SPRITE_TINT = {255, 255, 255, 255};
+static const size_t TEXTURE_BYTES_PER_PIXEL = 4;
+
+typedef struct texture_entry {
+  char *path;
+  SDL_Texture *texture;
+} texture_entry_t;
+
+// one queued sprite or polygon; its vertices and indices live in the
+// renderer's frame buffers and its indices count from its first vertex
+typedef struct render_item {
+  size_t depth;
+  SDL_Texture *texture;
+  size_t order;
+  size_t first_vertex;
+  size_t num_vertices;
+  size_t first_index;
+  size_t num_indices;
+} render_item_t;
+
+struct renderer {
+  SDL_Renderer *sdl;
+  vector_t window;
+  vector_t scale;
+
+  texture_entry_t *textures;
+  size_t num_textures;
+  size_t textures_capacity;
+
+  snapshot_t *frame;
+
+  render_item_t *items;
+  size_t num_items;
+  size_t items_capacity;
+  SDL_Vertex *vertices;
+  size_t num_vertices;
+  size_t vertices_capacity;
+  int *indices;
+  size_t num_indices;
+  size_t indices_capacity;
+
+  SDL_Vertex *batch_vertices;
+  size_t batch_vertices_capacity;
+  int *batch_indices;
+  size_t batch_indices_capacity;
+
+  SDL_Texture *static_layer;
+  uint64_t static_signature;
+  size_t static_rebuilds;
+  size_t draw_calls;
+
+  hud_t *hud;
+  render_overlay_t overlay;
+  void *overlay_aux;
+};
+
+// grows an array so that it holds at least needed elements
+static void reserve(void **data, size_t *capacity, size_t needed,
+                    size_t element_size) {
+  if (needed <= *capacity) {
+    return;
+  }
+  size_t new_capacity = *capacity == 0 ? INIT_CAPACITY : *capacity;
+  while (new_capacity < needed) {
+    new_capacity *= 2;
+  }
+  *data = realloc(*data, new_capacity * element_size);
+  assert(*data != NULL);
+  *capacity = new_capacity;
+}
+
+renderer_t *renderer_init(SDL_Renderer *sdl, vector_t window) {
+  assert(sdl != NULL);
+  renderer_t *renderer = malloc(sizeof(renderer_t));
+  assert(renderer != NULL);
+  *renderer = (renderer_t){0};
+  renderer->sdl = sdl;
+  renderer->window = window;
+  return renderer;
+}
+
+// textures live in SDL, so they are counted by their dimensions
+static size_t texture_bytes(SDL_Texture *texture) {
+  int width = 0;
+  int height = 0;
+  if (texture != NULL) {
+    SDL_QueryTexture(texture, NULL, NULL, &width, &height);
+  }
+  return (size_t)width * height * TEXTURE_BYTES_PER_PIXEL;
+}
+
+void renderer_free(renderer_t *renderer) {
+  for (size_t i = 0; i < renderer->num_textures; i++) {
+    SDL_Texture *texture = renderer->textures[i].texture;
+    alloc_track_remove(ALLOC_TEXTURE, texture_bytes(texture));
+    SDL_DestroyTexture(texture);
+    free(renderer->textures[i].path);
+  }
+  if (renderer->static_layer != NULL) {
+    alloc_track_remove(ALLOC_TEXTURE, texture_bytes(renderer->static_layer));
+    SDL_DestroyTexture(renderer->static_layer);
+  }
+  if (renderer->hud != NULL) {
+    hud_free(renderer->hud);
+  }
+  free(renderer->textures);
+  free(renderer->items);
+  free(renderer->vertices);
+  free(renderer->indices);
+  free(renderer->batch_vertices);
+  free(renderer->batch_indices);
+  free(renderer);
+}
+
+static void add_texture(renderer_t *renderer, const char *path,
+                        SDL_Texture *texture) {
+  reserve((void **)&renderer->textures, &renderer->textures_capacity,
+          renderer->num_textures + 1, sizeof(texture_entry_t));
+  renderer->textures[renderer->num_textures++] =
+      (texture_entry_t){.path = strdup(path), .texture = texture};
+  alloc_track_add(ALLOC_TEXTURE, texture_bytes(texture));
+}
+
+// textures are decoded the first time a path is drawn and kept afterwards,
+// unless they were already created from an asset pack
+static SDL_Texture *get_texture(renderer_t *renderer, char *path) {
+  for (size_t i = 0; i < renderer->num_textures; i++) {
+    texture_entry_t *entry = &renderer->textures[i];
+    if (!strcmp(entry->path, path)) {
+      return entry->texture;
+    }
+  }
+  SDL_Texture *texture = IMG_LoadTexture(renderer->sdl, path);
+  add_texture(renderer, path, texture);
+  return texture;
+}
+
+void render_preload_pack(renderer_t *renderer, asset_pack_t *pack) {
+  for (size_t i = 0; i < asset_pack_size(pack); i++) {
+    char *path = asset_pack_path(pack, i);
+    SDL_Texture *texture = asset_pack_texture(pack, renderer->sdl, path);
+    if (texture != NULL) {
+      add_texture(renderer, path, texture);
+    }
+  }
+}
+
+bool render_init_hud(renderer_t *renderer, const char *font_path,
+                     int point_size) {
+  renderer->hud = hud_init(renderer->sdl, font_path, point_size);
+  return renderer->hud != NULL;
+}
+
+void render_set_overlay(renderer_t *renderer, render_overlay_t overlay,
+                        void *aux) {
+  renderer->overlay = overlay;
+  renderer->overlay_aux = aux;
+}
+
+// points are in the world, and the window shows it from the camera
+static SDL_FPoint to_screen(renderer_t *renderer, vector_t point) {
+  vector_t camera = renderer->frame->camera;
+  return (SDL_FPoint){
+      (point.x - camera.x) * renderer->scale.x,
+      (renderer->window.y - (point.y - camera.y)) * renderer->scale.y};
+}
+
+static render_item_t *queue_item(renderer_t *renderer, size_t depth,
+                                 SDL_Texture *texture, size_t num_vertices,
+                                 size_t num_indices) {
+  reserve((void **)&renderer->items, &renderer->items_capacity,
+          renderer->num_items + 1, sizeof(render_item_t));
+  reserve((void **)&renderer->vertices, &renderer->vertices_capacity,
+          renderer->num_vertices + num_vertices, sizeof(SDL_Vertex));
+  reserve((void **)&renderer->indices, &renderer->indices_capacity,
+          renderer->num_indices + num_indices, sizeof(int));
+  render_item_t *item = &renderer->items[renderer->num_items];
+  *item = (render_item_t){.depth = depth,
+                          .texture = texture,
+                          .order = renderer->num_items,
+                          .first_vertex = renderer->num_vertices,
+                          .num_vertices = num_vertices,
+                          .first_index = renderer->num_indices,
+                          .num_indices = num_indices};
+  renderer->num_items++;
+  renderer->num_vertices += num_vertices;
+  renderer->num_indices += num_indices;
+  return item;
+}
+
+// a textured quad centred on the centroid and turned by the body's rotation
+static void queue_sprite(renderer_t *renderer, body_pose_t *pose) {
+  render_item_t *item =
+      queue_item(renderer, pose->sprite.depth,
+                 get_texture(renderer, pose->sprite.path), QUAD_VERTICES,
+                 NUM_QUAD_INDICES);
+  vector_t centroid = pose->centroid;
+  double cos_rotation = cos(pose->rotation);
+  double sin_rotation = sin(pose->rotation);
+  double half_width = pose->sprite.size.x / 2;
+  double half_height = pose->sprite.size.y / 2;
+  // corners from the top left of the image, clockwise on screen
+  vector_t corners[] = {{-half_width, half_height},
+                        {half_width, half_height},
+                        {half_width, -half_height},
+                        {-half_width, -half_height}};
+  SDL_FPoint tex_coords[] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+  SDL_Vertex *vertices = &renderer->vertices[item->first_vertex];
+  for (size_t i = 0; i < QUAD_VERTICES; i++) {
+    vector_t corner = {
+        centroid.x + corners[i].x * cos_rotation - corners[i].y * sin_rotation,
+        centroid.y + corners[i].x * sin_rotation + corners[i].y * cos_rotation};
+    vertices[i] = (SDL_Vertex){.position = to_screen(renderer, corner),
+                               .color = SPRITE_TINT,
+                               .tex_coord = tex_coords[i]};
+  }
+  memcpy(&renderer->indices[item->first_index], QUAD_INDICES,
+         sizeof(QUAD_INDICES));
+}
+
+// a triangle fan around the average of the vertices, which is inside every
+// shape the game makes
+static void queue_polygon(renderer_t *renderer, body_pose_t *pose) {
+  size_t num_points = pose->num_points;
+  if (num_points < 3) {
+    return;
+  }
+  render_item_t *item =
+      queue_item(renderer, pose->sprite.depth, NULL, num_points + 1,
+                 num_points * 3);
+  rgb_color_t rgb = pose->color;
+  SDL_Color color = {rgb.r * COLOR_SCALE, rgb.g * COLOR_SCALE,
+                     rgb.b * COLOR_SCALE, COLOR_SCALE};
+  SDL_Vertex *vertices = &renderer->vertices[item->first_vertex];
+  vector_t *shape = &renderer->frame->points[pose->first_point];
+  vector_t centre = VEC_ZERO;
+  for (size_t i = 0; i < num_points; i++) {
+    vector_t *point = &shape[i];
+    centre.x += point->x / num_points;
+    centre.y += point->y / num_points;
+    vertices[i + 1] = (SDL_Vertex){.position = to_screen(renderer, *point),
+                                   .color = color};
+  }
+  vertices[0] =
+      (SDL_Vertex){.position = to_screen(renderer, centre), .color = color};
+  int *indices = &renderer->indices[item->first_index];
+  for (size_t i = 0; i < num_points; i++) {
+    indices[3 * i] = 0;
+    indices[3 * i + 1] = i + 1;
+    indices[3 * i + 2] = (i + 1) % num_points + 1;
+  }
+}
+
+// polygons come before the sprites of their depth and are batched together;
+// sprites of one depth are grouped by texture, and scene order breaks ties
+static int compare_items(const void *a, const void *b) {
+  const render_item_t *item1 = a;
+  const render_item_t *item2 = b;
+  if (item1->depth != item2->depth) {
+    return item1->depth < item2->depth ? -1 : 1;
+  }
+  uintptr_t texture1 = (uintptr_t)item1->texture;
+  uintptr_t texture2 = (uintptr_t)item2->texture;
+  if (texture1 != texture2) {
+    return texture1 < texture2 ? -1 : 1;
+  }
+  return item1->order < item2->order ? -1 : item1->order > item2->order;
+}
+
+// items are sorted so that a depth is drawn over the depths below it and
+// each texture of a depth is one run
+static void queue_layer(renderer_t *renderer, layer_t layer) {
+  renderer->num_items = 0;
+  renderer->num_vertices = 0;
+  renderer->num_indices = 0;
+  snapshot_t *frame = renderer->frame;
+  for (size_t i = 0; i < frame->num_poses; i++) {
+    body_pose_t *pose = &frame->poses[i];
+    if (pose->sprite.layer != layer) {
+      continue;
+    }
+    if (pose->sprite.path == NULL) {
+      queue_polygon(renderer, pose);
+    } else {
+      queue_sprite(renderer, pose);
+    }
+  }
+  qsort(renderer->items, renderer->num_items, sizeof(render_item_t),
+        compare_items);
+}
+
+// submits the sorted queue with one geometry call per run of items that
+// share a depth and a texture
+static void submit_queue(renderer_t *renderer) {
+  size_t start = 0;
+  while (start < renderer->num_items) {
+    SDL_Texture *texture = renderer->items[start].texture;
+    size_t end = start;
+    size_t run_vertices = 0;
+    size_t run_indices = 0;
+    size_t depth = renderer->items[start].depth;
+    while (end < renderer->num_items &&
+           renderer->items[end].texture == texture &&
+           renderer->items[end].depth == depth) {
+      run_vertices += renderer->items[end].num_vertices;
+      run_indices += renderer->items[end].num_indices;
+      end++;
+    }
+    reserve((void **)&renderer->batch_vertices,
+            &renderer->batch_vertices_capacity, run_vertices,
+            sizeof(SDL_Vertex));
+    reserve((void **)&renderer->batch_indices,
+            &renderer->batch_indices_capacity, run_indices, sizeof(int));
+
+    size_t num_vertices = 0;
+    size_t num_indices = 0;
+    for (size_t i = start; i < end; i++) {
+      render_item_t *item = &renderer->items[i];
+      memcpy(&renderer->batch_vertices[num_vertices],
+             &renderer->vertices[item->first_vertex],
+             item->num_vertices * sizeof(SDL_Vertex));
+      for (size_t j = 0; j < item->num_indices; j++) {
+        renderer->batch_indices[num_indices + j] =
+            renderer->indices[item->first_index + j] + num_vertices;
+      }
+      num_vertices += item->num_vertices;
+      num_indices += item->num_indices;
+    }
+    SDL_RenderGeometry(renderer->sdl, texture, renderer->batch_vertices,
+                       num_vertices, renderer->batch_indices, num_indices);
+    renderer->draw_calls++;
+    start = end;
+  }
+}
+
+static uint64_t mix(uint64_t signature, const void *data, size_t size) {
+  const unsigned char *bytes = data;
+  for (size_t i = 0; i < size; i++) {
+    signature = (signature ^ bytes[i]) * SIGNATURE_PRIME;
+  }
+  return signature;
+}
+
+// identifies the static layer by which bodies are on it and where they are
+// in the window, so a scrolling camera redraws it
+static uint64_t static_signature(renderer_t *renderer) {
+  uint64_t signature = SIGNATURE_SEED;
+  snapshot_t *frame = renderer->frame;
+  signature = mix(signature, &frame->camera, sizeof(vector_t));
+  for (size_t i = 0; i < frame->num_poses; i++) {
+    body_pose_t *pose = &frame->poses[i];
+    if (pose->sprite.layer != LAYER_STATIC) {
+      continue;
+    }
+    signature = mix(signature, &pose->id, sizeof(void *));
+    signature = mix(signature, &pose->sprite.path, sizeof(char *));
+    signature = mix(signature, &pose->centroid, sizeof(vector_t));
+    signature = mix(signature, &pose->rotation, sizeof(double));
+  }
+  return signature;
+}
+
+static void rebuild_static_layer(renderer_t *renderer) {
+  if (renderer->static_layer == NULL) {
+    int width, height;
+    SDL_GetRendererOutputSize(renderer->sdl, &width, &height);
+    renderer->static_layer =
+        SDL_CreateTexture(renderer->sdl, SDL_PIXELFORMAT_RGBA8888,
+                          SDL_TEXTUREACCESS_TARGET, width, height);
+    assert(renderer->static_layer != NULL);
+    alloc_track_add(ALLOC_TEXTURE, texture_bytes(renderer->static_layer));
+  }
+  SDL_SetRenderTarget(renderer->sdl, renderer->static_layer);
+  sdl_clear();
+  queue_layer(renderer, LAYER_STATIC);
+  submit_queue(renderer);
+  SDL_SetRenderTarget(renderer->sdl, NULL);
+  renderer->static_rebuilds++;
+}
+
+void render_snapshot(renderer_t *renderer, snapshot_t *snapshot) {
+  int width, height;
+  SDL_GetRendererOutputSize(renderer->sdl, &width, &height);
+  renderer->scale = (vector_t){width / renderer->window.x,
+                               height / renderer->window.y};
+  renderer->draw_calls = 0;
+  renderer->frame = snapshot;
+
+  uint64_t signature = static_signature(renderer);
+  if (renderer->static_layer == NULL ||
+      signature != renderer->static_signature) {
+    rebuild_static_layer(renderer);
+    renderer->static_signature = signature;
+  }
+
+  sdl_clear();
+  SDL_RenderCopy(renderer->sdl, renderer->static_layer, NULL, NULL);
+  renderer->draw_calls++;
+  queue_layer(renderer, LAYER_DYNAMIC);
+  submit_queue(renderer);
+  if (renderer->hud != NULL && snapshot->hud.visible) {
+    hud_draw(renderer->hud, &snapshot->hud);
+    renderer->draw_calls++;
+  }
+  if (renderer->overlay != NULL) {
+    renderer->overlay(renderer->overlay_aux);
+  }
+  sdl_show();
+}
+
+size_t render_static_rebuilds(renderer_t *renderer) {
+  return renderer->static_rebuilds;
+}
+
+size_t render_draw_calls(renderer_t *renderer) { return renderer->draw_calls; }
+
+size_t render_hud_layouts(renderer_t *renderer) {
+  return renderer->hud != NULL ? hud_layouts(renderer->hud) : 0;
+}
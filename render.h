@@ -0,0 +1,109 @@
+#ifndef __RENDER_H__
+#define __RENDER_H__
+
+#include "asset_pack.h"
+#include "snapshot.h"
+#include "vector.h"
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct renderer renderer_t;
+
+/**
+ * Creates a renderer that draws into the window made by sdl_init().
+ *
+ * @param sdl the window's renderer, from sdl_get_renderer()
+ * @param window the size of the scene in scene coordinates
+ * @return the new renderer
+ */
+renderer_t *renderer_init(SDL_Renderer *sdl, vector_t window);
+
+/**
+ * Releases the textures and memory of a renderer.
+ *
+ * @param renderer a pointer to a renderer returned from renderer_init()
+ */
+void renderer_free(renderer_t *renderer);
+
+/**
+ * Creates a texture for every image of an asset pack, so that drawing those
+ * images never decodes a PNG. Images missing from the pack are still loaded
+ * from their files when first drawn. The pack can be closed afterwards.
+ *
+ * @param renderer a pointer to a renderer returned from renderer_init()
+ * @param pack a pointer to a pack returned from asset_pack_open()
+ */
+void render_preload_pack(renderer_t *renderer, asset_pack_t *pack);
+
+/**
+ * Makes the HUD that shows the numbers of each snapshot over the scene.
+ * Without it, snapshots are drawn with no text.
+ *
+ * @param renderer a pointer to a renderer returned from renderer_init()
+ * @param font_path the path of the TrueType font the HUD is drawn in
+ * @param point_size the size of the text in output pixels
+ * @return whether the font could be opened
+ */
+bool render_init_hud(renderer_t *renderer, const char *font_path,
+                     int point_size);
+
+/**
+ * Draws over a frame after everything else and before it is shown.
+ *
+ * @param aux the aux passed to render_set_overlay()
+ */
+typedef void (*render_overlay_t)(void *aux);
+
+/**
+ * Sets what is drawn over every frame, such as the profiler overlay.
+ *
+ * @param renderer a pointer to a renderer returned from renderer_init()
+ * @param overlay the drawing function, or NULL for none
+ * @param aux passed to overlay
+ */
+void render_set_overlay(renderer_t *renderer, render_overlay_t overlay,
+                        void *aux);
+
+/**
+ * Clears the window, draws every body of a snapshot and shows the frame.
+ * The bodies of a layer are sorted by depth and, within a depth, polygons
+ * before sprites and sprites by texture, keeping scene order among bodies
+ * that share a texture. Each depth's polygons and each texture of a depth are
+ * then one geometry call, so a frame costs about one call per depth and
+ * image however many bodies use them. The HUD, if there is one and the
+ * snapshot's values are visible, and then the overlay are drawn last.
+ * Only the snapshot is read, so the scene it was taken from can keep
+ * changing on another thread.
+ *
+ * @param renderer a pointer to a renderer returned from renderer_init()
+ * @param snapshot the snapshot to draw
+ */
+void render_snapshot(renderer_t *renderer, snapshot_t *snapshot);
+
+/**
+ * Gets how many times the static layer has been redrawn.
+ *
+ * @param renderer a pointer to a renderer returned from renderer_init()
+ * @return the number of static layer rebuilds
+ */
+size_t render_static_rebuilds(renderer_t *renderer);
+
+/**
+ * Gets how many draw calls the last frame took.
+ *
+ * @param renderer a pointer to a renderer returned from renderer_init()
+ * @return the number of draw calls of the last render_snapshot()
+ */
+size_t render_draw_calls(renderer_t *renderer);
+
+/**
+ * Gets how many times the HUD text has been laid out again because the
+ * numbers it shows changed.
+ *
+ * @param renderer a pointer to a renderer returned from renderer_init()
+ * @return the number of HUD layouts, 0 without a HUD
+ */
+size_t render_hud_layouts(renderer_t *renderer);
+
+#endif // #ifndef __RENDER_H__
@@ -0,0 +1,520 @@
+// Headless balancing tool that plays many sessions of one level at once.
+//
+//   rollout -l 2 -n 10000 -p random
+//
+// Every session gets its own state, seed and input policy and is stepped at a
+// fixed tick until it leaves the level or runs out of ticks. The sessions are
+// shared between one thread per core and the results are summarised at the
+// end, so a constant like GRAVITY2 or a spawn interval in for_levels/ can be
+// retuned, rebuilt and compared without hand-playing. Objects a level leaves
+// allocated after its scene is freed are counted per session, and -m prints
+// the allocation counts of every subsystem at the end. -l wide plays the wide
+// level, which scrolls and streams its bodies by chunk.
+//
+// -c also prepares each tick's snapshot, times every phase of the loop and,
+// where the kernel allows perf_event_open(), counts cycles, instructions,
+// cache misses and branch misses per phase and per number of bodies. The
+// counters follow the thread a session runs on, so they are exact for each
+// session even with many threads.
+//
+// -v plays every session twice, checking contacts on a one-thread pool and
+// then on a pool with one thread per core, and compares a fingerprint of
+// every body after every tick. The workers play the one-thread runs, and the
+// parallel runs are replayed one after another once they finish, so only one
+// pool of threads exists at a time. Any session whose runs differ is reported
+// and makes the tool exit with an error.
+#include "alloc_track.h"
+#include "hoppergame.h"
+#include "perf_counters.h"
+#include "pool.h"
+#include "profiler.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static const double TICK = 1.0 / 60.0;
+static const size_t DEFAULT_SESSIONS = 1000;
+static const size_t DEFAULT_MAX_TICKS = 60 * 60 * 3;
+static const uint32_t DEFAULT_SEED = 1;
+static const uint64_t FINGERPRINT_PRIME = 1099511628211ULL;
+
+// the random policy presses a key on about one tick in RANDOM_PRESS_ODDS
+static const uint32_t RANDOM_PRESS_ODDS = 8;
+static const double MAX_HELD_TIME = 1.0;
+// the scripted policy repeats a fixed pattern every SCRIPT_PERIOD ticks
+static const size_t SCRIPT_PERIOD = 60;
+
+// frames are also grouped by how many bodies the scene had, each bucket
+// holding counts up to but not including its limit
+static const size_t BODY_BUCKET_LIMITS[] = {16, 32, 64, 128, SIZE_MAX};
+#define NUM_BODY_BUCKETS 5
+
+static const char POLICY_KEYS[] = {SPACE, UP_ARROW, DOWN_ARROW, LEFT_ARROW,
+                                   RIGHT_ARROW};
+static const size_t NUM_POLICY_KEYS = sizeof(POLICY_KEYS);
+
+typedef enum { POLICY_IDLE, POLICY_RANDOM, POLICY_SCRIPTED } policy_t;
+
+typedef enum { OUTCOME_PASSED, OUTCOME_FAILED, OUTCOME_TIMEOUT } outcome_t;
+
+// the time and hardware events of a number of frames
+typedef struct frame_totals {
+  size_t frames;
+  double ms;
+  uint64_t counters[NUM_COUNTERS];
+} frame_totals_t;
+
+typedef struct profile {
+  frame_totals_t phases[NUM_PHASES];
+  frame_totals_t buckets[NUM_BODY_BUCKETS];
+} profile_t;
+
+typedef struct result {
+  outcome_t outcome;
+  double score;
+  size_t ticks;
+  size_t leaks;
+  // every tick's fingerprint folded together, when checking pools
+  uint64_t fingerprint;
+  bool diverged;
+  profile_t profile;
+} result_t;
+
+typedef struct rollout {
+  double level;
+  policy_t policy;
+  size_t num_sessions;
+  size_t max_ticks;
+  uint32_t seed;
+  bool profile;
+  bool verify;
+  atomic_size_t next_session;
+  // set by the workers, whose counters the kernel may allow or not
+  atomic_bool counted;
+  bool available[NUM_COUNTERS];
+  result_t *results;
+} rollout_t;
+
+// the policies draw from their own generator so that input never disturbs
+// the level layout of the session's seed
+static uint32_t next_random(uint32_t *x) {
+  *x ^= *x << 13;
+  *x ^= *x >> 17;
+  *x ^= *x << 5;
+  return *x;
+}
+
+static void press(state_t *state, char key, double held_time) {
+  game_key(state, key, KEY_PRESSED, held_time);
+  game_key(state, key, KEY_RELEASED, held_time);
+}
+
+static void apply_policy(rollout_t *rollout, state_t *state, size_t tick,
+                         uint32_t *random) {
+  switch (rollout->policy) {
+  case POLICY_IDLE:
+    break;
+  case POLICY_RANDOM:
+    if (next_random(random) % RANDOM_PRESS_ODDS == 0) {
+      char key = POLICY_KEYS[next_random(random) % NUM_POLICY_KEYS];
+      double held_time =
+          MAX_HELD_TIME * (next_random(random) % 1000) / 1000.0;
+      press(state, key, held_time);
+    }
+    break;
+  case POLICY_SCRIPTED:
+    // launch, then nudge the hopper, lily pad or bounce upwards
+    if (tick % SCRIPT_PERIOD == 0) {
+      press(state, SPACE, TICK);
+    } else if (tick % SCRIPT_PERIOD == SCRIPT_PERIOD / 2) {
+      press(state, UP_ARROW, TICK * SCRIPT_PERIOD);
+    } else if (tick % SCRIPT_PERIOD == SCRIPT_PERIOD / 4) {
+      press(state, LEFT_ARROW, TICK * SCRIPT_PERIOD);
+    }
+    break;
+  }
+}
+
+static size_t body_bucket(size_t bodies) {
+  size_t bucket = 0;
+  while (bodies >= BODY_BUCKET_LIMITS[bucket]) {
+    bucket++;
+  }
+  return bucket;
+}
+
+// adds the frame the profiler recorded last
+static void add_frame(profile_t *profile, profiler_t *profiler) {
+  frame_sample_t *sample =
+      profiler_get_sample(profiler, profiler_samples(profiler) - 1);
+  frame_totals_t *bucket = &profile->buckets[body_bucket(sample->bodies)];
+  bucket->frames++;
+  bucket->ms += sample->frame_ms;
+  for (size_t phase = 0; phase < NUM_PHASES; phase++) {
+    frame_totals_t *totals = &profile->phases[phase];
+    totals->frames++;
+    totals->ms += sample->phase_ms[phase];
+    for (size_t i = 0; i < NUM_COUNTERS; i++) {
+      totals->counters[i] += sample->phase_counters[phase][i];
+      bucket->counters[i] += sample->phase_counters[phase][i];
+    }
+  }
+}
+
+static result_t play_session(rollout_t *rollout, size_t index,
+                             perf_counters_t *counters, pool_t *pool) {
+  uint32_t seed = rollout->seed + (uint32_t)index * 2654435761u;
+  state_t *state = game_session_init(seed);
+  if (state == NULL) {
+    exit(1);
+  }
+  game_set_pool(state, pool);
+  uint32_t random = seed ^ 0x9e3779b9u;
+  if (random == 0) {
+    random = 1;
+  }
+  game_start_level(state, rollout->level);
+  profiler_t *profiler = game_profiler(state);
+  profiler_set_counters(profiler, counters);
+
+  result_t result = {.outcome = OUTCOME_TIMEOUT};
+  size_t tick = 0;
+  while (tick < rollout->max_ticks &&
+         game_active_level(state) == rollout->level) {
+    apply_policy(rollout, state, tick, &random);
+    if (rollout->profile) {
+      game_profile_frame(state, TICK);
+      add_frame(&result.profile, profiler);
+    } else {
+      game_step(state, TICK);
+    }
+    if (rollout->verify) {
+      result.fingerprint = (result.fingerprint ^ game_fingerprint(state)) *
+                           FINGERPRINT_PRIME;
+    }
+    tick++;
+  }
+  profiler_set_counters(profiler, NULL);
+  if (game_active_level(state) != rollout->level) {
+    result.outcome =
+        game_active_level(state) == FAIL ? OUTCOME_FAILED : OUTCOME_PASSED;
+  }
+  result.score = game_score(state);
+  result.ticks = tick;
+  // the last level is only checked when its scene goes, so go back to the
+  // start screen first
+  game_start_level(state, LEVEL1_RULES);
+  result.leaks = game_level_leaks(state);
+  game_session_free(state);
+  return result;
+}
+
+// sessions are claimed one at a time, so a slow session never leaves the
+// other threads idle at the end
+static void *run_worker(void *aux) {
+  rollout_t *rollout = aux;
+  perf_counters_t *counters = NULL;
+  if (rollout->profile) {
+    counters = perf_counters_open();
+  }
+  pool_t *serial = NULL;
+  if (rollout->verify) {
+    serial = pool_init(1);
+  }
+  // every thread opens the same counters, so the first one to get any
+  // reports which
+  if (counters != NULL && !atomic_exchange(&rollout->counted, true)) {
+    for (size_t i = 0; i < NUM_COUNTERS; i++) {
+      rollout->available[i] = perf_counters_available(counters, i);
+    }
+  }
+  while (true) {
+    size_t index = atomic_fetch_add(&rollout->next_session, 1);
+    if (index >= rollout->num_sessions) {
+      break;
+    }
+    result_t *result = &rollout->results[index];
+    *result = play_session(rollout, index, counters, serial);
+  }
+  if (counters != NULL) {
+    perf_counters_close(counters);
+  }
+  if (rollout->verify) {
+    pool_free(serial);
+  }
+  return NULL;
+}
+
+// replays every session on one pool with a thread per core; a pool per
+// worker would start a thread per core on every core
+static void verify_sessions(rollout_t *rollout) {
+  pool_t *parallel = pool_init(0);
+  for (size_t i = 0; i < rollout->num_sessions; i++) {
+    result_t *result = &rollout->results[i];
+    result_t check = play_session(rollout, i, NULL, parallel);
+    result->diverged = check.fingerprint != result->fingerprint;
+  }
+  pool_free(parallel);
+}
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static double percentile(double *sorted, size_t count, double fraction) {
+  if (count == 0) {
+    return 0;
+  }
+  return sorted[(size_t)(fraction * (count - 1))];
+}
+
+static void report(rollout_t *rollout) {
+  size_t count = rollout->num_sessions;
+  size_t outcomes[3] = {0};
+  double *scores = malloc(count * sizeof(double));
+  double *ticks = malloc(count * sizeof(double));
+  size_t num_passed = 0;
+  size_t num_leaking = 0;
+  size_t leaks = 0;
+  double score_sum = 0;
+  for (size_t i = 0; i < count; i++) {
+    result_t *result = &rollout->results[i];
+    outcomes[result->outcome]++;
+    scores[i] = result->score;
+    score_sum += result->score;
+    leaks += result->leaks;
+    num_leaking += result->leaks > 0;
+    if (result->outcome == OUTCOME_PASSED) {
+      ticks[num_passed++] = result->ticks;
+    }
+  }
+  double score_mean = score_sum / count;
+  double variance = 0;
+  for (size_t i = 0; i < count; i++) {
+    variance += (scores[i] - score_mean) * (scores[i] - score_mean);
+  }
+  qsort(scores, count, sizeof(double), compare_doubles);
+  qsort(ticks, num_passed, sizeof(double), compare_doubles);
+
+  printf("sessions:   %zu\n", count);
+  printf("passed:     %zu (%.1f%%)\n", outcomes[OUTCOME_PASSED],
+         100.0 * outcomes[OUTCOME_PASSED] / count);
+  printf("failed:     %zu (%.1f%%)\n", outcomes[OUTCOME_FAILED],
+         100.0 * outcomes[OUTCOME_FAILED] / count);
+  printf("timed out:  %zu (%.1f%%)\n", outcomes[OUTCOME_TIMEOUT],
+         100.0 * outcomes[OUTCOME_TIMEOUT] / count);
+  printf("score:      mean %.1f, stddev %.1f, min %.1f, max %.1f\n",
+         score_mean, sqrt(variance / count), scores[0], scores[count - 1]);
+  printf("            p10 %.1f, p50 %.1f, p90 %.1f\n",
+         percentile(scores, count, 0.1), percentile(scores, count, 0.5),
+         percentile(scores, count, 0.9));
+  printf("leaked:     %zu objects in %zu sessions\n", leaks, num_leaking);
+  if (num_passed > 0) {
+    printf("ticks to finish: p10 %.0f, p50 %.0f, p90 %.0f\n",
+           percentile(ticks, num_passed, 0.1),
+           percentile(ticks, num_passed, 0.5),
+           percentile(ticks, num_passed, 0.9));
+  }
+  free(scores);
+  free(ticks);
+}
+
+// lists the sessions whose parallel run differed from the serial one
+static size_t report_divergence(rollout_t *rollout) {
+  size_t diverged = 0;
+  for (size_t i = 0; i < rollout->num_sessions; i++) {
+    if (rollout->results[i].diverged) {
+      printf("session %zu differs between serial and parallel contacts\n", i);
+      diverged++;
+    }
+  }
+  printf("parallel:   %zu of %zu sessions differ from serial\n", diverged,
+         rollout->num_sessions);
+  return diverged;
+}
+
+static void report_totals(rollout_t *rollout, const char *name,
+                          frame_totals_t *totals) {
+  if (totals->frames == 0) {
+    return;
+  }
+  printf("  %-10s %8zu %9.4f", name, totals->frames,
+         totals->ms / totals->frames);
+  for (size_t i = 0; i < NUM_COUNTERS; i++) {
+    if (rollout->available[i]) {
+      printf(" %14.0f", (double)totals->counters[i] / totals->frames);
+    } else {
+      printf(" %14s", "-");
+    }
+  }
+  uint64_t cycles = totals->counters[COUNTER_CYCLES];
+  if (rollout->available[COUNTER_INSTRUCTIONS] && cycles > 0) {
+    printf(" %5.2f", (double)totals->counters[COUNTER_INSTRUCTIONS] / cycles);
+  }
+  printf("\n");
+}
+
+static void report_header(const char *title) {
+  printf("%-12s %8s %9s", title, "ticks", "ms/tick");
+  for (size_t i = 0; i < NUM_COUNTERS; i++) {
+    printf(" %14s", perf_counter_name(i));
+  }
+  printf(" %5s\n", "ipc");
+}
+
+static void add_totals(frame_totals_t *to, frame_totals_t *from) {
+  to->frames += from->frames;
+  to->ms += from->ms;
+  for (size_t i = 0; i < NUM_COUNTERS; i++) {
+    to->counters[i] += from->counters[i];
+  }
+}
+
+// counts are per tick, summed over every session
+static void report_profile(rollout_t *rollout) {
+  profile_t total = {0};
+  for (size_t i = 0; i < rollout->num_sessions; i++) {
+    profile_t *profile = &rollout->results[i].profile;
+    for (size_t phase = 0; phase < NUM_PHASES; phase++) {
+      add_totals(&total.phases[phase], &profile->phases[phase]);
+    }
+    for (size_t bucket = 0; bucket < NUM_BODY_BUCKETS; bucket++) {
+      add_totals(&total.buckets[bucket], &profile->buckets[bucket]);
+    }
+  }
+  if (!atomic_load(&rollout->counted)) {
+    printf("hardware counters unavailable, timing only\n");
+  }
+  report_header("phase");
+  for (size_t phase = 0; phase < NUM_PHASES; phase++) {
+    report_totals(rollout, profiler_phase_name(phase), &total.phases[phase]);
+  }
+  report_header("bodies");
+  for (size_t bucket = 0; bucket < NUM_BODY_BUCKETS; bucket++) {
+    char name[32];
+    size_t low = bucket == 0 ? 0 : BODY_BUCKET_LIMITS[bucket - 1];
+    if (BODY_BUCKET_LIMITS[bucket] == SIZE_MAX) {
+      snprintf(name, sizeof(name), "%zu+", low);
+    } else {
+      snprintf(name, sizeof(name), "%zu-%zu", low,
+               BODY_BUCKET_LIMITS[bucket] - 1);
+    }
+    report_totals(rollout, name, &total.buckets[bucket]);
+  }
+}
+
+static bool parse_policy(const char *name, policy_t *policy) {
+  if (!strcmp(name, "idle")) {
+    *policy = POLICY_IDLE;
+  } else if (!strcmp(name, "random")) {
+    *policy = POLICY_RANDOM;
+  } else if (!strcmp(name, "scripted")) {
+    *policy = POLICY_SCRIPTED;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  rollout_t rollout = {.level = LEVEL1,
+                       .policy = POLICY_RANDOM,
+                       .num_sessions = DEFAULT_SESSIONS,
+                       .max_ticks = DEFAULT_MAX_TICKS,
+                       .seed = DEFAULT_SEED};
+  long num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  bool memory_report = false;
+  int option;
+  while ((option = getopt(argc, argv, "l:n:j:p:t:s:mcv")) != -1) {
+    switch (option) {
+    case 'l': {
+      const double levels[] = {LEVEL1, LEVEL2, LEVEL3};
+      int level = atoi(optarg);
+      if (strcmp(optarg, "wide") == 0) {
+        rollout.level = WIDE_LEVEL;
+        break;
+      }
+      if (level < 1 || level > 3) {
+        fprintf(stderr, "rollout: level must be 1, 2, 3 or wide\n");
+        return 1;
+      }
+      rollout.level = levels[level - 1];
+      break;
+    }
+    case 'n':
+      rollout.num_sessions = strtoul(optarg, NULL, 10);
+      break;
+    case 'j':
+      num_threads = atol(optarg);
+      break;
+    case 'p':
+      if (!parse_policy(optarg, &rollout.policy)) {
+        fprintf(stderr, "rollout: unknown policy %s\n", optarg);
+        return 1;
+      }
+      break;
+    case 't':
+      rollout.max_ticks = strtoul(optarg, NULL, 10);
+      break;
+    case 's':
+      rollout.seed = strtoul(optarg, NULL, 10);
+      break;
+    case 'm':
+      memory_report = true;
+      break;
+    case 'c':
+      rollout.profile = true;
+      break;
+    case 'v':
+      rollout.verify = true;
+      break;
+    default:
+      fprintf(stderr,
+              "usage: %s [-l level] [-n sessions] [-j threads] "
+              "[-p idle|random|scripted] [-t max ticks] [-s seed] [-m] "
+              "[-c] [-v]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+  if (rollout.num_sessions == 0) {
+    return 0;
+  }
+  if (num_threads < 1) {
+    num_threads = 1;
+  }
+
+  rollout.results = calloc(rollout.num_sessions, sizeof(result_t));
+  atomic_init(&rollout.next_session, 0);
+  atomic_init(&rollout.counted, false);
+  pthread_t *threads = malloc(num_threads * sizeof(pthread_t));
+  for (long i = 0; i < num_threads; i++) {
+    pthread_create(&threads[i], NULL, run_worker, &rollout);
+  }
+  for (long i = 0; i < num_threads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  report(&rollout);
+  size_t diverged = 0;
+  if (rollout.verify) {
+    verify_sessions(&rollout);
+    diverged = report_divergence(&rollout);
+  }
+  if (rollout.profile) {
+    report_profile(&rollout);
+  }
+  if (memory_report) {
+    alloc_track_report(stdout);
+  }
+  free(threads);
+  free(rollout.results);
+  return diverged > 0 ? 1 : 0;
+}
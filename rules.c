@@ -0,0 +1,280 @@
+#include "rules.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const size_t INIT_RULES_CAPACITY = 16;
+
+// three wheels of 64 slots reach 64^3 ticks, about 73 minutes at 60 Hz;
+// longer timers wait in the last slot of the top wheel and are placed again
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_LEVELS 3
+static const size_t NO_TIMER = SIZE_MAX;
+
+typedef struct trigger {
+  rule_trigger_t trigger;
+  const char *kind;
+  const char *other;
+  trigger_handler_t handler;
+} trigger_t;
+
+// a timer with a NULL handler was cancelled and is freed when its slot comes
+typedef struct rule_timer {
+  size_t expires;
+  timer_handler_t handler;
+  size_t next;
+} rule_timer_t;
+
+struct rules {
+  trigger_t *triggers;
+  size_t num_triggers;
+  size_t trigger_capacity;
+
+  rule_event_t *events;
+  size_t num_events;
+  size_t event_capacity;
+
+  rule_timer_t *timers;
+  size_t num_timers;
+  size_t timer_capacity;
+  size_t free_timers;
+  size_t wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+  size_t now;
+  // the wheel turns once per tick_length of simulated time, and pending is
+  // the time since its last turn
+  double tick_length;
+  double pending;
+
+  // bumped by rules_clear(), so a dispatch can tell its level has ended
+  size_t generation;
+};
+
+static void *reserve(void *array, size_t *capacity, size_t size,
+                     size_t element_size) {
+  if (size < *capacity) {
+    return array;
+  }
+  *capacity *= 2;
+  array = realloc(array, *capacity * element_size);
+  assert(array != NULL);
+  return array;
+}
+
+static void clear_wheel(rules_t *rules) {
+  for (size_t level = 0; level < WHEEL_LEVELS; level++) {
+    for (size_t slot = 0; slot < WHEEL_SLOTS; slot++) {
+      rules->wheel[level][slot] = NO_TIMER;
+    }
+  }
+  rules->num_timers = 0;
+  rules->free_timers = NO_TIMER;
+}
+
+rules_t *rules_init(double tick_length) {
+  assert(tick_length > 0);
+  rules_t *rules = malloc(sizeof(rules_t));
+  assert(rules != NULL);
+  *rules = (rules_t){.tick_length = tick_length,
+                     .trigger_capacity = INIT_RULES_CAPACITY,
+                     .event_capacity = INIT_RULES_CAPACITY,
+                     .timer_capacity = INIT_RULES_CAPACITY};
+  rules->triggers = malloc(rules->trigger_capacity * sizeof(trigger_t));
+  rules->events = malloc(rules->event_capacity * sizeof(rule_event_t));
+  rules->timers = malloc(rules->timer_capacity * sizeof(rule_timer_t));
+  assert(rules->triggers != NULL && rules->events != NULL &&
+         rules->timers != NULL);
+  clear_wheel(rules);
+  return rules;
+}
+
+void rules_free(rules_t *rules) {
+  free(rules->triggers);
+  free(rules->events);
+  free(rules->timers);
+  free(rules);
+}
+
+void rules_clear(rules_t *rules) {
+  rules->num_triggers = 0;
+  rules->num_events = 0;
+  clear_wheel(rules);
+  rules->generation++;
+}
+
+void rules_on(rules_t *rules, rule_trigger_t trigger, const char *kind,
+              const char *other, trigger_handler_t handler) {
+  rules->triggers = reserve(rules->triggers, &rules->trigger_capacity,
+                            rules->num_triggers, sizeof(trigger_t));
+  rules->triggers[rules->num_triggers++] = (trigger_t){
+      .trigger = trigger, .kind = kind, .other = other, .handler = handler};
+}
+
+static void queue_event(rules_t *rules, rule_event_t event) {
+  rules->events = reserve(rules->events, &rules->event_capacity,
+                          rules->num_events, sizeof(rule_event_t));
+  rules->events[rules->num_events++] = event;
+}
+
+// the string a trigger was registered with that equals a body's info, or
+// NULL when no trigger of that kind names it
+static const char *registered(rules_t *rules, rule_trigger_t trigger,
+                              const char *info, bool other) {
+  for (size_t i = 0; i < rules->num_triggers; i++) {
+    trigger_t *candidate = &rules->triggers[i];
+    const char *name = other ? candidate->other : candidate->kind;
+    if (candidate->trigger == trigger && name != NULL && !strcmp(name, info)) {
+      return name;
+    }
+  }
+  return NULL;
+}
+
+void rules_contact(rules_t *rules, body_t *body1, body_t *body2) {
+  const char *kind =
+      registered(rules, RULE_CONTACT, body_get_info(body1), false);
+  if (kind == NULL) {
+    return;
+  }
+  queue_event(rules, (rule_event_t){.trigger = RULE_CONTACT,
+                                    .kind = kind,
+                                    .other = registered(rules, RULE_CONTACT,
+                                                        body_get_info(body2),
+                                                        true),
+                                    .score = body_get_score(body2)});
+}
+
+void rules_destroyed(rules_t *rules, body_t *body) {
+  const char *kind =
+      registered(rules, RULE_DESTROYED, body_get_info(body), false);
+  if (kind == NULL) {
+    return;
+  }
+  queue_event(rules, (rule_event_t){.trigger = RULE_DESTROYED,
+                                    .kind = kind,
+                                    .score = body_get_score(body)});
+}
+
+// a timer goes in the lowest wheel whose range covers it, in the slot of its
+// expiry, and moves down a wheel each time the wheel below wraps into it
+static void place_timer(rules_t *rules, size_t index) {
+  rule_timer_t *timer = &rules->timers[index];
+  size_t delta = timer->expires - rules->now;
+  size_t level = 0;
+  while (level < WHEEL_LEVELS - 1 &&
+         delta >= (size_t)1 << (WHEEL_BITS * (level + 1))) {
+    level++;
+  }
+  size_t slot = (timer->expires >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1);
+  if (delta >= (size_t)1 << (WHEEL_BITS * WHEEL_LEVELS)) {
+    // the slot the top wheel reaches last
+    slot = ((rules->now >> (WHEEL_BITS * level)) - 1) & (WHEEL_SLOTS - 1);
+  }
+  timer->next = rules->wheel[level][slot];
+  rules->wheel[level][slot] = index;
+}
+
+void rules_after(rules_t *rules, size_t ticks, timer_handler_t handler) {
+  size_t index = rules->free_timers;
+  if (index != NO_TIMER) {
+    rules->free_timers = rules->timers[index].next;
+  } else {
+    rules->timers = reserve(rules->timers, &rules->timer_capacity,
+                            rules->num_timers, sizeof(rule_timer_t));
+    index = rules->num_timers++;
+  }
+  rules->timers[index] = (rule_timer_t){
+      .expires = rules->now + (ticks > 0 ? ticks : 1), .handler = handler};
+  place_timer(rules, index);
+}
+
+void rules_cancel(rules_t *rules, timer_handler_t handler) {
+  for (size_t i = 0; i < rules->num_timers; i++) {
+    if (rules->timers[i].handler == handler) {
+      rules->timers[i].handler = NULL;
+    }
+  }
+}
+
+static void release_timer(rules_t *rules, size_t index) {
+  rules->timers[index].handler = NULL;
+  rules->timers[index].next = rules->free_timers;
+  rules->free_timers = index;
+}
+
+static void cascade(rules_t *rules, size_t level) {
+  size_t slot = (rules->now >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1);
+  size_t index = rules->wheel[level][slot];
+  rules->wheel[level][slot] = NO_TIMER;
+  while (index != NO_TIMER) {
+    size_t next = rules->timers[index].next;
+    if (rules->timers[index].handler == NULL) {
+      release_timer(rules, index);
+    } else {
+      place_timer(rules, index);
+    }
+    index = next;
+  }
+}
+
+static void advance_timers(rules_t *rules, void *aux) {
+  rules->now++;
+  // higher wheels first, so a timer can fall through several in one tick
+  for (size_t level = WHEEL_LEVELS - 1; level > 0; level--) {
+    size_t mask = ((size_t)1 << (WHEEL_BITS * level)) - 1;
+    if ((rules->now & mask) == 0) {
+      cascade(rules, level);
+    }
+  }
+  size_t slot = rules->now & (WHEEL_SLOTS - 1);
+  size_t index = rules->wheel[0][slot];
+  rules->wheel[0][slot] = NO_TIMER;
+  size_t generation = rules->generation;
+  while (index != NO_TIMER && rules->generation == generation) {
+    size_t next = rules->timers[index].next;
+    timer_handler_t handler = rules->timers[index].handler;
+    release_timer(rules, index);
+    if (handler != NULL) {
+      handler(aux);
+    }
+    index = next;
+  }
+}
+
+static bool matches(trigger_t *trigger, rule_event_t *event) {
+  return trigger->trigger == event->trigger &&
+         !strcmp(trigger->kind, event->kind) &&
+         (trigger->other == NULL ||
+          (event->other != NULL && !strcmp(trigger->other, event->other)));
+}
+
+size_t rules_now(rules_t *rules) { return rules->now; }
+
+void rules_tick(rules_t *rules, double dt, void *aux) {
+  size_t generation = rules->generation;
+  // a long step turns the wheel several times, so timers keep to simulated
+  // time however often the game steps
+  rules->pending += dt;
+  while (rules->pending >= rules->tick_length) {
+    rules->pending -= rules->tick_length;
+    advance_timers(rules, aux);
+    if (rules->generation != generation) {
+      return;
+    }
+  }
+  // handlers may queue more events, which are handled in the same pass
+  for (size_t i = 0; i < rules->num_events; i++) {
+    rule_event_t event = rules->events[i];
+    for (size_t j = 0; j < rules->num_triggers; j++) {
+      if (matches(&rules->triggers[j], &event)) {
+        rules->triggers[j].handler(&event, aux);
+        if (rules->generation != generation) {
+          return;
+        }
+      }
+    }
+  }
+  rules->num_events = 0;
+}
@@ -0,0 +1,134 @@
+#ifndef __RULES_H__
+#define __RULES_H__
+
+#include "body.h"
+#include <stddef.h>
+
+/**
+ * What a trigger reacts to.
+ * RULE_CONTACT fires when two tracked bodies start touching, before either
+ * is removed; RULE_DESTROYED fires once for every body removed by a rule.
+ */
+typedef enum { RULE_CONTACT, RULE_DESTROYED } rule_trigger_t;
+
+/**
+ * One queued event. kind and other name bodies: for a contact, kind is the
+ * first body of the pair and other the second; for a removal, kind is the
+ * removed body and other is NULL. They point at the strings the triggers were
+ * registered with, since the bodies own their infos and may be freed before
+ * the event is handled, and other is NULL when no trigger names it. score is
+ * the score of the second body of a contact, or of the removed body, taken
+ * before the body is freed.
+ */
+typedef struct rule_event {
+  rule_trigger_t trigger;
+  const char *kind;
+  const char *other;
+  double score;
+} rule_event_t;
+
+typedef void (*trigger_handler_t)(rule_event_t *event, void *aux);
+typedef void (*timer_handler_t)(void *aux);
+
+/**
+ * The triggers and timers of the current level.
+ * Events are queued while the scene ticks and handled afterwards, and timers
+ * sit on a hierarchical wheel, so the rules of a tick cost in proportion to
+ * what happened rather than to the number of bodies. The wheel counts ticks
+ * of simulated time, not calls to rules_tick(), so timers take as long when
+ * the game steps less often with a longer dt.
+ */
+typedef struct rules rules_t;
+
+/**
+ * Allocates a rule set with no triggers or timers.
+ *
+ * @param tick_length the simulated time of one tick of the timer wheel
+ * @return the new rule set
+ */
+rules_t *rules_init(double tick_length);
+
+/**
+ * Releases the memory of a rule set.
+ *
+ * @param rules a pointer to a rule set returned from rules_init()
+ */
+void rules_free(rules_t *rules);
+
+/**
+ * Drops every trigger, timer and queued event, for when a level ends.
+ * If called from a handler, the events after it in the current dispatch are
+ * dropped as well.
+ *
+ * @param rules a pointer to a rule set returned from rules_init()
+ */
+void rules_clear(rules_t *rules);
+
+/**
+ * Registers a handler for an event.
+ * Handlers of the same event run in the order they were registered.
+ *
+ * @param rules a pointer to a rule set returned from rules_init()
+ * @param trigger the kind of event
+ * @param kind the info of the removed body or of the first body of a contact
+ * @param other the info of the second body of a contact, or NULL for any
+ * @param handler the function to call
+ */
+void rules_on(rules_t *rules, rule_trigger_t trigger, const char *kind,
+              const char *other, trigger_handler_t handler);
+
+/**
+ * Queues a contact between two bodies, unless no trigger names the first.
+ *
+ * @param rules a pointer to a rule set returned from rules_init()
+ * @param body1 the first body of the pair
+ * @param body2 the second body of the pair
+ */
+void rules_contact(rules_t *rules, body_t *body1, body_t *body2);
+
+/**
+ * Queues the removal of a body, unless no trigger names it.
+ * Call it before body_remove().
+ *
+ * @param rules a pointer to a rule set returned from rules_init()
+ * @param body the body being removed
+ */
+void rules_destroyed(rules_t *rules, body_t *body);
+
+/**
+ * Runs a handler once a number of ticks from now.
+ *
+ * @param rules a pointer to a rule set returned from rules_init()
+ * @param ticks the number of ticks of simulated time to wait, at least 1
+ * @param handler the function to call
+ */
+void rules_after(rules_t *rules, size_t ticks, timer_handler_t handler);
+
+/**
+ * Cancels every pending timer with a handler.
+ *
+ * @param rules a pointer to a rule set returned from rules_init()
+ * @param handler the handler whose timers are cancelled
+ */
+void rules_cancel(rules_t *rules, timer_handler_t handler);
+
+/**
+ * Gets the number of ticks of simulated time the wheel has turned.
+ *
+ * @param rules a pointer to a rule set returned from rules_init()
+ * @return the ticks since rules_init()
+ */
+size_t rules_now(rules_t *rules);
+
+/**
+ * Advances the timers by dt of simulated time, running the ones that come
+ * due tick by tick, then handles the queued events in the order they were
+ * queued. Time short of a whole tick is kept for the next call.
+ *
+ * @param rules a pointer to a rule set returned from rules_init()
+ * @param dt the simulated time since the last call
+ * @param aux the argument passed to every handler
+ */
+void rules_tick(rules_t *rules, double dt, void *aux);
+
+#endif // #ifndef __RULES_H__
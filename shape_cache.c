@@ -0,0 +1,97 @@
+#include "shape_cache.h"
+#include "point_list.h"
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+struct shape_cache {
+  // vertices relative to the centroid at no rotation
+  point_list_t local;
+  // local turned by rotation
+  point_list_t rotated;
+  // rotated moved to position
+  point_list_t world;
+  double rotation;
+  vector_t position;
+};
+
+shape_cache_t *shape_cache_init(list_t *shape) {
+  shape_cache_t *cache = malloc(sizeof(shape_cache_t));
+  assert(cache != NULL);
+  size_t n = list_size(shape);
+  point_list_init(&cache->local);
+  point_list_init(&cache->rotated);
+  point_list_init(&cache->world);
+  vector_t *points = point_list_extend(&cache->local, n);
+  for (size_t i = 0; i < n; i++) {
+    points[i] = *(vector_t *)list_get(shape, i);
+  }
+
+  // the centroid is found relative to the first vertex, which keeps the
+  // shoelace sums small for polygons far from the origin
+  vector_t origin = n > 0 ? points[0] : VEC_ZERO;
+  double twice_area = 0;
+  vector_t weighted = VEC_ZERO;
+  for (size_t i = 0; i < n; i++) {
+    vector_t a = vec_subtract(points[i], origin);
+    vector_t b = vec_subtract(points[(i + 1) % n], origin);
+    double cross = vec_cross(a, b);
+    twice_area += cross;
+    weighted = vec_add(weighted, vec_multiply(cross, vec_add(a, b)));
+  }
+  vector_t offset =
+      twice_area != 0 ? vec_multiply(1.0 / (3 * twice_area), weighted)
+                      : VEC_ZERO;
+  vector_t centroid = vec_add(origin, offset);
+  for (size_t i = 0; i < n; i++) {
+    points[i] = vec_subtract(points[i], centroid);
+  }
+
+  point_list_extend(&cache->rotated, n);
+  point_list_extend(&cache->world, n);
+  // force the first pose to fill both lists
+  cache->rotation = NAN;
+  cache->position = (vector_t){NAN, NAN};
+  shape_cache_pose(cache, centroid, 0);
+  return cache;
+}
+
+void shape_cache_free(shape_cache_t *cache) {
+  point_list_free(&cache->local);
+  point_list_free(&cache->rotated);
+  point_list_free(&cache->world);
+  free(cache);
+}
+
+size_t shape_cache_size(shape_cache_t *cache) {
+  return point_list_size(&cache->local);
+}
+
+vector_t *shape_cache_pose(shape_cache_t *cache, vector_t centroid,
+                           double rotation) {
+  size_t n = point_list_size(&cache->local);
+  vector_t *restrict world = point_list_data(&cache->world);
+  vector_t *restrict rotated = point_list_data(&cache->rotated);
+  bool turned = rotation != cache->rotation;
+  if (turned) {
+    // always from the local copy, so no error builds up across turns
+    const vector_t *restrict local = point_list_data(&cache->local);
+    double c = cos(rotation);
+    double s = sin(rotation);
+    for (size_t i = 0; i < n; i++) {
+      rotated[i].x = local[i].x * c - local[i].y * s;
+      rotated[i].y = local[i].x * s + local[i].y * c;
+    }
+    cache->rotation = rotation;
+  }
+  if (turned || centroid.x != cache->position.x ||
+      centroid.y != cache->position.y) {
+    for (size_t i = 0; i < n; i++) {
+      world[i].x = rotated[i].x + centroid.x;
+      world[i].y = rotated[i].y + centroid.y;
+    }
+    cache->position = centroid;
+  }
+  return world;
+}
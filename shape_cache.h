@@ -0,0 +1,52 @@
+#ifndef __SHAPE_CACHE_H__
+#define __SHAPE_CACHE_H__
+
+#include "list.h"
+#include "vector.h"
+#include <stddef.h>
+
+/**
+ * The vertices of one polygon, kept in the polygon's own frame so that they
+ * are found once however often the polygon moves.
+ * World-space vertices are made from the local copy on demand, which costs one
+ * sin/cos pair when the rotation changes and a translation otherwise, and never
+ * drifts however many times the polygon is turned.
+ */
+typedef struct shape_cache shape_cache_t;
+
+/**
+ * Copies a polygon into the frame of its centroid.
+ *
+ * @param shape the vertices of a polygon, which are not kept
+ * @return the new cache, posed at the polygon's centroid with no rotation
+ */
+shape_cache_t *shape_cache_init(list_t *shape);
+
+/**
+ * Releases the memory of a shape cache.
+ *
+ * @param cache a pointer to a cache returned from shape_cache_init()
+ */
+void shape_cache_free(shape_cache_t *cache);
+
+/**
+ * Gets the number of vertices of a cached polygon.
+ *
+ * @param cache a pointer to a cache returned from shape_cache_init()
+ * @return the number of vertices
+ */
+size_t shape_cache_size(shape_cache_t *cache);
+
+/**
+ * Gets the vertices of the polygon moved to a centroid and turned by an angle
+ * about it. The result is reused while the pose stays the same.
+ *
+ * @param cache a pointer to a cache returned from shape_cache_init()
+ * @param centroid where the polygon's centroid should be
+ * @param rotation the angle of the polygon, in radians, from its original one
+ * @return shape_cache_size(cache) vertices, valid until the next call
+ */
+vector_t *shape_cache_pose(shape_cache_t *cache, vector_t centroid,
+                           double rotation);
+
+#endif // #ifndef __SHAPE_CACHE_H__
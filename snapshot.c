@@ -0,0 +1,125 @@
+#include "snapshot.h"
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+static const size_t NUM_SNAPSHOTS = 3;
+static const size_t INIT_CAPACITY = 64;
+// the ready index carries this bit while the renderer has not taken it
+static const unsigned FRESH = 4;
+static const unsigned INDEX_MASK = 3;
+
+struct snapshot_buffer {
+  snapshot_t *snapshots;
+  // back is only touched by the simulation thread and front only by the
+  // render thread; ready is swapped between them
+  unsigned back;
+  atomic_uint ready;
+  unsigned front;
+};
+
+// grows an array so that it holds at least needed elements
+static void reserve(void **data, size_t *capacity, size_t needed,
+                    size_t element_size) {
+  if (needed <= *capacity) {
+    return;
+  }
+  size_t new_capacity = *capacity == 0 ? INIT_CAPACITY : *capacity;
+  while (new_capacity < needed) {
+    new_capacity *= 2;
+  }
+  *data = realloc(*data, new_capacity * element_size);
+  assert(*data != NULL);
+  *capacity = new_capacity;
+}
+
+void snapshot_capture(snapshot_t *snapshot, scene_t *scene, size_t tick,
+                      sprite_lookup_t lookup, void *aux) {
+  size_t num_bodies = scene_bodies(scene);
+  reserve((void **)&snapshot->poses, &snapshot->poses_capacity, num_bodies,
+          sizeof(body_pose_t));
+  snapshot->tick = tick;
+  snapshot->num_poses = 0;
+  snapshot->num_points = 0;
+  for (size_t i = 0; i < num_bodies; i++) {
+    body_t *body = scene_get_body(scene, i);
+    body_pose_t *pose = &snapshot->poses[snapshot->num_poses++];
+    *pose = (body_pose_t){.id = body,
+                          .sprite = lookup(body, aux),
+                          .centroid = body_get_centroid(body),
+                          .rotation = body_get_rotation(body),
+                          .color = body_get_color(body),
+                          .first_point = snapshot->num_points};
+    if (pose->sprite.path != NULL) {
+      continue;
+    }
+    list_t *shape = body_get_actual_shape(body);
+    size_t num_points = list_size(shape);
+    reserve((void **)&snapshot->points, &snapshot->points_capacity,
+            snapshot->num_points + num_points, sizeof(vector_t));
+    for (size_t j = 0; j < num_points; j++) {
+      snapshot->points[snapshot->num_points++] =
+          *(vector_t *)list_get(shape, j);
+    }
+    list_free(shape);
+    pose->num_points = num_points;
+  }
+}
+
+void snapshot_add_polygon(snapshot_t *snapshot, vector_t *points,
+                          size_t num_points, rgb_color_t color,
+                          layer_t layer) {
+  reserve((void **)&snapshot->poses, &snapshot->poses_capacity,
+          snapshot->num_poses + 1, sizeof(body_pose_t));
+  reserve((void **)&snapshot->points, &snapshot->points_capacity,
+          snapshot->num_points + num_points, sizeof(vector_t));
+  sprite_t sprite = {.path = NULL, .layer = layer, .depth = DEPTH_TOP};
+  snapshot->poses[snapshot->num_poses++] =
+      (body_pose_t){.sprite = sprite,
+                    .color = color,
+                    .first_point = snapshot->num_points,
+                    .num_points = num_points};
+  for (size_t i = 0; i < num_points; i++) {
+    snapshot->points[snapshot->num_points++] = points[i];
+  }
+}
+
+snapshot_buffer_t *snapshot_buffer_init(void) {
+  snapshot_buffer_t *buffer = malloc(sizeof(snapshot_buffer_t));
+  assert(buffer != NULL);
+  buffer->snapshots = calloc(NUM_SNAPSHOTS, sizeof(snapshot_t));
+  assert(buffer->snapshots != NULL);
+  buffer->back = 0;
+  atomic_init(&buffer->ready, 1);
+  buffer->front = 2;
+  return buffer;
+}
+
+void snapshot_buffer_free(snapshot_buffer_t *buffer) {
+  for (size_t i = 0; i < NUM_SNAPSHOTS; i++) {
+    free(buffer->snapshots[i].poses);
+    free(buffer->snapshots[i].points);
+  }
+  free(buffer->snapshots);
+  free(buffer);
+}
+
+snapshot_t *snapshot_buffer_back(snapshot_buffer_t *buffer) {
+  return &buffer->snapshots[buffer->back];
+}
+
+void snapshot_buffer_publish(snapshot_buffer_t *buffer) {
+  unsigned previous = atomic_exchange_explicit(
+      &buffer->ready, buffer->back | FRESH, memory_order_acq_rel);
+  buffer->back = previous & INDEX_MASK;
+}
+
+snapshot_t *snapshot_buffer_latest(snapshot_buffer_t *buffer) {
+  if (!(atomic_load_explicit(&buffer->ready, memory_order_relaxed) & FRESH)) {
+    return NULL;
+  }
+  unsigned previous = atomic_exchange_explicit(&buffer->ready, buffer->front,
+                                               memory_order_acq_rel);
+  buffer->front = previous & INDEX_MASK;
+  return &buffer->snapshots[buffer->front];
+}
@@ -0,0 +1,169 @@
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include "body.h"
+#include "color.h"
+#include "scene.h"
+#include "vector.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Bodies on the static layer are composited once into a cached texture that
+ * is only redrawn when one of them moves, rotates, appears or disappears.
+ * Bodies on the dynamic layer are drawn on top of it every frame.
+ */
+typedef enum { LAYER_STATIC, LAYER_DYNAMIC, NUM_LAYERS } layer_t;
+
+#define DEPTH_TOP SIZE_MAX
+
+/**
+ * How a body is drawn.
+ * A body with a texture path is drawn as that image with the given size,
+ * centred on its centroid and turned by its rotation.
+ * A body without one is drawn as its polygon in its color.
+ * Within a layer, bodies of a lower depth are drawn first; polygons added
+ * with snapshot_add_polygon() are at DEPTH_TOP, over every body.
+ */
+typedef struct sprite {
+  char *path;
+  vector_t size;
+  layer_t layer;
+  size_t depth;
+} sprite_t;
+
+/**
+ * Picks the sprite of a body.
+ *
+ * @param body the body to draw
+ * @param aux the aux passed to snapshot_capture()
+ * @return the sprite to draw the body with
+ */
+typedef sprite_t (*sprite_lookup_t)(body_t *body, void *aux);
+
+/**
+ * Everything the renderer needs to draw one body.
+ * id is the body's address and is only compared, never dereferenced; it is
+ * NULL for polygons added with snapshot_add_polygon().
+ * Polygons keep their points in the snapshot's points array.
+ */
+typedef struct body_pose {
+  const void *id;
+  sprite_t sprite;
+  vector_t centroid;
+  double rotation;
+  rgb_color_t color;
+  size_t first_point;
+  size_t num_points;
+} body_pose_t;
+
+/**
+ * The numbers drawn over a level by the HUD, set by the game after
+ * snapshot_capture(), which leaves them alone.
+ * visible is false on the screens between levels, and the elasticity is only
+ * shown on the level where the player can change it.
+ */
+typedef struct hud_values {
+  bool visible;
+  bool show_elasticity;
+  size_t hoppers_left;
+  double score;
+  double elasticity;
+} hud_values_t;
+
+/**
+ * A copy of the drawable state of a scene at the end of one tick.
+ * Once published it is only read, so it can be drawn while the scene moves
+ * on to the next tick. Poses are in world coordinates; camera is the world
+ * position of the bottom left corner of the window and, like hud, is set by
+ * the game after snapshot_capture().
+ */
+typedef struct snapshot {
+  size_t tick;
+  hud_values_t hud;
+  vector_t camera;
+  body_pose_t *poses;
+  size_t num_poses;
+  size_t poses_capacity;
+  vector_t *points;
+  size_t num_points;
+  size_t points_capacity;
+} snapshot_t;
+
+/**
+ * Overwrites a snapshot with the bodies of a scene, in scene order.
+ *
+ * @param snapshot the snapshot to fill, usually snapshot_buffer_back()
+ * @param scene the scene to copy
+ * @param tick the number of the tick the scene is at
+ * @param lookup picks the sprite of each body
+ * @param aux passed to lookup
+ */
+void snapshot_capture(snapshot_t *snapshot, scene_t *scene, size_t tick,
+                      sprite_lookup_t lookup, void *aux);
+
+/**
+ * Appends a polygon that is not a body, such as an aiming guide, to a
+ * snapshot. It is drawn after the bodies of its layer.
+ *
+ * @param snapshot the snapshot to add to, after snapshot_capture()
+ * @param points the corners of the polygon, copied into the snapshot
+ * @param num_points the number of corners
+ * @param color the fill color
+ * @param layer the layer to draw the polygon on
+ */
+void snapshot_add_polygon(snapshot_t *snapshot, vector_t *points,
+                          size_t num_points, rgb_color_t color,
+                          layer_t layer);
+
+/**
+ * Passes snapshots from one simulation thread to one render thread without
+ * either side waiting on the other.
+ * The simulation fills the back snapshot and publishes it; the renderer
+ * takes the latest published one. A third, ready snapshot sits between the
+ * two, so a publish never overwrites the snapshot being drawn and the
+ * renderer skips any snapshot that was replaced before it got to it.
+ */
+typedef struct snapshot_buffer snapshot_buffer_t;
+
+/**
+ * Allocates an empty snapshot buffer.
+ *
+ * @return the new buffer
+ */
+snapshot_buffer_t *snapshot_buffer_init(void);
+
+/**
+ * Releases the memory of a snapshot buffer and its snapshots.
+ *
+ * @param buffer a pointer to a buffer returned from snapshot_buffer_init()
+ */
+void snapshot_buffer_free(snapshot_buffer_t *buffer);
+
+/**
+ * Gets the snapshot the simulation thread may write.
+ *
+ * @param buffer a pointer to a buffer returned from snapshot_buffer_init()
+ * @return the back snapshot
+ */
+snapshot_t *snapshot_buffer_back(snapshot_buffer_t *buffer);
+
+/**
+ * Makes the back snapshot the latest one and hands the simulation thread a
+ * new back snapshot.
+ *
+ * @param buffer a pointer to a buffer returned from snapshot_buffer_init()
+ */
+void snapshot_buffer_publish(snapshot_buffer_t *buffer);
+
+/**
+ * Takes the latest published snapshot for the render thread.
+ * It stays valid until the next call.
+ *
+ * @param buffer a pointer to a buffer returned from snapshot_buffer_init()
+ * @return the snapshot, or NULL if nothing was published since the last call
+ */
+snapshot_t *snapshot_buffer_latest(snapshot_buffer_t *buffer);
+
+#endif // #ifndef __SNAPSHOT_H__
@@ -0,0 +1,130 @@
+#include "world.h"
+#include "alloc_track.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+static const size_t INITIAL_CAPACITY = 8;
+static const size_t GROWTH_FACTOR = 2;
+// how near the view a chunk becomes active, and how far it must fall
+// behind before it is made dormant again, in chunks
+static const double ACTIVATE_MARGIN = 1;
+static const double DEACTIVATE_MARGIN = 2;
+
+typedef struct chunk {
+  dormant_body_t *bodies;
+  size_t size;
+  size_t capacity;
+} chunk_t;
+
+struct world {
+  double width;
+  double chunk_width;
+  size_t num_chunks;
+  chunk_t *chunks;
+  // the active chunks are first up to but not including end
+  size_t first;
+  size_t end;
+  size_t dormant;
+};
+
+world_t *world_init(double width, double chunk_width) {
+  assert(chunk_width > 0);
+  world_t *world = alloc_track_malloc(ALLOC_LIST, sizeof(world_t));
+  size_t num_chunks = (size_t)ceil(width / chunk_width);
+  if (num_chunks == 0) {
+    num_chunks = 1;
+  }
+  *world = (world_t){.width = width,
+                     .chunk_width = chunk_width,
+                     .num_chunks = num_chunks};
+  world->chunks = alloc_track_malloc(ALLOC_LIST, num_chunks * sizeof(chunk_t));
+  for (size_t i = 0; i < num_chunks; i++) {
+    world->chunks[i] = (chunk_t){NULL, 0, 0};
+  }
+  return world;
+}
+
+void world_free(world_t *world) {
+  for (size_t i = 0; i < world->num_chunks; i++) {
+    alloc_track_free(world->chunks[i].bodies);
+  }
+  alloc_track_free(world->chunks);
+  alloc_track_free(world);
+}
+
+double world_width(world_t *world) { return world->width; }
+
+size_t world_chunks(world_t *world) { return world->num_chunks; }
+
+size_t world_dormant(world_t *world) { return world->dormant; }
+
+static size_t chunk_of(world_t *world, double x) {
+  if (x < 0) {
+    return 0;
+  }
+  size_t chunk = (size_t)(x / world->chunk_width);
+  return chunk < world->num_chunks ? chunk : world->num_chunks - 1;
+}
+
+bool world_is_active(world_t *world, double x) {
+  size_t chunk = chunk_of(world, x);
+  return chunk >= world->first && chunk < world->end;
+}
+
+void world_store(world_t *world, dormant_body_t *body) {
+  chunk_t *chunk = &world->chunks[chunk_of(world, body->centroid.x)];
+  if (chunk->size == chunk->capacity) {
+    chunk->capacity = chunk->capacity == 0 ? INITIAL_CAPACITY
+                                           : chunk->capacity * GROWTH_FACTOR;
+    chunk->bodies = alloc_track_realloc(ALLOC_LIST, chunk->bodies,
+                                        chunk->capacity *
+                                            sizeof(dormant_body_t));
+  }
+  chunk->bodies[chunk->size++] = *body;
+  world->dormant++;
+}
+
+// hands every record of a chunk to activate; the chunk keeps its array for
+// the next time it is made dormant
+static void activate_chunk(world_t *world, size_t index,
+                           world_activate_t activate, void *aux) {
+  chunk_t *chunk = &world->chunks[index];
+  size_t size = chunk->size;
+  chunk->size = 0;
+  world->dormant -= size;
+  for (size_t i = 0; i < size; i++) {
+    activate(&chunk->bodies[i], aux);
+  }
+}
+
+static size_t clamp_index(size_t index, size_t min, size_t max) {
+  return index < min ? min : index > max ? max : index;
+}
+
+bool world_set_view(world_t *world, double left, double right,
+                    world_activate_t activate, void *aux) {
+  double near = ACTIVATE_MARGIN * world->chunk_width;
+  double far = DEACTIVATE_MARGIN * world->chunk_width;
+  size_t want_first = chunk_of(world, left - near);
+  size_t want_end = chunk_of(world, right + near) + 1;
+  size_t first = want_first;
+  size_t end = want_end;
+  bool deactivated = false;
+  if (world->first < world->end) {
+    first = clamp_index(world->first, chunk_of(world, left - far), want_first);
+    end = clamp_index(world->end, want_end, chunk_of(world, right + far) + 1);
+    deactivated = world->first < first || world->end > end;
+  }
+
+  size_t old_first = world->first;
+  size_t old_end = world->end;
+  world->first = first;
+  world->end = end;
+  for (size_t i = first; i < end; i++) {
+    if (i < old_first || i >= old_end) {
+      activate_chunk(world, i, activate, aux);
+    }
+  }
+  return deactivated;
+}
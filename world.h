@@ -0,0 +1,112 @@
+#ifndef __WORLD_H__
+#define __WORLD_H__
+
+#include "vector.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A level wider than the window, cut into vertical chunks of equal width.
+ * Only the chunks near the camera are active; the bodies of the others wait
+ * in their chunk as dormant records, so the scene holds the bodies of a few
+ * chunks however long the level is. The world only stores and hands back
+ * records; making bodies from them and removing bodies is left to the game.
+ */
+typedef struct world world_t;
+
+/**
+ * What is kept of a body while its chunk is inactive: everything that can
+ * differ between bodies of one kind. kind is relative to the level's kinds.
+ */
+typedef struct dormant_body {
+  uint32_t kind;
+  uint32_t reserved;
+  vector_t centroid;
+  vector_t velocity;
+  double rotation;
+  double score;
+} dormant_body_t;
+
+/**
+ * Called once for each record of a chunk that becomes active.
+ */
+typedef void (*world_activate_t)(dormant_body_t *body, void *aux);
+
+/**
+ * Allocates an empty world with no active chunks.
+ *
+ * @param width the width of the level
+ * @param chunk_width the width of one chunk
+ * @return the new world
+ */
+world_t *world_init(double width, double chunk_width);
+
+/**
+ * Releases the memory of a world and every record it still holds.
+ *
+ * @param world a pointer to a world returned from world_init()
+ */
+void world_free(world_t *world);
+
+/**
+ * Gets the width of the level.
+ *
+ * @param world a pointer to a world returned from world_init()
+ * @return the width given to world_init()
+ */
+double world_width(world_t *world);
+
+/**
+ * Gets the number of chunks the level is cut into.
+ *
+ * @param world a pointer to a world returned from world_init()
+ * @return the number of chunks
+ */
+size_t world_chunks(world_t *world);
+
+/**
+ * Gets the number of records waiting in inactive chunks.
+ *
+ * @param world a pointer to a world returned from world_init()
+ * @return the number of dormant bodies
+ */
+size_t world_dormant(world_t *world);
+
+/**
+ * Tells whether the chunk under a position is active. Positions left or
+ * right of the level belong to its first or last chunk.
+ *
+ * @param world a pointer to a world returned from world_init()
+ * @param x the horizontal position
+ * @return whether bodies at x should be in the scene
+ */
+bool world_is_active(world_t *world, double x);
+
+/**
+ * Copies a record into the chunk under its centroid.
+ *
+ * @param world a pointer to a world returned from world_init()
+ * @param body the record to store
+ */
+void world_store(world_t *world, dormant_body_t *body);
+
+/**
+ * Moves the view and activates the chunks it comes near.
+ * Chunks within one chunk of the view become active and give their records
+ * to activate, which then belong to the caller. Active chunks stay active
+ * until they are more than two chunks from the view, so a camera moving back
+ * and forth at a chunk edge does not swap the same bodies in and out.
+ *
+ * @param world a pointer to a world returned from world_init()
+ * @param left the left edge of the view
+ * @param right the right edge of the view
+ * @param activate the handler for the records of newly active chunks
+ * @param aux the argument of activate
+ * @return whether any chunk became inactive, so that the caller should store
+ *   the bodies that are no longer over an active chunk
+ */
+bool world_set_view(world_t *world, double left, double right,
+                    world_activate_t activate, void *aux);
+
+#endif // #ifndef __WORLD_H__